@@ -277,6 +277,7 @@ struct fts_ts_data {
 
 #if defined(CONFIG_INPUT_TOUCHSCREEN_MMI)
     struct ts_mmi_class_methods *imports;
+    struct ts_mmi_fwdl fwdl;    /* burst pram/dram download */
 #endif
 };
 
@@ -290,6 +291,9 @@ int fts_read(u8 *cmd, u32 cmdlen, u8 *data, u32 datalen);
 int fts_read_reg(u8 addr, u8 *value);
 int fts_write(u8 *writebuf, u32 writelen);
 int fts_write_reg(u8 addr, u8 value);
+/* write with the header room already in txbuf, spi v1.1.1 only */
+#define FTS_WRITE_FRAME_HEAD    7
+int fts_write_frame(u8 cmd, u8 *txbuf, u8 *rxbuf, u32 datalen);
 void fts_hid2std(void);
 int fts_bus_init(struct fts_ts_data *ts_data);
 int fts_bus_exit(struct fts_ts_data *ts_data);
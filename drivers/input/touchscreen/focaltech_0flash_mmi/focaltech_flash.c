@@ -267,12 +267,30 @@ int fts_enter_test_environment(bool test_state)
     return 0;
 }
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+static void fts_fw_put_cached(struct fts_upgrade *upg)
+{
+    if (!upg->fw_cached)
+        return;
+
+    if (upg->fw == upg->fw_cached->image) {
+        upg->fw = upg->module_info->fw_file;
+        upg->fw_length = upg->module_info->fw_len;
+    }
+    ts_mmi_fw_put(upg->fw_cached);
+    upg->fw_cached = NULL;
+}
+#endif
+
 int fts_fw_resume(bool need_reset)
 {
     int ret = 0;
     struct fts_upgrade *upg = fwupgrade;
     const struct firmware *fw = NULL;
     char fwname[FILE_NAME_LENGTH] = { 0 };
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+    struct ts_mmi_fw *cached = NULL;
+#endif
 
     FTS_INFO("fw upgrade resume function");
     if (!upg || !upg->fw) {
@@ -289,7 +307,15 @@ int fts_fw_resume(bool need_reset)
              FTS_FW_NAME_PREX_WITH_REQUEST, upg->module_info->vendor_name);
 
     /* 1. request firmware */
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+    /* cached by the class, only the first resume reads the file */
+    cached = ts_mmi_fw_get(upg->ts_data->dev, fwname, NULL);
+    ret = PTR_ERR_OR_ZERO(cached);
+    if (ret == 0)
+        fw = &cached->fw;
+#else
     ret = request_firmware(&fw, fwname, upg->ts_data->dev);
+#endif
     if (ret != 0) {
         FTS_ERROR("%s:firmware(%s) request fail,ret=%d\n",
                   __func__, fwname, ret);
@@ -301,10 +327,23 @@ int fts_fw_resume(bool need_reset)
     }
     if (ret < 0) {
         FTS_ERROR("fw resume download failed");
-        return ret;
+        goto FTS_FW_RESUME_VMALLOC_ERROR;
     }
 
     /* update to newest fw if needed */
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+    if (cached && cached != upg->fw_cached) {
+        /* keep the cache reference, ESD and recovery flash from it */
+        if (upg->fw_from_request)
+            vfree(upg->fw);
+        upg->fw_from_request = 0;
+        fts_fw_put_cached(upg);
+        upg->fw_cached = cached;
+        upg->fw = cached->image;
+        upg->fw_length = cached->fw.size;
+        cached = NULL;
+    }
+#else
     if (fw != NULL) {
         u8 *tmpbuf = NULL;
         if (upg->fw_from_request)
@@ -321,12 +360,17 @@ int fts_fw_resume(bool need_reset)
             upg->fw_from_request = 1;
         }
     }
+#endif
 
 FTS_FW_RESUME_VMALLOC_ERROR:
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+    ts_mmi_fw_put(cached);
+#else
     if (fw != NULL) {
         release_firmware(fw);
         fw = NULL;
     }
+#endif
 
     return ret;
 }
@@ -621,6 +665,9 @@ int fts_fwupg_exit(struct fts_ts_data *ts_data)
 {
     FTS_FUNC_ENTER();
     if (fwupgrade) {
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+        fts_fw_put_cached(fwupgrade);
+#endif
         if (fwupgrade->fw_from_request) {
             vfree(fwupgrade->fw);
             fwupgrade->fw = NULL;
@@ -172,6 +172,9 @@ struct fts_upgrade {
     u32 fw_length;
     u8 *lic;
     u32 lic_length;
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+    struct ts_mmi_fw *fw_cached;    /* class cache entry upg->fw points into */
+#endif
 };
 
 /*****************************************************************************
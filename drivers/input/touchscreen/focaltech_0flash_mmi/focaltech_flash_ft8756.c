@@ -217,10 +217,9 @@ static int fts_ecc_cal_tp(u32 ecc_saddr, u32 ecc_len, u16 *ecc_value)
     return 0;
 }
 
-static int fts_ecc_cal_host(const u8 *data, u32 data_len, u16 *ecc_value)
+static u16 fts_ecc_update(u16 ecc, const u8 *data, u32 data_len)
 {
-    u16 ecc = 0;
-    u16 i = 0;
+    u32 i = 0;
     u16 j = 0;
     u16 al2_fcs_coef = AL2_FCS_COEF;
 
@@ -234,7 +233,12 @@ static int fts_ecc_cal_host(const u8 *data, u32 data_len, u16 *ecc_value)
         }
     }
 
-    *ecc_value = ecc & 0x0000FFFF;
+    return ecc;
+}
+
+static int fts_ecc_cal_host(const u8 *data, u32 data_len, u16 *ecc_value)
+{
+    *ecc_value = fts_ecc_update(0, data, data_len);
     return 0;
 }
 
@@ -286,6 +290,117 @@ static int fts_ecc_check(const u8 *buf, u32 len, u32 ecc_saddr)
     return 0;
 }
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/* burst download through the touchscreen_mmi class engine */
+static int fts_fwdl_write(void *priv, u32 offset, u8 *tx, u8 *rx, u32 len)
+{
+    int ret = 0;
+    u32 addr = offset + *(u32 *)priv;
+    u8 cmd[FTS_ROMBOOT_CMD_SET_PRAM_ADDR_LEN] = { 0 };
+
+    /* set pram address */
+    cmd[0] = FTS_ROMBOOT_CMD_SET_PRAM_ADDR;
+    cmd[1] = BYTE_OFF_16(addr);
+    cmd[2] = BYTE_OFF_8(addr);
+    cmd[3] = BYTE_OFF_0(addr);
+    ret = fts_write(cmd, FTS_ROMBOOT_CMD_SET_PRAM_ADDR_LEN);
+    if (ret < 0) {
+        FTS_ERROR("set pram addr(%x) fail", addr);
+        return ret;
+    }
+
+    /* write pram data straight from the bounce buffer */
+    return fts_write_frame(FTS_ROMBOOT_CMD_WRITE, tx, rx, len);
+}
+
+static int fts_fwdl_verify(void *priv, u32 offset, u32 len, u32 sum)
+{
+    int ret = 0;
+    u16 ecc_in_tp = 0;
+
+    ret = fts_ecc_cal_tp(offset, len, &ecc_in_tp);
+    if (ret < 0) {
+        FTS_ERROR("ecc in tp calc fail");
+        return ret;
+    }
+
+    FTS_DEBUG("ecc in tp:%04x,host:%04x,addr:%x", ecc_in_tp, sum, offset);
+    if (ecc_in_tp != (u16)sum) {
+        FTS_ERROR("ecc_in_tp(%x) != ecc_in_host(%x), ecc check fail",
+                  ecc_in_tp, sum);
+        return -EIO;
+    }
+
+    return 0;
+}
+
+static u32 fts_fwdl_sum(u32 sum, const u8 *data, u32 len)
+{
+    return fts_ecc_update((u16)sum, data, len);
+}
+
+static const struct ts_mmi_fwdl_ops fts_fwdl_ops = {
+    .write = fts_fwdl_write,
+    .verify = fts_fwdl_verify,
+    .sum = fts_fwdl_sum,
+};
+
+/* return -ENODEV if the engine isn't usable, to fall back to packet writes */
+static int fts_dpram_write_burst(u32 saddr, const u8 *buf, u32 len, bool wpram)
+{
+    int ret = 0;
+    struct ts_mmi_fwdl *dl = &fts_data->fwdl;
+    u32 baseaddr = wpram ? FTS_PRAM_SADDR : FTS_DRAM_SADDR;
+
+    if (NULL == buf) {
+        FTS_ERROR("fw buf is null");
+        return -EINVAL;
+    }
+
+    if ((len < FTS_MIN_LEN) || (len > FTS_MAX_LEN_APP)) {
+        FTS_ERROR("fw length(%d) fail", len);
+        return -EINVAL;
+    }
+
+    if (!dl->tx) {
+        dl->ops = &fts_fwdl_ops;
+        dl->head = FTS_WRITE_FRAME_HEAD;
+        /* boot ecc covers at most FTS_CMD_ECC_LENGTH_MAX bytes per command */
+        dl->verify_len = FTS_FLASH_PACKET_LENGTH_SPI;
+        ret = ts_mmi_fwdl_init(dl, fts_data->dev,
+                               FTS_FLASH_PACKET_LENGTH_SPI, true);
+        if (ret < 0) {
+            FTS_ERROR("burst download init fail,ret=%d", ret);
+            return -ENODEV;
+        }
+    }
+
+    FTS_INFO("dpram burst write");
+    dl->priv = &baseaddr;
+    ret = ts_mmi_fwdl_run(dl, saddr, buf, len);
+    dl->priv = NULL;
+
+    return ret;
+}
+#endif
+
+static int fts_dpram_write_ecc(u32 saddr, const u8 *buf, u32 len, bool wpram)
+{
+    int ret = 0;
+
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+    ret = fts_dpram_write_burst(saddr, buf, len, wpram);
+    if (ret != -ENODEV)
+        return ret;
+#endif
+
+    ret = fts_dpram_write(saddr, buf, len, wpram);
+    if (ret < 0)
+        return ret;
+
+    return fts_ecc_check(buf, len, saddr);
+}
+
 static int fts_pram_write_ecc(const u8 *buf, u32 len)
 {
     int ret = 0;
@@ -313,20 +428,13 @@ static int fts_pram_write_ecc(const u8 *buf, u32 len)
     }
 
     FTS_INFO("pram app length in fact:%d", pram_app_size);
-    /* write pram */
-    ret = fts_dpram_write(pram_start_addr, buf, pram_app_size, true);
+    /* write pram and check ecc */
+    ret = fts_dpram_write_ecc(pram_start_addr, buf, pram_app_size, true);
     if (ret < 0) {
         FTS_ERROR("write pram fail");
         return ret;
     }
 
-    /* check ecc */
-    ret = fts_ecc_check(buf, pram_app_size, pram_start_addr);
-    if (ret < 0) {
-        FTS_ERROR("pram ecc check fail");
-        return ret;
-    }
-
     FTS_INFO("pram app write successfully");
     return 0;
 }
@@ -363,20 +471,13 @@ static int fts_dram_write_ecc(const u8 *buf, u32 len)
 
     dram_buf = buf + pram_app_size;
     FTS_INFO("dram buf length in fact:%d,offset:%d", dram_size, pram_app_size);
-    /* write pram */
-    ret = fts_dpram_write(dram_start_addr, dram_buf, dram_size, false);
+    /* write dram and check ecc */
+    ret = fts_dpram_write_ecc(dram_start_addr, dram_buf, dram_size, false);
     if (ret < 0) {
         FTS_ERROR("write dram fail");
         return ret;
     }
 
-    /* check ecc */
-    ret = fts_ecc_check(dram_buf, dram_size, dram_start_addr);
-    if (ret < 0) {
-        FTS_ERROR("dram ecc check fail");
-        return ret;
-    }
-
     FTS_INFO("dram data write successfully");
     return 0;
 }
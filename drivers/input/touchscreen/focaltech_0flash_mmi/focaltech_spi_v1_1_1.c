@@ -126,10 +126,29 @@ static int rdata_check(u8 *rdata, u32 rlen)
     return 0;
 }
 
-int fts_write(u8 *writebuf, u32 writelen)
+static int fts_write_transfer(u8 *txbuf, u8 *rxbuf, u32 txlen)
 {
     int ret = 0;
     int i = 0;
+
+    for (i = 0; i < SPI_RETRY_NUMBER; i++) {
+        ret = fts_spi_transfer(txbuf, rxbuf, txlen);
+        if ((0 == ret) && ((rxbuf[3] & 0xA0) == 0)) {
+            break;
+        } else {
+            FTS_DEBUG("data write(status=%x),retry=%d,ret=%d",
+                      rxbuf[3], i, ret);
+            ret = -EIO;
+            udelay(CS_HIGH_DELAY);
+        }
+    }
+
+    return ret;
+}
+
+int fts_write(u8 *writebuf, u32 writelen)
+{
+    int ret = 0;
     struct fts_ts_data *ts_data = fts_data;
     u8 *txbuf = NULL;
     u8 *rxbuf = NULL;
@@ -174,17 +193,7 @@ int fts_write(u8 *writebuf, u32 writelen)
         txlen = txlen + datalen;
     }
 
-    for (i = 0; i < SPI_RETRY_NUMBER; i++) {
-        ret = fts_spi_transfer(txbuf, rxbuf, txlen);
-        if ((0 == ret) && ((rxbuf[3] & 0xA0) == 0)) {
-            break;
-        } else {
-            FTS_DEBUG("data write(status=%x),retry=%d,ret=%d",
-                      rxbuf[3], i, ret);
-            ret = -EIO;
-            udelay(CS_HIGH_DELAY);
-        }
-    }
+    ret = fts_write_transfer(txbuf, rxbuf, txlen);
 
 err_write:
     if (txlen_need > SPI_BUF_LENGTH) {
@@ -203,6 +212,35 @@ err_write:
     return ret;
 }
 
+/*
+ * txbuf holds FTS_WRITE_FRAME_HEAD free bytes followed by datalen bytes
+ * of data, rxbuf is as large. Used by the burst download, which keeps
+ * both buffers preallocated instead of copying every packet here.
+ */
+int fts_write_frame(u8 cmd, u8 *txbuf, u8 *rxbuf, u32 datalen)
+{
+    int ret = 0;
+    struct fts_ts_data *ts_data = fts_data;
+
+    BUILD_BUG_ON(FTS_WRITE_FRAME_HEAD != 4 + SPI_DUMMY_BYTE);
+    if (!txbuf || !rxbuf || !datalen) {
+        FTS_ERROR("txbuf/rxbuf/len is invalid");
+        return -EINVAL;
+    }
+
+    txbuf[0] = cmd;
+    txbuf[1] = WRITE_CMD;
+    txbuf[2] = (datalen >> 8) & 0xFF;
+    txbuf[3] = datalen & 0xFF;
+    memset(&txbuf[4], 0, SPI_DUMMY_BYTE);
+
+    mutex_lock(&ts_data->bus_lock);
+    ret = fts_write_transfer(txbuf, rxbuf, FTS_WRITE_FRAME_HEAD + datalen);
+    mutex_unlock(&ts_data->bus_lock);
+
+    return ret;
+}
+
 int fts_write_reg(u8 addr, u8 value)
 {
     u8 writebuf[2] = { 0 };
@@ -584,7 +584,11 @@ static int fts_input_report_b(struct fts_ts_data *data)
         }
     }
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+    ts_mmi_input_sync(data->imports, data->input_dev);
+#else
     input_sync(data->input_dev);
+#endif
     return 0;
 }
 
@@ -649,7 +653,11 @@ static int fts_input_report_a(struct fts_ts_data *data)
         }
     }
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+    ts_mmi_input_sync(data->imports, data->input_dev);
+#else
     input_sync(data->input_dev);
+#endif
     return 0;
 }
 #endif
@@ -879,6 +887,19 @@ static void fts_irq_read_report(void)
 #endif
 }
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/* top half: stamp the frame in the class and wake the thread */
+static irqreturn_t fts_irq_top_half(int irq, void *data)
+{
+    struct fts_ts_data *ts_data = data;
+
+    ts_mmi_irq_timestamp(ts_data->imports);
+    return IRQ_WAKE_THREAD;
+}
+#else
+#define fts_irq_top_half NULL
+#endif
+
 static irqreturn_t fts_irq_handler(int irq, void *data)
 {
 #if defined(CONFIG_PM) && FTS_PATCH_COMERR_PM
@@ -908,7 +929,7 @@ static int fts_irq_registration(struct fts_ts_data *ts_data)
     ts_data->irq = gpio_to_irq(pdata->irq_gpio);
     pdata->irq_gpio_flags = IRQF_TRIGGER_FALLING | IRQF_ONESHOT;
     FTS_INFO("irq:%d, flag:%x", ts_data->irq, pdata->irq_gpio_flags);
-    ret = request_threaded_irq(ts_data->irq, NULL, fts_irq_handler,
+    ret = request_threaded_irq(ts_data->irq, fts_irq_top_half, fts_irq_handler,
                                pdata->irq_gpio_flags,
                                FTS_DRIVER_NAME, ts_data);
 
@@ -984,6 +1005,10 @@ static int fts_input_init(struct fts_ts_data *ts_data)
     __set_bit(EV_SYN, input_dev->evbit);
     __set_bit(EV_ABS, input_dev->evbit);
     __set_bit(EV_KEY, input_dev->evbit);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+    /* frames are stamped with the hard IRQ time by the class */
+    input_set_capability(input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
     __set_bit(BTN_TOUCH, input_dev->keybit);
     __set_bit(INPUT_PROP_DIRECT, input_dev->propbit);
 
@@ -1312,7 +1312,11 @@ static void goodix_ts_report_finger(struct input_dev *dev,
 	}
 
 	input_report_key(dev, BTN_TOUCH, touch_num > 0 ? 1 : 0);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(core_data->imports, dev);
+#else
 	input_sync(dev);
+#endif
 #ifdef CONFIG_GTP_FOD
 		if(core_data->fod_enable) {
 			if(ts_event->gesture_type == GOODIX_GESTURE_FOD_DOWN && touch_num > 0) {
@@ -1357,6 +1361,22 @@ static int goodix_ts_request_handle(struct goodix_ts_core *cd,
 			  ts_event->request_code);
 	return ret;
 }
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/**
+ * goodix_ts_irq_func - Top half of interrupt
+ * Timestamp the frame in the class and wake the thread.
+ */
+static irqreturn_t goodix_ts_irq_func(int irq, void *data)
+{
+	struct goodix_ts_core *core_data = data;
+
+	ts_mmi_irq_timestamp(core_data->imports);
+	return IRQ_WAKE_THREAD;
+}
+#else
+#define goodix_ts_irq_func NULL
+#endif
+
 /**
  * goodix_ts_threadirq_func - Bottom half of interrupt
  * This functions is excuted in thread context,
@@ -1441,7 +1461,7 @@ static int goodix_ts_irq_setup(struct goodix_ts_core *core_data)
 
 	ts_info("IRQ:%u,flags:%d", core_data->irq, (int)ts_bdata->irq_flags);
 	ret = devm_request_threaded_irq(&core_data->pdev->dev,
-				      core_data->irq, NULL,
+				      core_data->irq, goodix_ts_irq_func,
 				      goodix_ts_threadirq_func,
 				      ts_bdata->irq_flags | IRQF_ONESHOT,
 				      GOODIX_CORE_DRIVER_NAME,
@@ -1768,6 +1788,10 @@ static int goodix_ts_input_dev_config(struct goodix_ts_core *core_data)
 	input_set_capability(input_dev, EV_KEY, BTN_TRIGGER_HAPPY1);
 	input_set_capability(input_dev, EV_KEY, BTN_TRIGGER_HAPPY2);
 #endif
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* frames are stamped with the hard IRQ time by the class */
+	input_set_capability(input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
 
 	r = input_register_device(input_dev);
 	if (r < 0) {
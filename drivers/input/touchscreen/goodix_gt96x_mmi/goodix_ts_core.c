@@ -968,8 +968,10 @@ static void goodix_ts_report_finger(struct input_dev *dev,
 {
 	unsigned int touch_num = touch_data->touch_num;
 	int i;
-#ifdef CONFIG_GTP_LAST_TIME
+#if defined(CONFIG_GTP_LAST_TIME) || defined(CONFIG_INPUT_TOUCHSCREEN_MMI)
 	struct goodix_ts_core *core_data = input_get_drvdata(dev);
+#endif
+#ifdef CONFIG_GTP_LAST_TIME
 	static uint8_t touchdown[GOODIX_MAX_TOUCH];
 #endif
 #ifdef CONFIG_ENABLE_GTP_PALM_CANCEL
@@ -1035,7 +1037,11 @@ static void goodix_ts_report_finger(struct input_dev *dev,
 	}
 
 	input_report_key(dev, BTN_TOUCH, touch_num > 0 ? 1 : 0);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(core_data->imports, dev);
+#else
 	input_sync(dev);
+#endif
 
 	mutex_unlock(&dev->mutex);
 }
@@ -1062,6 +1068,22 @@ static int goodix_ts_request_handle(struct goodix_ts_core *cd,
 	return ret;
 }
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/**
+ * goodix_ts_irq_func - Top half of interrupt
+ * Timestamp the frame in the class and wake the thread.
+ */
+static irqreturn_t goodix_ts_irq_func(int irq, void *data)
+{
+	struct goodix_ts_core *core_data = data;
+
+	ts_mmi_irq_timestamp(core_data->imports);
+	return IRQ_WAKE_THREAD;
+}
+#else
+#define goodix_ts_irq_func NULL
+#endif
+
 /**
  * goodix_ts_threadirq_func - Bottom half of interrupt
  * This functions is excuted in thread context,
@@ -1136,7 +1158,7 @@ static int goodix_ts_irq_setup(struct goodix_ts_core *core_data)
 
 	ts_info("IRQ:%u,flags:%d", core_data->irq, (int)ts_bdata->irq_flags);
 	ret = devm_request_threaded_irq(&core_data->pdev->dev,
-				      core_data->irq, NULL,
+				      core_data->irq, goodix_ts_irq_func,
 				      goodix_ts_threadirq_func,
 				      ts_bdata->irq_flags | IRQF_ONESHOT,
 				      GOODIX_CORE_DRIVER_NAME,
@@ -1367,6 +1389,10 @@ static int goodix_ts_input_dev_config(struct goodix_ts_core *core_data)
 
 	set_bit(EV_SYN, input_dev->evbit);
 	set_bit(EV_KEY, input_dev->evbit);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* frames are stamped with the hard IRQ time by the class */
+	input_set_capability(input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
 	set_bit(EV_ABS, input_dev->evbit);
 	set_bit(BTN_TOUCH, input_dev->keybit);
 	set_bit(BTN_TOOL_FINGER, input_dev->keybit);
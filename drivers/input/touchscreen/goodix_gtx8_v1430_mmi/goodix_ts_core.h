@@ -477,6 +477,7 @@ struct goodix_ts_core {
 	int (*set_fw_name)(char* fw_name);
 #ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
 	struct goodix_ts_mmi ts_mmi_info;
+	struct ts_mmi_class_methods *imports;
 #endif
 };
 
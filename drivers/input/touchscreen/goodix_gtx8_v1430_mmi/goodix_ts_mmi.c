@@ -597,6 +597,9 @@ int goodix_ts_mmi_dev_register(struct platform_device *pdev) {
 		dev_err(&pdev->dev, "Failed to register ts mmi\n");
 		return ret;
 	}
+
+	core_data->imports = &goodix_ts_mmi_methods.exports;
+
 	return 0;
 }
 
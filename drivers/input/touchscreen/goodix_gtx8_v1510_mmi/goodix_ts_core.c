@@ -32,6 +32,9 @@
 #endif
 
 #include "goodix_ts_core.h"
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+#include <linux/touchscreen_mmi.h>
+#endif
 
 #if LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 38)
 #include <linux/input/mt.h>
@@ -1189,6 +1192,9 @@ static void goodix_ts_report_finger(struct input_dev *dev,
 	unsigned int touch_num = touch_data->touch_num;
 	static u32 pre_fin;
 	int i;
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	struct goodix_ts_core *core_data = input_get_drvdata(dev);
+#endif
 
 	/*first touch down and last touch up condition*/
 	if (touch_num && !pre_fin)
@@ -1226,9 +1232,29 @@ static void goodix_ts_report_finger(struct input_dev *dev,
 		else if (touch_data->keys[i].status == TS_RELEASE)
 			input_report_key(dev, touch_data->keys[i].code, 0);
 	}
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(core_data->imports, dev);
+#else
 	input_sync(dev);
+#endif
 }
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/**
+ * goodix_ts_irq_func - Top half of interrupt
+ * Timestamp the frame in the class and wake the thread.
+ */
+static irqreturn_t goodix_ts_irq_func(int irq, void *data)
+{
+	struct goodix_ts_core *core_data = data;
+
+	ts_mmi_irq_timestamp(core_data->imports);
+	return IRQ_WAKE_THREAD;
+}
+#else
+#define goodix_ts_irq_func NULL
+#endif
+
 /**
  * goodix_ts_threadirq_func - Bottom half of interrupt
  * This functions is excuted in thread context,
@@ -1301,7 +1327,7 @@ int goodix_ts_irq_setup(struct goodix_ts_core *core_data)
 
 	ts_info("IRQ:%u,flags:%d", core_data->irq, (int)ts_bdata->irq_flags);
 	r = devm_request_threaded_irq(&core_data->pdev->dev,
-				      core_data->irq, NULL,
+				      core_data->irq, goodix_ts_irq_func,
 				      goodix_ts_threadirq_func,
 				      ts_bdata->irq_flags | IRQF_ONESHOT,
 				      GOODIX_CORE_DRIVER_NAME,
@@ -1620,6 +1646,10 @@ static int goodix_ts_input_dev_config(struct goodix_ts_core *core_data)
 
 	__set_bit(EV_SYN, input_dev->evbit);
 	__set_bit(EV_KEY, input_dev->evbit);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* frames are stamped with the hard IRQ time by the class */
+	input_set_capability(input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
 	__set_bit(EV_ABS, input_dev->evbit);
 	__set_bit(BTN_TOUCH, input_dev->keybit);
 	__set_bit(BTN_TOOL_FINGER, input_dev->keybit);
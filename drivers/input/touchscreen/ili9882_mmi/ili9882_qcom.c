@@ -91,6 +91,10 @@ void ili_input_register(void)
 	set_bit(EV_ABS, ilits->input->evbit);
 	set_bit(EV_SYN, ilits->input->evbit);
 	set_bit(EV_KEY, ilits->input->evbit);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* frames are stamped with the hard IRQ time by the class */
+	input_set_capability(ilits->input, EV_MSC, MSC_TIMESTAMP);
+#endif
 	set_bit(BTN_TOUCH, ilits->input->keybit);
 	set_bit(BTN_TOOL_FINGER, ilits->input->keybit);
 	set_bit(INPUT_PROP_DIRECT, ilits->input->propbit);
@@ -341,6 +345,10 @@ static irqreturn_t ilitek_plat_isr_top_half(int irq, void *dev_id)
 			return IRQ_HANDLED;
 	}
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* stamp the frame with the IRQ time in the class */
+	ts_mmi_irq_timestamp(ilits->imports);
+#endif
 	return IRQ_WAKE_THREAD;
 }
 
@@ -1091,7 +1091,11 @@ void ili_report_ap_mode(u8 *buf, int len)
 			for (i = 0; i < ilits->finger; i++)
 				ili_touch_press(touch_info[i].x, touch_info[i].y, touch_info[i].pressure, touch_info[i].id);
 		}
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+		ts_mmi_input_sync(ilits->imports, ilits->input);
+#else
 		input_sync(ilits->input);
+#endif
 		ilits->last_touch = ilits->finger;
 	} else {
 		if (ilits->last_touch) {
@@ -1110,7 +1114,11 @@ void ili_report_ap_mode(u8 *buf, int len)
 			} else {
 				ili_touch_release(0, 0, 0);
 			}
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+			ts_mmi_input_sync(ilits->imports, ilits->input);
+#else
 			input_sync(ilits->input);
+#endif
 			ilits->last_touch = 0;
 		}
 	}
@@ -1201,7 +1209,11 @@ void ili_debug_mode_report_point(u8 *buf, int len)
 			for (i = 0; i < ilits->finger; i++)
 				ili_touch_press(touch_info[i].x, touch_info[i].y, touch_info[i].pressure, touch_info[i].id);
 		}
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+		ts_mmi_input_sync(ilits->imports, ilits->input);
+#else
 		input_sync(ilits->input);
+#endif
 		ilits->last_touch = ilits->finger;
 	} else {
 		if (ilits->last_touch) {
@@ -1216,7 +1228,11 @@ void ili_debug_mode_report_point(u8 *buf, int len)
 			} else {
 				ili_touch_release(0, 0, 0);
 			}
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+			ts_mmi_input_sync(ilits->imports, ilits->input);
+#else
 			input_sync(ilits->input);
+#endif
 			ilits->last_touch = 0;
 		}
 	}
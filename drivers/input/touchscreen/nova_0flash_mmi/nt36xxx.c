@@ -1790,6 +1790,24 @@ static int32_t nvt_ts_point_data_checksum(uint8_t *buf, uint8_t length)
 #define POINT_DATA_LEN 65
 #endif
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/*******************************************************
+Description:
+	Novatek touchscreen top half, stamps the frame with
+	the IRQ time in the touchscreen class.
+
+return:
+	IRQ_WAKE_THREAD.
+*******************************************************/
+static irqreturn_t nvt_ts_irq_func(int irq, void *data)
+{
+	ts_mmi_irq_timestamp(ts->imports);
+	return IRQ_WAKE_THREAD;
+}
+#else
+#define nvt_ts_irq_func NULL
+#endif
+
 /*******************************************************
 Description:
 	Novatek touchscreen work function.
@@ -2140,7 +2158,11 @@ static irqreturn_t nvt_ts_work_func(int irq, void *data)
 	}
 #endif
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(ts->imports, ts->input_dev);
+#else
 	input_sync(ts->input_dev);
+#endif
 
 XFER_ERROR:
 
@@ -3166,6 +3188,10 @@ static int32_t nvt_ts_probe(struct spi_device *client)
 
 	//---set input device info.---
 	ts->input_dev->evbit[0] = BIT_MASK(EV_SYN) | BIT_MASK(EV_KEY) | BIT_MASK(EV_ABS) ;
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* frames are stamped with the hard IRQ time by the class */
+	input_set_capability(ts->input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
 	ts->input_dev->keybit[BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH);
 	ts->input_dev->propbit[0] = BIT(INPUT_PROP_DIRECT);
 
@@ -3235,7 +3261,7 @@ static int32_t nvt_ts_probe(struct spi_device *client)
 	if (client->irq) {
 		NVT_LOG("int_trigger_type=%d\n", ts->int_trigger_type);
 		ts->irq_enabled = true;
-		ret = request_threaded_irq(client->irq, NULL, nvt_ts_work_func,
+		ret = request_threaded_irq(client->irq, nvt_ts_irq_func, nvt_ts_work_func,
 				ts->int_trigger_type | IRQF_ONESHOT, NVT_SPI_NAME, ts);
 		if (ret != 0) {
 			NVT_ERR("request irq failed. ret=%d\n", ret);
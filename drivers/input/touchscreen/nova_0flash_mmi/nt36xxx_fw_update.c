@@ -39,6 +39,9 @@
 
 struct TIME_TYPE start, end;
 const struct firmware *fw_entry = NULL;
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+static struct ts_mmi_fw *fw_cached = NULL;
+#endif
 static size_t fw_need_write_size = 0;
 static uint8_t *fwbuf = NULL;
 
@@ -294,6 +297,14 @@ static void update_firmware_release(void)
 			fw_entry = NULL;
 			return;
 		}
+#endif
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+		if (fw_cached) {
+			ts_mmi_fw_put(fw_cached);
+			fw_cached = NULL;
+			fw_entry = NULL;
+			return;
+		}
 #endif
 		release_firmware(fw_entry);
 	}
@@ -371,11 +382,23 @@ static int32_t update_firmware_request(char *filename)
 		} else
 #endif
 		{
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+			/* cached by the class, only the first load reads the file */
+			fw_cached = ts_mmi_fw_get(&ts->client->dev, filename, NULL);
+			ret = PTR_ERR_OR_ZERO(fw_cached);
+			if (ret) {
+				fw_cached = NULL;
+				NVT_ERR("firmware load failed, ret=%d\n", ret);
+				goto request_fail;
+			}
+			fw_entry = &fw_cached->fw;
+#else
 			ret = request_firmware(&fw_entry, filename, &ts->client->dev);
 			if (ret) {
 				NVT_ERR("firmware load failed, ret=%d\n", ret);
 				goto request_fail;
 			}
+#endif
 		}
 
 		// check FW need to write size
@@ -4343,6 +4343,19 @@ static  bool cyttsp5_check_irq_asserted(struct cyttsp5_core_data *cd)
 }
 
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/* top half: stamp the frame in the class and wake the thread */
+static irqreturn_t cyttsp5_hard_irq(int irq, void *handle)
+{
+	struct cyttsp5_core_data *cd = handle;
+
+	ts_mmi_irq_timestamp(cd->imports);
+	return IRQ_WAKE_THREAD;
+}
+#else
+#define cyttsp5_hard_irq NULL
+#endif
+
 static irqreturn_t cyttsp5_irq(int irq, void *handle)
 {
 	struct cyttsp5_core_data *cd = handle;
@@ -6715,7 +6728,7 @@ static int cyttsp5_setup_irq_gpio(struct cyttsp5_core_data *cd)
 		/* use edge triggered interrupts */
 		irq_flags = IRQF_TRIGGER_FALLING | IRQF_ONESHOT;
 
-	rc = request_threaded_irq(cd->irq, NULL, cyttsp5_irq, irq_flags,
+	rc = request_threaded_irq(cd->irq, cyttsp5_hard_irq, cyttsp5_irq, irq_flags,
 		dev_name(dev), cd);
 	if (rc < 0)
 		dev_err(dev, "%s: Error, could not request irq\n", __func__);
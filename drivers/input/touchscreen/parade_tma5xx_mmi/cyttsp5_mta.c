@@ -27,12 +27,23 @@
  */
 
 #include "cyttsp5_regs.h"
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+#include "cyttsp5_ts_mmi.h"
+#endif
 
 static void cyttsp5_final_sync(struct input_dev *input, int max_slots,
 		int mt_sync_count, unsigned long *ids)
 {
-	if (mt_sync_count)
-		input_sync(input);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	struct cyttsp5_core_data *cd = dev_get_drvdata(input->dev.parent);
+#endif
+	if (!mt_sync_count)
+		return;
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(cd->imports, input);
+#else
+	input_sync(input);
+#endif
 }
 
 static void cyttsp5_input_sync(struct input_dev *input)
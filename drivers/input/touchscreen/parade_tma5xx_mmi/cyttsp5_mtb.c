@@ -27,12 +27,18 @@
  */
 
 #include "cyttsp5_regs.h"
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+#include "cyttsp5_ts_mmi.h"
+#endif
 #include <linux/input/mt.h>
 #include <linux/version.h>
 
 static void cyttsp5_final_sync(struct input_dev *input, int max_slots,
 		int mt_sync_count, unsigned long *ids)
 {
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	struct cyttsp5_core_data *cd = dev_get_drvdata(input->dev.parent);
+#endif
 	int t;
 
 	for (t = 0; t < max_slots; t++) {
@@ -42,7 +48,11 @@ static void cyttsp5_final_sync(struct input_dev *input, int max_slots,
 		input_mt_report_slot_state(input, MT_TOOL_FINGER, false);
 	}
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(cd->imports, input);
+#else
 	input_sync(input);
+#endif
 }
 
 static void cyttsp5_input_report(struct input_dev *input, int sig,
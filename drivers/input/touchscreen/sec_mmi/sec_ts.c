@@ -982,8 +982,25 @@ static void sec_ts_read_event(struct sec_ts_data *ts)
 		remain_event_count--;
 	} while (remain_event_count >= 0);
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(ts->imports, ts->input_dev);
+#else
 	input_sync(ts->input_dev);
+#endif
+}
+
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/* top half: stamp the frame in the class and wake the thread */
+static irqreturn_t sec_ts_irq(int irq, void *ptr)
+{
+	struct sec_ts_data *ts = (struct sec_ts_data *)ptr;
+
+	ts_mmi_irq_timestamp(ts->imports);
+	return IRQ_WAKE_THREAD;
 }
+#else
+#define sec_ts_irq NULL
+#endif
 
 static irqreturn_t sec_ts_irq_thread(int irq, void *ptr)
 {
@@ -1927,8 +1944,8 @@ static int sec_ts_probe(struct i2c_client *client, const struct i2c_device_id *i
 
 	input_info(true, &ts->client->dev, "%s: request_irq = %d\n", __func__, client->irq);
 
-	ret = request_threaded_irq(client->irq, NULL, sec_ts_irq_thread,
-			ts->plat_data->irq_type, SEC_TS_I2C_NAME, ts);
+	ret = request_threaded_irq(client->irq, sec_ts_irq, sec_ts_irq_thread,
+			ts->plat_data->irq_type | IRQF_ONESHOT, SEC_TS_I2C_NAME, ts);
 	if (ret < 0) {
 		input_err(true, &ts->client->dev, "%s: Unable to request threaded irq\n", __func__);
 		goto err_irq;
@@ -1955,6 +1972,10 @@ static int sec_ts_probe(struct i2c_client *client, const struct i2c_device_id *i
 		goto err_mmi_data;
 
 	sec_ts_set_input_prop(ts, ts->input_dev, INPUT_PROP_DIRECT);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* frames are stamped with the hard IRQ time by the class */
+	input_set_capability(ts->input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
 #ifdef USE_OPEN_CLOSE
 	ts->input_dev->open = sec_ts_input_open;
 	ts->input_dev->close = sec_ts_input_close;
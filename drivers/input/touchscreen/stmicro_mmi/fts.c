@@ -2780,6 +2780,23 @@ static void fts_user_report_event_handler(struct fts_ts_info *info, unsigned
 	}
 }
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/**
+  * Top Half Interrupt Handler function
+  * Stamp the frame with the IRQ time in the touchscreen class and wake
+  * the bottom half
+  */
+static irqreturn_t fts_event_irq(int irq, void *ptr)
+{
+	struct fts_ts_info *info = (struct fts_ts_info *)ptr;
+
+	ts_mmi_irq_timestamp(info->imports);
+	return IRQ_WAKE_THREAD;
+}
+#else
+#define fts_event_irq NULL
+#endif
+
 /**
   * Bottom Half Interrupt Handler function
   * This handler is called each time there is at least one new event in the FIFO
@@ -2826,7 +2843,11 @@ static irqreturn_t fts_event_handler(int irq, void *ptr)
 			event_handler(info, (data));
 		}
 	}
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(info->imports, info->input_dev);
+#else
 	input_sync(info->input_dev);
+#endif
 
 	return IRQ_HANDLED;
 }
@@ -3102,7 +3123,7 @@ static int fts_interrupt_install(struct fts_ts_info *info)
 	install_handler(info, STATUS_UPDATE, status);
 	install_handler(info, USER_REPORT, user_report);
 
-	error = request_threaded_irq(info->client->irq, NULL, fts_event_handler,
+	error = request_threaded_irq(info->client->irq, fts_event_irq, fts_event_handler,
 			 IRQF_TRIGGER_LOW|IRQF_ONESHOT, FTS_TS_DRV_NAME, info);
 	if (error < 0) {
 		logError(1, "%s Request threaded irq failed\n", tag);
@@ -4260,6 +4281,10 @@ static int fts_probe(struct spi_device *client)
 
 	__set_bit(EV_SYN, info->input_dev->evbit);
 	__set_bit(EV_KEY, info->input_dev->evbit);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* frames are stamped with the hard IRQ time by the class */
+	input_set_capability(info->input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
 	__set_bit(EV_ABS, info->input_dev->evbit);
 	__set_bit(BTN_TOUCH, info->input_dev->keybit);
 	/* __set_bit(BTN_TOOL_FINGER, info->input_dev->keybit); */
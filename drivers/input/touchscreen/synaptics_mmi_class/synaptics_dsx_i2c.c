@@ -48,6 +48,9 @@
 #endif
 
 #include <linux/mmi_device.h>
+#if defined(CONFIG_INPUT_TOUCHSCREEN_MMI)
+#include <linux/touchscreen_mmi.h>
+#endif
 #include "synaptics_dsx_i2c.h"
 
 #define PINCTRL_STATE_ACTIVE "active_state"
@@ -2076,6 +2079,10 @@ static int synaptics_dsx_alloc_input(struct synaptics_rmi4_data *rmi4_data)
 	/* enable power key injection */
 	set_bit(EV_KEY, rmi4_data->input_dev->evbit);
 	input_set_capability(rmi4_data->input_dev, EV_KEY, KEY_POWER);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* frames are stamped with the hard IRQ time by the class */
+	input_set_capability(rmi4_data->input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
 
 	pr_debug("allocated input device '%s'\n", rmi4_data->input_dev->name);
 
@@ -3944,7 +3951,11 @@ static int synaptics_rmi4_f12_abs_report(struct synaptics_rmi4_data *rmi4_data,
 	}
 
 	input_mt_report_pointer_emulation(rmi4_data->input_dev, false);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(rmi4_data->imports, rmi4_data->input_dev);
+#else
 	input_sync(rmi4_data->input_dev);
+#endif
 
 	return touch_count;
 }
@@ -4112,7 +4123,11 @@ static int synaptics_rmi4_f11_abs_report(struct synaptics_rmi4_data *rmi4_data,
 #endif
 
 	input_mt_report_pointer_emulation(rmi4_data->input_dev, false);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(rmi4_data->imports, rmi4_data->input_dev);
+#else
 	input_sync(rmi4_data->input_dev);
+#endif
 
 	return touch_count;
 }
@@ -4516,6 +4531,24 @@ static int synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 	return touch_count;
 }
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+ /**
+ * synaptics_rmi4_hard_irq()
+ *
+ * Top half of the attention irq. Records the time the sensor asserted
+ * attention before the ISR thread reads the finger data.
+ */
+static irqreturn_t synaptics_rmi4_hard_irq(int irq, void *data)
+{
+	struct synaptics_rmi4_data *rmi4_data = data;
+
+	ts_mmi_irq_timestamp(rmi4_data->imports);
+	return IRQ_WAKE_THREAD;
+}
+#else
+#define synaptics_rmi4_hard_irq NULL
+#endif
+
  /**
  * synaptics_rmi4_irq()
  *
@@ -4575,7 +4608,7 @@ int synaptics_rmi4_irq_enable(struct synaptics_rmi4_data *rmi4_data,
 		if (retval < 0)
 			return retval;
 
-		retval = request_threaded_irq(rmi4_data->irq, NULL,
+		retval = request_threaded_irq(rmi4_data->irq, synaptics_rmi4_hard_irq,
 				synaptics_rmi4_irq, platform_data->irq_flags,
 				rmi4_data->irq_name, rmi4_data);
 		if (retval < 0) {
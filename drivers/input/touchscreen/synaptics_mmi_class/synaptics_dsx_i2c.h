@@ -635,6 +635,9 @@ struct synaptics_rmi4_data {
 	struct touch_area_stats button_ud_stats;
 
 	struct synaptics_rmi4_func_packet_regs config_regs[MAX_CONFIG_REGS];
+#if defined(CONFIG_INPUT_TOUCHSCREEN_MMI)
+	struct ts_mmi_class_methods *imports;
+#endif
 };
 
 enum {
@@ -255,9 +255,13 @@ int synaptics_mmi_data_init(struct synaptics_rmi4_data *ts, bool enable)
 		ret = ts_mmi_dev_register(&ts->i2c_client->dev, &synaptics_mmi_methods);
 		if (ret)
 			dev_err(&ts->i2c_client->dev, "Failed to register ts mmi\n");
+		else
+			ts->imports = &synaptics_mmi_methods.exports;
 
-	} else
+	} else {
+		ts->imports = NULL;
 		ts_mmi_dev_unregister(&ts->i2c_client->dev);
+	}
 
 	return ret;
 }
@@ -480,7 +480,11 @@ static void syna_dev_report_input_events(struct syna_tcm *tcm)
 #endif
 	}
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(tcm->imports, input_dev);
+#else
 	input_sync(input_dev);
+#endif
 
 exit:
 	syna_pal_mutex_unlock(&tcm->tp_event_mutex);
@@ -530,6 +534,10 @@ static int syna_dev_create_input_device(struct syna_tcm *tcm)
 
 	set_bit(EV_SYN, input_dev->evbit);
 	set_bit(EV_KEY, input_dev->evbit);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* frames are stamped with the hard IRQ time by the class */
+	input_set_capability(input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
 	set_bit(EV_ABS, input_dev->evbit);
 	set_bit(BTN_TOUCH, input_dev->keybit);
 	set_bit(BTN_TOOL_FINGER, input_dev->keybit);
@@ -680,6 +688,31 @@ exit:
 	return retval;
 }
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/**
+ * syna_dev_hard_isr()
+ *
+ * Top half of the interrupt, stamps the frame with the IRQ time in the
+ * touchscreen class and wakes syna_dev_isr().
+ *
+ * @param
+ *    [ in] irq:  interrupt line
+ *    [ in] data: private data being passed to the handler function
+ *
+ * @return
+ *    IRQ_WAKE_THREAD.
+ */
+static irqreturn_t syna_dev_hard_isr(int irq, void *data)
+{
+	struct syna_tcm *tcm = data;
+
+	ts_mmi_irq_timestamp(tcm->imports);
+	return IRQ_WAKE_THREAD;
+}
+#else
+#define syna_dev_hard_isr NULL
+#endif
+
 /**
  * syna_dev_isr()
  *
@@ -788,16 +821,16 @@ static int syna_dev_request_irq(struct syna_tcm *tcm)
 #ifdef DEV_MANAGED_API
 	retval = devm_request_threaded_irq(dev,
 			attn->irq_id,
-			NULL,
+			syna_dev_hard_isr,
 			syna_dev_isr,
-			attn->irq_flags,
+			attn->irq_flags | IRQF_ONESHOT,
 			PLATFORM_DRIVER_NAME,
 			tcm);
 #else /* Legacy API */
 	retval = request_threaded_irq(attn->irq_id,
-			NULL,
+			syna_dev_hard_isr,
 			syna_dev_isr,
-			attn->irq_flags,
+			attn->irq_flags | IRQF_ONESHOT,
 			PLATFORM_DRIVER_NAME,
 			tcm);
 #endif
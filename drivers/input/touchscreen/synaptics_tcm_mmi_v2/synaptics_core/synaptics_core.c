@@ -1975,6 +1975,19 @@ static void syna_tcm_polling_work(struct work_struct *work)
 	return;
 }
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/* top half: stamp the frame in the class and wake the thread */
+static irqreturn_t syna_tcm_hard_isr(int irq, void *data)
+{
+	struct syna_tcm_hcd *tcm_hcd = data;
+
+	ts_mmi_irq_timestamp(tcm_hcd->imports);
+	return IRQ_WAKE_THREAD;
+}
+#else
+#define syna_tcm_hard_isr NULL
+#endif
+
 static irqreturn_t syna_tcm_isr(int irq, void *data)
 {
 	int retval;
@@ -2025,8 +2038,9 @@ static int syna_tcm_enable_irq(struct syna_tcm_hcd *tcm_hcd, bool en, bool ns)
 		}
 
 		if (irq_freed) {
-			retval = request_threaded_irq(tcm_hcd->irq, NULL,
-					syna_tcm_isr, bdata->irq_flags,
+			retval = request_threaded_irq(tcm_hcd->irq,
+					syna_tcm_hard_isr, syna_tcm_isr,
+					bdata->irq_flags | IRQF_ONESHOT,
 					PLATFORM_DRIVER_NAME, tcm_hcd);
 			if (retval < 0) {
 				LOGE(tcm_hcd->pdev->dev.parent,
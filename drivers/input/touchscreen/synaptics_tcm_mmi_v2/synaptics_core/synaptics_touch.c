@@ -868,7 +868,11 @@ static void touch_report(void)
 #endif
 	}
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(tcm_hcd->imports, touch_hcd->input_dev);
+#else
 	input_sync(touch_hcd->input_dev);
+#endif
 
 exit:
 	mutex_unlock(&touch_hcd->report_mutex);
@@ -995,6 +999,10 @@ static int touch_set_input_dev(void)
 
 	set_bit(EV_SYN, touch_hcd->input_dev->evbit);
 	set_bit(EV_KEY, touch_hcd->input_dev->evbit);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* frames are stamped with the hard IRQ time by the class */
+	input_set_capability(touch_hcd->input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
 	set_bit(EV_ABS, touch_hcd->input_dev->evbit);
 	set_bit(BTN_TOUCH, touch_hcd->input_dev->keybit);
 	set_bit(BTN_TOOL_FINGER, touch_hcd->input_dev->keybit);
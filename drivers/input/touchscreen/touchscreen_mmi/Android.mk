@@ -45,6 +45,10 @@ ifeq ($(TOUCHCLASS_MMI_EARLY_RESET_ON_RESUME),true)
 	KBUILD_OPTIONS += CONFIG_TOUCHSCREEN_EARLY_RESET_ON_RESUME=y
 endif
 
+ifeq ($(TOUCHCLASS_MMI_KUNIT_TEST),true)
+	KBUILD_OPTIONS += CONFIG_TOUCHSCREEN_MMI_KUNIT_TEST=y
+endif
+
 include $(CLEAR_VARS)
 LOCAL_MODULE := touchscreen_mmi.ko
 LOCAL_MODULE_TAGS := optional
@@ -59,3 +63,14 @@ endif
 KBUILD_OPTIONS_GKI += MODULE_KERNEL_VERSION=$(TARGET_KERNEL_VERSION)
 KBUILD_OPTIONS_GKI += GKI_OBJ_MODULE_DIR=gki
 include $(DLKM_DIR)/AndroidKernelModule.mk
+
+ifeq ($(TOUCHCLASS_MMI_KUNIT_TEST),true)
+include $(CLEAR_VARS)
+LOCAL_MODULE := touchscreen_mmi_kunit.ko
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_PATH := $(KERNEL_MODULES_OUT)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(KERNEL_MODULES_OUT)/touchscreen_mmi.ko
+KBUILD_OPTIONS_GKI += MODULE_KERNEL_VERSION=$(TARGET_KERNEL_VERSION)
+KBUILD_OPTIONS_GKI += GKI_OBJ_MODULE_DIR=gki
+include $(DLKM_DIR)/AndroidKernelModule.mk
+endif
@@ -0,0 +1,92 @@
+#!/bin/bash
+#
+# Capture touch latency statistics of a touchscreen_mmi class device.
+#
+# Resets /sys/class/touchscreen/<dev>/touch_latency, runs a capture and
+# prints the IRQ to input_sync latency and the report interval histograms
+# with their bucket ranges. Bucket n of both histograms counts values in
+# [2^(n-1), 2^n) us, the last bucket everything above.
+#
+# usage: touch_latency.sh [-s serial] [-d device] [-t seconds] [-- command...]
+#
+#   -s serial   adb device serial
+#   -d device   class device name, default the first one found
+#   -t seconds  capture length when no command is given, default 10
+#   command     run on the host instead of waiting, e.g.
+#               -- adb shell input swipe 200 1500 200 300 500
+#
+# Needs adb root, the attribute is only writable by root and system.
+
+serial=
+device=
+seconds=10
+
+while getopts "s:d:t:h" opt; do
+	case $opt in
+	s) serial="-s $OPTARG" ;;
+	d) device=$OPTARG ;;
+	t) seconds=$OPTARG ;;
+	*) sed -n '3,20p' "$0" | sed 's/^# \{0,1\}//'; exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ "$1" = "--" ] && shift
+
+ADB="adb $serial"
+CLASS=/sys/class/touchscreen
+
+if [ -z "$device" ]; then
+	device=$($ADB shell ls $CLASS | tr -d '\r' | head -n 1)
+	if [ -z "$device" ]; then
+		echo "no touchscreen class device found" >&2
+		exit 1
+	fi
+fi
+node=$CLASS/$device/touch_latency
+
+$ADB root > /dev/null
+$ADB wait-for-device
+
+if ! $ADB shell "echo 1 > $node"; then
+	echo "can't reset $node" >&2
+	exit 1
+fi
+
+if [ $# -gt 0 ]; then
+	echo "$device: capturing while running: $*"
+	"$@"
+else
+	echo "$device: capturing for ${seconds}s, touch the screen now"
+	sleep "$seconds"
+fi
+
+$ADB shell cat $node | tr -d '\r' | awk '
+function range(n) {
+	if (n == 0)
+		return "0us"
+	if (n == last)
+		return ">=" 2^(n - 1) "us"
+	return 2^(n - 1) "-" 2^n - 1 "us"
+}
+function hist(name, line,    f, n, i, total) {
+	n = split(line, f, " ")
+	last = n - 2
+	for (i = 2; i <= n; i++)
+		total += f[i]
+	printf "%s:\n", name
+	if (!total) {
+		printf "  (empty)\n"
+		return
+	}
+	for (i = 2; i <= n; i++)
+		if (f[i])
+			printf "  %-16s %8d %5.1f%%\n", range(i - 2), f[i], f[i] * 100 / total
+}
+/^lat_hist:/ { lat = $0; next }
+/^interval_hist:/ { interval = $0; next }
+{ print }
+END {
+	print ""
+	hist("irq to input_sync latency", lat)
+	hist("report interval", interval)
+}'
@@ -29,6 +29,8 @@
 #include <linux/slab.h>
 #include <linux/pinctrl/consumer.h>
 #include <linux/of.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #define FMT_STRING	"%s"
 #define FMT_INTEGER	"%d"
@@ -294,6 +296,8 @@ static ssize_t ts_mmi_doreflash_store(struct device *dev,
 	strlcpy(fw_path, buf, size);
 	dev_dbg(dev, "%s: FW filename: %s\n", __func__, fw_path);
 
+	/* the next resume must pick up the new image */
+	ts_mmi_fw_invalidate(NULL);
 	TRY_TO_CALL(firmware_update, fw_path);
 	if (ret < 0) {
 		dev_err(dev, "%s: firmware_update failed %d.\n", __func__, ret);
@@ -441,6 +445,213 @@ static ssize_t liquid_detection_ctl_store(struct device *dev,
 static DEVICE_ATTR(liquid_detection_ctl, (S_IWUSR | S_IWGRP | S_IRUGO),
 	liquid_detection_ctl_show, liquid_detection_ctl_store);
 
+/*
+ * Hard IRQ timestamps. Vendor drivers call ts_mmi_irq_timestamp() from the
+ * top half of their touch interrupt and end each frame with
+ * ts_mmi_input_sync() instead of input_sync(). The frame then carries the
+ * IRQ time instead of the time the thread got to run, and feeds the
+ * latency statistics. Until the device is registered both only fall back
+ * to plain input_sync().
+ */
+static inline int ts_mmi_latency_bucket(u64 us)
+{
+	return min_t(int, fls64(us), TS_MMI_LAT_BUCKETS - 1);
+}
+
+static void ts_mmi_latency_account(struct ts_mmi_latency *lat,
+	ktime_t irq_time)
+{
+	unsigned long flags;
+	ktime_t now;
+	u64 us;
+
+	now = ktime_get();
+	spin_lock_irqsave(&lat->lock, flags);
+	if (irq_time) {
+		us = ktime_us_delta(now, irq_time);
+		lat->frames++;
+		lat->lat_total_us += us;
+		if (us > lat->lat_max_us)
+			lat->lat_max_us = us;
+		lat->lat_hist[ts_mmi_latency_bucket(us)]++;
+	} else
+		lat->unmatched++;
+
+	if (lat->last_sync) {
+		us = ktime_us_delta(now, lat->last_sync);
+		if (us < TS_MMI_LAT_IDLE_US) {
+			lat->intervals++;
+			lat->interval_total_us += us;
+			lat->interval_hist[ts_mmi_latency_bucket(us)]++;
+		}
+	}
+	lat->last_sync = now;
+	spin_unlock_irqrestore(&lat->lock, flags);
+}
+
+void ts_mmi_irq_timestamp(struct ts_mmi_class_methods *imports)
+{
+	struct ts_mmi_latency *lat = imports ? READ_ONCE(imports->latency) : NULL;
+	unsigned long flags;
+
+	if (!lat)
+		return;
+
+	/*
+	 * Overwrite any older stamp: an IRQ that ended without a report
+	 * (gesture, status or debug frame) must not age the next frame.
+	 */
+	spin_lock_irqsave(&lat->lock, flags);
+	lat->irq_time = ktime_get();
+	spin_unlock_irqrestore(&lat->lock, flags);
+}
+EXPORT_SYMBOL(ts_mmi_irq_timestamp);
+
+void ts_mmi_input_sync(struct ts_mmi_class_methods *imports,
+	struct input_dev *input_dev)
+{
+	struct ts_mmi_latency *lat = imports ? READ_ONCE(imports->latency) : NULL;
+	unsigned long flags;
+	ktime_t irq_time = 0;
+
+	if (lat) {
+		spin_lock_irqsave(&lat->lock, flags);
+		irq_time = lat->irq_time;
+		lat->irq_time = 0;
+		spin_unlock_irqrestore(&lat->lock, flags);
+	}
+
+	if (irq_time) {
+		/* MSC_TIMESTAMP is a free running microsecond counter */
+		input_event(input_dev, EV_MSC, MSC_TIMESTAMP,
+			(u32)ktime_to_us(irq_time));
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 0)
+		input_set_timestamp(input_dev, irq_time);
+#endif
+	}
+	input_sync(input_dev);
+
+	if (lat) {
+		struct ts_mmi_dev *touch_cdev =
+			container_of(lat, struct ts_mmi_dev, latency);
+
+		ts_mmi_latency_account(lat, irq_time);
+		if (!READ_ONCE(touch_cdev->resume_timing.stage[TS_MMI_RESUME_FIRST_TOUCH]))
+			ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_FIRST_TOUCH);
+	}
+}
+EXPORT_SYMBOL(ts_mmi_input_sync);
+
+static ssize_t touch_latency_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct ts_mmi_dev *touch_cdev = dev_get_drvdata(dev);
+	struct ts_mmi_latency snap;
+	unsigned long flags;
+	ssize_t len;
+	int i;
+
+	spin_lock_irqsave(&touch_cdev->latency.lock, flags);
+	snap = touch_cdev->latency;
+	spin_unlock_irqrestore(&touch_cdev->latency.lock, flags);
+
+	len = scnprintf(buf, PAGE_SIZE,
+		"frames: %llu\nunmatched: %llu\n"
+		"latency_avg_us: %llu\nlatency_max_us: %llu\n"
+		"interval_avg_us: %llu\nreport_rate_hz: %llu\n",
+		snap.frames, snap.unmatched,
+		snap.frames ? div64_u64(snap.lat_total_us, snap.frames) : 0,
+		snap.lat_max_us,
+		snap.intervals ?
+			div64_u64(snap.interval_total_us, snap.intervals) : 0,
+		snap.interval_total_us ?
+			div64_u64(snap.intervals * USEC_PER_SEC,
+				snap.interval_total_us) : 0);
+
+	len += scnprintf(buf + len, PAGE_SIZE - len, "lat_hist:");
+	for (i = 0; i < TS_MMI_LAT_BUCKETS; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, " %u",
+			snap.lat_hist[i]);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\ninterval_hist:");
+	for (i = 0; i < TS_MMI_LAT_BUCKETS; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, " %u",
+			snap.interval_hist[i]);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+
+	return len;
+}
+
+/*
+ * Any write clears the statistics, so a test can reset, run a gesture
+ * script and read back the numbers for that run only. touch_latency.sh
+ * next to this file does that over adb and prints the histograms.
+ */
+static ssize_t touch_latency_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t size)
+{
+	struct ts_mmi_dev *touch_cdev = dev_get_drvdata(dev);
+	struct ts_mmi_latency *lat = &touch_cdev->latency;
+	unsigned long flags;
+
+	spin_lock_irqsave(&lat->lock, flags);
+	lat->irq_time = 0;
+	lat->last_sync = 0;
+	lat->frames = 0;
+	lat->unmatched = 0;
+	lat->lat_total_us = 0;
+	lat->lat_max_us = 0;
+	lat->intervals = 0;
+	lat->interval_total_us = 0;
+	memset(lat->lat_hist, 0, sizeof(lat->lat_hist));
+	memset(lat->interval_hist, 0, sizeof(lat->interval_hist));
+	spin_unlock_irqrestore(&lat->lock, flags);
+
+	return size;
+}
+static DEVICE_ATTR(touch_latency, (S_IWUSR | S_IWGRP | S_IRUGO),
+	touch_latency_show, touch_latency_store);
+
+static const char * const ts_mmi_resume_stage_names[TS_MMI_RESUME_STAGES] = {
+	[TS_MMI_RESUME_POWER]		= "power",
+	[TS_MMI_RESUME_START]		= "start",
+	[TS_MMI_RESUME_PRE]		= "pre_resume",
+	[TS_MMI_RESUME_READY]		= "ready",
+	[TS_MMI_RESUME_IRQ]		= "irq_on",
+	[TS_MMI_RESUME_POST]		= "post_resume",
+	[TS_MMI_RESUME_DONE]		= "done",
+	[TS_MMI_RESUME_DISPLAY_ON]	= "display_on",
+	[TS_MMI_RESUME_FIRST_TOUCH]	= "first_touch",
+};
+
+/*
+ * Stage times of the last resume in us since the first panel-on
+ * notification, -1 for stages that were not reached.
+ */
+static ssize_t resume_timing_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct ts_mmi_dev *touch_cdev = dev_get_drvdata(dev);
+	struct ts_mmi_resume_timing snap;
+	unsigned long flags;
+	ssize_t len = 0;
+	int i;
+
+	spin_lock_irqsave(&touch_cdev->resume_timing.lock, flags);
+	snap = touch_cdev->resume_timing;
+	spin_unlock_irqrestore(&touch_cdev->resume_timing.lock, flags);
+
+	len += scnprintf(buf + len, PAGE_SIZE - len, "staged: %d\n",
+		touch_cdev->pdata.staged_resume);
+	for (i = 0; i < TS_MMI_RESUME_STAGES; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s_us: %lld\n",
+			ts_mmi_resume_stage_names[i],
+			snap.start && snap.stage[i] ?
+				ktime_us_delta(snap.stage[i], snap.start) : -1LL);
+
+	return len;
+}
+static DEVICE_ATTR(resume_timing, S_IRUGO, resume_timing_show, NULL);
+
 static struct attribute *sysfs_class_attrs[] = {
 	&dev_attr_path.attr,
 	&dev_attr_vendor.attr,
@@ -474,6 +685,8 @@ static struct attribute *sysfs_class_attrs[] = {
 	&dev_attr_gesture.attr,
 #endif
 	&dev_attr_liquid_detection_ctl.attr,
+	&dev_attr_touch_latency.attr,
+	&dev_attr_resume_timing.attr,
 	NULL,
 };
 
@@ -857,6 +1070,8 @@ int ts_mmi_dev_register(struct device *parent,
 	touch_cdev->mdata = mdata;
 	mutex_init(&touch_cdev->extif_mutex);
 	mutex_init(&touch_cdev->method_mutex);
+	spin_lock_init(&touch_cdev->latency.lock);
+	spin_lock_init(&touch_cdev->resume_timing.lock);
 
 	ret = ts_mmi_parse_dt(touch_cdev, DEV_TS->of_node);
 	if (ret < 0) {
@@ -988,6 +1203,7 @@ int ts_mmi_dev_register(struct device *parent,
 		/* export report touch event function to vendor */
 		touch_cdev->mdata->exports.clip_touch_event = ts_mmi_clip_event_handler;
 	}
+	WRITE_ONCE(touch_cdev->mdata->exports.latency, &touch_cdev->latency);
 
 	dev_info(DEV_TS, "Registered touchscreen device: %s.\n", class_fname);
 
@@ -1045,6 +1261,7 @@ void ts_mmi_dev_unregister(struct device *parent)
 		dev_err(parent, "%s: device not registered before.\n", __func__);
 		return;
 	}
+	WRITE_ONCE(touch_cdev->mdata->exports.latency, NULL);
 	if (touch_cdev->pdata.gestures_enabled)
 		ts_mmi_gesture_remove(touch_cdev);
 	if (touch_cdev->pdata.cli_gestures_enabled)
@@ -1112,6 +1329,7 @@ static int __init touchscreens_init(void)
 
 static void __exit touchscreens_exit(void)
 {
+	ts_mmi_fw_invalidate(NULL);
 	if (touchscreens_class)
 		class_destroy(touchscreens_class);
 }
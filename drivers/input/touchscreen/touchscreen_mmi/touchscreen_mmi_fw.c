@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2024 Motorola Mobility LLC
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/device.h>
+#include <linux/err.h>
+#include <linux/firmware.h>
+#include <linux/i2c.h>
+#include <linux/spi/spi.h>
+#include <linux/crc32.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/touchscreen_mmi.h>
+
+/*
+ * Firmware image cache for the 0flash controllers, which download their
+ * firmware on every resume. The first ts_mmi_fw_get() of a file goes
+ * through request_firmware() and keeps a private copy, later calls hand
+ * out that copy as long as its checksum still matches. Entries only go
+ * away on an explicit firmware update or when the module is unloaded.
+ */
+static bool fw_cache = true;
+module_param(fw_cache, bool, 0644);
+MODULE_PARM_DESC(fw_cache, "keep touch firmware images in memory across resume");
+
+static LIST_HEAD(ts_mmi_fw_list);
+static DEFINE_MUTEX(ts_mmi_fw_mutex);
+
+static void ts_mmi_fw_release(struct kref *ref)
+{
+	struct ts_mmi_fw *fw = container_of(ref, struct ts_mmi_fw, ref);
+
+	if (fw->priv && fw->release)
+		fw->release(fw->priv);
+	vfree(fw->image);
+	kfree(fw);
+}
+
+static inline u32 ts_mmi_fw_crc(struct ts_mmi_fw *fw)
+{
+	return crc32_le(~0, fw->image, fw->fw.size);
+}
+
+static struct ts_mmi_fw *ts_mmi_fw_load(struct device *dev, const char *name,
+	int (*parse)(struct ts_mmi_fw *fw))
+{
+	const struct firmware *raw = NULL;
+	struct ts_mmi_fw *fw;
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = request_firmware(&raw, name, dev);
+	if (ret) {
+		dev_err(dev, "%s: request %s failed %d\n", __func__, name, ret);
+		return ERR_PTR(ret);
+	}
+
+	fw = kzalloc(sizeof(*fw), GFP_KERNEL);
+	if (!fw) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	fw->image = vmalloc(raw->size);
+	if (!fw->image) {
+		kfree(fw);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	memcpy(fw->image, raw->data, raw->size);
+	kref_init(&fw->ref);
+	INIT_LIST_HEAD(&fw->node);
+	strlcpy(fw->name, name, sizeof(fw->name));
+	fw->fw.data = fw->image;
+	fw->fw.size = raw->size;
+	fw->crc = ts_mmi_fw_crc(fw);
+
+	if (parse) {
+		ret = parse(fw);
+		if (ret) {
+			dev_err(dev, "%s: parse %s failed %d\n", __func__, name, ret);
+			kref_put(&fw->ref, ts_mmi_fw_release);
+			goto out;
+		}
+	}
+
+	dev_info(dev, "%s: %s loaded, size %zu crc %08x in %lld us\n", __func__,
+		name, fw->fw.size, fw->crc, ktime_us_delta(ktime_get(), start));
+out:
+	release_firmware(raw);
+	return ret ? ERR_PTR(ret) : fw;
+}
+
+/*
+ * ts_mmi_fw_get - get the image of firmware file @name
+ * @dev: device to request the firmware for
+ * @name: firmware file name
+ * @parse: optional, called once when the image is loaded to fill in
+ *         fw->priv and fw->release
+ *
+ * Returns the image with a reference the caller drops with
+ * ts_mmi_fw_put(), or an ERR_PTR.
+ */
+struct ts_mmi_fw *ts_mmi_fw_get(struct device *dev, const char *name,
+	int (*parse)(struct ts_mmi_fw *fw))
+{
+	struct ts_mmi_fw *fw;
+
+	if (!fw_cache)
+		return ts_mmi_fw_load(dev, name, parse);
+
+	mutex_lock(&ts_mmi_fw_mutex);
+	list_for_each_entry(fw, &ts_mmi_fw_list, node) {
+		if (strcmp(fw->name, name))
+			continue;
+
+		if (ts_mmi_fw_crc(fw) == fw->crc) {
+			kref_get(&fw->ref);
+			goto unlock;
+		}
+
+		dev_err(dev, "%s: cached %s is corrupted, reload\n",
+			__func__, name);
+		list_del_init(&fw->node);
+		kref_put(&fw->ref, ts_mmi_fw_release);
+		break;
+	}
+
+	fw = ts_mmi_fw_load(dev, name, parse);
+	if (!IS_ERR(fw)) {
+		/* one reference for the cache, one for the caller */
+		kref_get(&fw->ref);
+		list_add(&fw->node, &ts_mmi_fw_list);
+	}
+unlock:
+	mutex_unlock(&ts_mmi_fw_mutex);
+
+	return fw;
+}
+EXPORT_SYMBOL(ts_mmi_fw_get);
+
+void ts_mmi_fw_put(struct ts_mmi_fw *fw)
+{
+	if (!IS_ERR_OR_NULL(fw))
+		kref_put(&fw->ref, ts_mmi_fw_release);
+}
+EXPORT_SYMBOL(ts_mmi_fw_put);
+
+/*
+ * Drop the cached image of @name, or of every file when @name is NULL.
+ * Images still held by a caller are freed on their last ts_mmi_fw_put().
+ */
+void ts_mmi_fw_invalidate(const char *name)
+{
+	struct ts_mmi_fw *fw, *tmp;
+
+	mutex_lock(&ts_mmi_fw_mutex);
+	list_for_each_entry_safe(fw, tmp, &ts_mmi_fw_list, node) {
+		if (name && strcmp(fw->name, name))
+			continue;
+
+		list_del_init(&fw->node);
+		kref_put(&fw->ref, ts_mmi_fw_release);
+	}
+	mutex_unlock(&ts_mmi_fw_mutex);
+}
+EXPORT_SYMBOL(ts_mmi_fw_invalidate);
+
+/*
+ * Burst firmware download. The image goes out in the largest chunks both
+ * the controller and the bus take, staged through bounce buffers that are
+ * allocated once with the device. The host checksum is folded in while a
+ * chunk is staged, so the image is walked only once, and the controller
+ * status and checksum are only checked where the vendor asks for it.
+ */
+static size_t ts_mmi_fwdl_bus_max(struct device *dev)
+{
+	struct i2c_client *client;
+
+	if (dev->bus == &spi_bus_type)
+		return spi_max_transfer_size(to_spi_device(dev));
+
+	client = i2c_verify_client(dev);
+	if (client && client->adapter->quirks &&
+			client->adapter->quirks->max_write_len)
+		return client->adapter->quirks->max_write_len;
+
+	return SIZE_MAX;
+}
+
+int ts_mmi_fwdl_init(struct ts_mmi_fwdl *dl, struct device *dev,
+	u32 max_chunk, bool duplex)
+{
+	size_t bus_max = ts_mmi_fwdl_bus_max(dev);
+	u32 chunk = max_chunk;
+
+	if (!dl->ops || !dl->ops->write || bus_max <= dl->head)
+		return -EINVAL;
+
+	chunk = min_t(size_t, chunk, bus_max - dl->head);
+	if (dl->verify_len)
+		chunk = min(chunk, dl->verify_len);
+	/* keep chunks word aligned for the 16/32 bit controller checksums */
+	chunk = round_down(chunk, 4);
+	if (!chunk)
+		return -EINVAL;
+
+	/* kmalloc memory is DMA-safe, the vmalloc'ed images are not */
+	dl->tx = devm_kmalloc(dev, dl->head + chunk, GFP_KERNEL);
+	if (!dl->tx)
+		return -ENOMEM;
+
+	if (duplex) {
+		dl->rx = devm_kmalloc(dev, dl->head + chunk, GFP_KERNEL);
+		if (!dl->rx) {
+			devm_kfree(dev, dl->tx);
+			dl->tx = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	dl->dev = dev;
+	dl->chunk = chunk;
+	dev_info(dev, "%s: chunk %u, bus max %zu\n", __func__, chunk, bus_max);
+
+	return 0;
+}
+EXPORT_SYMBOL(ts_mmi_fwdl_init);
+
+/*
+ * Write @len bytes of @image to controller offset @offset, verifying each
+ * region as soon as its last chunk went out.
+ */
+int ts_mmi_fwdl_run(struct ts_mmi_fwdl *dl, u32 offset,
+	const u8 *image, u32 len)
+{
+	const struct ts_mmi_fwdl_ops *ops = dl->ops;
+	u32 region = dl->verify_len ? dl->verify_len : len;
+	u32 pos = 0, region_start = 0, sum = dl->sum_init, n;
+	unsigned int chunks = 0, unchecked = 0;
+	ktime_t start = ktime_get();
+	int ret = 0;
+
+	if (!dl->tx)
+		return -EINVAL;
+
+	while (pos < len) {
+		n = min3(dl->chunk, len - pos, region_start + region - pos);
+
+		memcpy(dl->tx + dl->head, image + pos, n);
+		if (ops->sum)
+			sum = ops->sum(sum, dl->tx + dl->head, n);
+
+		ret = ops->write(dl->priv, offset + pos, dl->tx, dl->rx, n);
+		if (ret < 0) {
+			dev_err(dl->dev, "%s: write at %u failed %d\n",
+				__func__, offset + pos, ret);
+			return ret;
+		}
+		pos += n;
+		chunks++;
+		unchecked++;
+
+		if (pos != len && pos != region_start + region &&
+				unchecked != dl->status_interval)
+			continue;
+
+		if (ops->status) {
+			ret = ops->status(dl->priv);
+			if (ret < 0) {
+				dev_err(dl->dev, "%s: status at %u failed %d\n",
+					__func__, offset + pos, ret);
+				return ret;
+			}
+		}
+		unchecked = 0;
+
+		if (pos != len && pos != region_start + region)
+			continue;
+
+		if (ops->verify) {
+			ret = ops->verify(dl->priv, offset + region_start,
+				pos - region_start, sum);
+			if (ret < 0) {
+				dev_err(dl->dev, "%s: verify at %u failed %d\n",
+					__func__, offset + region_start, ret);
+				return ret;
+			}
+		}
+		region_start = pos;
+		sum = dl->sum_init;
+	}
+
+	dev_dbg(dl->dev, "%s: %u bytes in %u chunks, %lld us\n", __func__,
+		len, chunks, ktime_us_delta(ktime_get(), start));
+
+	return 0;
+}
+EXPORT_SYMBOL(ts_mmi_fwdl_run);
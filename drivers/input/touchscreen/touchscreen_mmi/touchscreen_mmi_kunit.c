@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2026 Motorola Mobility LLC
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * KUnit tests of the hard IRQ timestamp helpers. A dummy input device is
+ * registered together with an input handler bound to it only, which
+ * records what ts_mmi_input_sync() emits. The class device is never
+ * registered: the test owns a zeroed ts_mmi_dev and points the exports
+ * at its latency statistics, as ts_mmi_dev_register() does.
+ */
+
+#include <kunit/test.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/input.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
+#include <linux/version.h>
+#include <linux/touchscreen_mmi.h>
+
+struct ts_mmi_kunit {
+	struct ts_mmi_dev *touch_cdev;
+	struct ts_mmi_class_methods exports;
+	struct input_dev *input_dev;
+	struct input_handler handler;
+	/* what the handler saw, updated under input_dev->event_lock */
+	int syncs;
+	int stamps;
+	u32 stamp_value;
+	ktime_t sync_time;
+};
+
+static bool ts_mmi_kunit_match(struct input_handler *handler,
+	struct input_dev *dev)
+{
+	struct ts_mmi_kunit *ctx =
+		container_of(handler, struct ts_mmi_kunit, handler);
+
+	return dev == ctx->input_dev;
+}
+
+static int ts_mmi_kunit_connect(struct input_handler *handler,
+	struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(*handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "ts_mmi_kunit";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void ts_mmi_kunit_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static void ts_mmi_kunit_event(struct input_handle *handle,
+	unsigned int type, unsigned int code, int value)
+{
+	struct ts_mmi_kunit *ctx =
+		container_of(handle->handler, struct ts_mmi_kunit, handler);
+
+	if (type == EV_MSC && code == MSC_TIMESTAMP) {
+		ctx->stamps++;
+		ctx->stamp_value = value;
+	} else if (type == EV_SYN && code == SYN_REPORT) {
+		ctx->syncs++;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 0)
+		ctx->sync_time = input_get_timestamp(handle->dev)[INPUT_CLK_MONO];
+#endif
+	}
+}
+
+/* matches everything, ts_mmi_kunit_match() narrows it to our device */
+static const struct input_device_id ts_mmi_kunit_ids[] = {
+	{ .driver_info = 1 },
+	{ },
+};
+
+static u64 ts_mmi_kunit_hist_sum(const u32 *hist)
+{
+	u64 sum = 0;
+	int i;
+
+	for (i = 0; i < TS_MMI_LAT_BUCKETS; i++)
+		sum += hist[i];
+	return sum;
+}
+
+static int ts_mmi_kunit_init(struct kunit *test)
+{
+	struct ts_mmi_kunit *ctx;
+	int ret;
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx);
+	ctx->touch_cdev = kunit_kzalloc(test, sizeof(*ctx->touch_cdev),
+		GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx->touch_cdev);
+
+	spin_lock_init(&ctx->touch_cdev->latency.lock);
+	spin_lock_init(&ctx->touch_cdev->resume_timing.lock);
+	ctx->exports.latency = &ctx->touch_cdev->latency;
+
+	ctx->input_dev = input_allocate_device();
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx->input_dev);
+	ctx->input_dev->name = "ts_mmi_kunit";
+	input_set_capability(ctx->input_dev, EV_MSC, MSC_TIMESTAMP);
+
+	ret = input_register_device(ctx->input_dev);
+	if (ret) {
+		input_free_device(ctx->input_dev);
+		KUNIT_ASSERT_EQ(test, ret, 0);
+	}
+
+	ctx->handler.name = "ts_mmi_kunit";
+	ctx->handler.id_table = ts_mmi_kunit_ids;
+	ctx->handler.match = ts_mmi_kunit_match;
+	ctx->handler.connect = ts_mmi_kunit_connect;
+	ctx->handler.disconnect = ts_mmi_kunit_disconnect;
+	ctx->handler.event = ts_mmi_kunit_event;
+
+	ret = input_register_handler(&ctx->handler);
+	if (ret) {
+		input_unregister_device(ctx->input_dev);
+		KUNIT_ASSERT_EQ(test, ret, 0);
+	}
+
+	test->priv = ctx;
+	return 0;
+}
+
+static void ts_mmi_kunit_exit(struct kunit *test)
+{
+	struct ts_mmi_kunit *ctx = test->priv;
+
+	input_unregister_handler(&ctx->handler);
+	input_unregister_device(ctx->input_dev);
+}
+
+static void ts_mmi_kunit_msc_timestamp(struct kunit *test)
+{
+	struct ts_mmi_kunit *ctx = test->priv;
+	struct ts_mmi_latency *lat = &ctx->touch_cdev->latency;
+	ktime_t stamp;
+
+	ts_mmi_irq_timestamp(&ctx->exports);
+	stamp = lat->irq_time;
+	KUNIT_ASSERT_NE(test, stamp, 0);
+
+	ts_mmi_input_sync(&ctx->exports, ctx->input_dev);
+
+	KUNIT_EXPECT_EQ(test, ctx->syncs, 1);
+	KUNIT_EXPECT_EQ(test, ctx->stamps, 1);
+	KUNIT_EXPECT_EQ(test, ctx->stamp_value, (u32)ktime_to_us(stamp));
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 0)
+	/* the frame carries the IRQ time, not the time of input_sync() */
+	KUNIT_EXPECT_EQ(test, ctx->sync_time, stamp);
+#endif
+}
+
+static void ts_mmi_kunit_stamp_consumed(struct kunit *test)
+{
+	struct ts_mmi_kunit *ctx = test->priv;
+	struct ts_mmi_latency *lat = &ctx->touch_cdev->latency;
+
+	ts_mmi_irq_timestamp(&ctx->exports);
+	ts_mmi_input_sync(&ctx->exports, ctx->input_dev);
+	KUNIT_EXPECT_EQ(test, lat->irq_time, 0);
+
+	/* a second frame without an IRQ has no stamp to report */
+	ts_mmi_input_sync(&ctx->exports, ctx->input_dev);
+	KUNIT_EXPECT_EQ(test, ctx->syncs, 2);
+	KUNIT_EXPECT_EQ(test, ctx->stamps, 1);
+	KUNIT_EXPECT_EQ(test, lat->frames, 1);
+	KUNIT_EXPECT_EQ(test, lat->unmatched, 1);
+}
+
+static void ts_mmi_kunit_stamp_overwritten(struct kunit *test)
+{
+	struct ts_mmi_kunit *ctx = test->priv;
+	struct ts_mmi_latency *lat = &ctx->touch_cdev->latency;
+	ktime_t first, second;
+
+	/* an IRQ that ended without a report is superseded by the next one */
+	ts_mmi_irq_timestamp(&ctx->exports);
+	first = lat->irq_time;
+	udelay(100);
+	ts_mmi_irq_timestamp(&ctx->exports);
+	second = lat->irq_time;
+	KUNIT_ASSERT_GT(test, second, first);
+
+	ts_mmi_input_sync(&ctx->exports, ctx->input_dev);
+	KUNIT_EXPECT_EQ(test, ctx->stamps, 1);
+	KUNIT_EXPECT_EQ(test, ctx->stamp_value, (u32)ktime_to_us(second));
+	KUNIT_EXPECT_EQ(test, lat->frames, 1);
+	KUNIT_EXPECT_LT(test, lat->lat_max_us,
+		(u64)ktime_us_delta(ktime_get(), first));
+}
+
+static void ts_mmi_kunit_latency_accounting(struct kunit *test)
+{
+	struct ts_mmi_kunit *ctx = test->priv;
+	struct ts_mmi_latency *lat = &ctx->touch_cdev->latency;
+	unsigned long flags;
+
+	/* 2500us back lands in bucket 12, [2048, 4096) us */
+	spin_lock_irqsave(&lat->lock, flags);
+	lat->irq_time = ktime_sub_us(ktime_get(), 2500);
+	spin_unlock_irqrestore(&lat->lock, flags);
+	ts_mmi_input_sync(&ctx->exports, ctx->input_dev);
+
+	KUNIT_EXPECT_EQ(test, lat->frames, 1);
+	KUNIT_EXPECT_EQ(test, lat->unmatched, 0);
+	KUNIT_EXPECT_GE(test, lat->lat_total_us, 2500ULL);
+	KUNIT_EXPECT_EQ(test, lat->lat_max_us, lat->lat_total_us);
+	KUNIT_EXPECT_EQ(test, lat->lat_hist[12], 1);
+	KUNIT_EXPECT_EQ(test, ts_mmi_kunit_hist_sum(lat->lat_hist), 1);
+	/* the first frame of a touch has no interval */
+	KUNIT_EXPECT_EQ(test, lat->intervals, 0);
+	KUNIT_EXPECT_NE(test, lat->last_sync, 0);
+
+	ts_mmi_irq_timestamp(&ctx->exports);
+	ts_mmi_input_sync(&ctx->exports, ctx->input_dev);
+
+	KUNIT_EXPECT_EQ(test, lat->frames, 2);
+	KUNIT_EXPECT_EQ(test, ts_mmi_kunit_hist_sum(lat->lat_hist), 2);
+	KUNIT_EXPECT_EQ(test, lat->intervals, 1);
+	KUNIT_EXPECT_EQ(test, ts_mmi_kunit_hist_sum(lat->interval_hist), 1);
+	KUNIT_EXPECT_LT(test, lat->interval_total_us, (u64)TS_MMI_LAT_IDLE_US);
+}
+
+static void ts_mmi_kunit_idle_gap(struct kunit *test)
+{
+	struct ts_mmi_kunit *ctx = test->priv;
+	struct ts_mmi_latency *lat = &ctx->touch_cdev->latency;
+	unsigned long flags;
+
+	/* a gap longer than TS_MMI_LAT_IDLE_US starts a new touch */
+	spin_lock_irqsave(&lat->lock, flags);
+	lat->last_sync = ktime_sub_us(ktime_get(), 2 * TS_MMI_LAT_IDLE_US);
+	spin_unlock_irqrestore(&lat->lock, flags);
+
+	ts_mmi_irq_timestamp(&ctx->exports);
+	ts_mmi_input_sync(&ctx->exports, ctx->input_dev);
+
+	KUNIT_EXPECT_EQ(test, lat->frames, 1);
+	KUNIT_EXPECT_EQ(test, lat->intervals, 0);
+	KUNIT_EXPECT_EQ(test, ts_mmi_kunit_hist_sum(lat->interval_hist), 0);
+}
+
+static void ts_mmi_kunit_unregistered(struct kunit *test)
+{
+	struct ts_mmi_kunit *ctx = test->priv;
+	struct ts_mmi_latency *lat = &ctx->touch_cdev->latency;
+
+	/* before registration both fall back to a plain input_sync() */
+	ts_mmi_irq_timestamp(NULL);
+	ts_mmi_input_sync(NULL, ctx->input_dev);
+
+	ctx->exports.latency = NULL;
+	ts_mmi_irq_timestamp(&ctx->exports);
+	ts_mmi_input_sync(&ctx->exports, ctx->input_dev);
+
+	KUNIT_EXPECT_EQ(test, ctx->syncs, 2);
+	KUNIT_EXPECT_EQ(test, ctx->stamps, 0);
+	KUNIT_EXPECT_EQ(test, lat->irq_time, 0);
+	KUNIT_EXPECT_EQ(test, lat->frames, 0);
+	KUNIT_EXPECT_EQ(test, lat->unmatched, 0);
+}
+
+static struct kunit_case ts_mmi_kunit_cases[] = {
+	KUNIT_CASE(ts_mmi_kunit_msc_timestamp),
+	KUNIT_CASE(ts_mmi_kunit_stamp_consumed),
+	KUNIT_CASE(ts_mmi_kunit_stamp_overwritten),
+	KUNIT_CASE(ts_mmi_kunit_latency_accounting),
+	KUNIT_CASE(ts_mmi_kunit_idle_gap),
+	KUNIT_CASE(ts_mmi_kunit_unregistered),
+	{ }
+};
+
+static struct kunit_suite ts_mmi_kunit_suite = {
+	.name = "touchscreen_mmi_latency",
+	.init = ts_mmi_kunit_init,
+	.exit = ts_mmi_kunit_exit,
+	.test_cases = ts_mmi_kunit_cases,
+};
+kunit_test_suite(ts_mmi_kunit_suite);
+
+MODULE_DESCRIPTION("touchscreen_mmi hard IRQ timestamp tests");
+MODULE_LICENSE("GPL v2");
@@ -41,6 +41,47 @@ extern struct blocking_notifier_head dsi_freq_head;
 					touch_cdev->mdata->power && \
 					IS_DEEPSLEEP_MODE)
 
+/*
+ * Resume stage timing. The first panel-on notification after a suspend
+ * starts a new record and every stage keeps the time it was first reached,
+ * so the record of the last resume stays readable until the next one.
+ */
+static void ts_mmi_resume_arm(struct ts_mmi_dev *touch_cdev)
+{
+	struct ts_mmi_resume_timing *t = &touch_cdev->resume_timing;
+	unsigned long flags;
+
+	spin_lock_irqsave(&t->lock, flags);
+	t->pending = true;
+	spin_unlock_irqrestore(&t->lock, flags);
+}
+
+static void ts_mmi_resume_begin(struct ts_mmi_dev *touch_cdev)
+{
+	struct ts_mmi_resume_timing *t = &touch_cdev->resume_timing;
+	unsigned long flags;
+
+	spin_lock_irqsave(&t->lock, flags);
+	if (t->pending) {
+		t->pending = false;
+		t->start = ktime_get();
+		memset(t->stage, 0, sizeof(t->stage));
+	}
+	spin_unlock_irqrestore(&t->lock, flags);
+}
+
+void ts_mmi_resume_mark(struct ts_mmi_dev *touch_cdev,
+	enum ts_mmi_resume_stage stage)
+{
+	struct ts_mmi_resume_timing *t = &touch_cdev->resume_timing;
+	unsigned long flags;
+
+	spin_lock_irqsave(&t->lock, flags);
+	if (!t->pending && t->start && !t->stage[stage])
+		t->stage[stage] = ktime_get();
+	spin_unlock_irqrestore(&t->lock, flags);
+}
+
 static int ts_mmi_panel_off(struct ts_mmi_dev *touch_cdev) {
 	int ret = 0;
 
@@ -48,6 +89,7 @@ static int ts_mmi_panel_off(struct ts_mmi_dev *touch_cdev) {
 		return 0;
 
 	atomic_set(&touch_cdev->resume_should_stop, 1);
+	ts_mmi_resume_arm(touch_cdev);
 
 	TRY_TO_CALL(pre_suspend);
 	if (touch_cdev->pdata.gestures_enabled || touch_cdev->pdata.cli_gestures_enabled ||
@@ -119,12 +161,18 @@ static int ts_mmi_panel_event_handle(struct ts_mmi_dev *touch_cdev, enum ts_mmi_
 		break;
 
 	case TS_MMI_EVENT_PRE_DISPLAY_ON:
+		ts_mmi_resume_begin(touch_cdev);
 #ifdef CONFIG_TOUCHSCREEN_EARLY_RESET_ON_RESUME
 		if (NEED_TO_SET_POWER) {
 			/* powering on early */
 			TRY_TO_CALL(power, TS_MMI_POWER_ON);
+			ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_POWER);
 			dev_dbg(DEV_MMI, "%s: touch powered on\n", __func__);
+			if (touch_cdev->pdata.staged_resume)
+				ts_mmi_panel_on(touch_cdev);
 		} else {
+			/* power was left on, the controller is already up */
+			ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_POWER);
 			dev_info(DEV_MMI, "%s: ts_mmi_panel_on\n", __func__);
 			ts_mmi_panel_on(touch_cdev);
 		}
@@ -132,6 +180,7 @@ static int ts_mmi_panel_event_handle(struct ts_mmi_dev *touch_cdev, enum ts_mmi_
 		if (NEED_TO_SET_POWER) {
 			/* powering on early */
 			TRY_TO_CALL(power, TS_MMI_POWER_ON);
+			ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_POWER);
 			dev_dbg(DEV_MMI, "%s: touch powered on\n", __func__);
 		} else if (touch_cdev->pdata.reset &&
 			touch_cdev->mdata->reset) {
@@ -140,18 +189,37 @@ static int ts_mmi_panel_event_handle(struct ts_mmi_dev *touch_cdev, enum ts_mmi_
 			 */
 			dev_dbg(DEV_MMI, "%s: resetting...\n", __func__);
 			TRY_TO_CALL(reset, TS_MMI_RESET_HARD);
+			ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_POWER);
+		}
+
+		if (touch_cdev->pdata.staged_resume) {
+			/* Queue the resume now, so the controller boots and
+			 * downloads its firmware while the display powers up
+			 * instead of after DISPLAY_ON.
+			 */
+			if (NEED_TO_SET_PINCTRL) {
+				TRY_TO_CALL(pinctrl, TS_MMI_PINCTL_ON);
+				dev_dbg(DEV_MMI, "%s: touch pinctrl_on\n", __func__);
+			}
+			ts_mmi_panel_on(touch_cdev);
 		}
 #endif
 		break;
 
 	case TS_MMI_EVENT_DISPLAY_ON:
+		/* no PRE_DISPLAY_ON from some panels, start timing here */
+		ts_mmi_resume_begin(touch_cdev);
+		ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_DISPLAY_ON);
 #ifdef CONFIG_TOUCHSCREEN_EARLY_RESET_ON_RESUME
 		if (NEED_TO_SET_POWER) {
 			ts_mmi_panel_on(touch_cdev);
 		}
 #else
-		/* out of reset to allow wait for boot complete */
-		if (NEED_TO_SET_PINCTRL) {
+		/* out of reset to allow wait for boot complete,
+		 * already done on PRE_DISPLAY_ON for a staged resume,
+		 * which may still be running.
+		 */
+		if (!touch_cdev->pdata.staged_resume && NEED_TO_SET_PINCTRL) {
 			TRY_TO_CALL(pinctrl, TS_MMI_PINCTL_ON);
 			dev_dbg(DEV_MMI, "%s: touch pinctrl_on\n", __func__);
 		}
@@ -266,6 +334,8 @@ static void ts_mmi_queued_resume(struct ts_mmi_dev *touch_cdev)
 	if (atomic_cmpxchg(&touch_cdev->touch_stopped, 1, 0) == 0)
 		return;
 
+	ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_START);
+
 #ifdef TS_MMI_TOUCH_MULTIWAY_UPDATE_FW
 	if (touch_cdev->flash_mode == FW_PARAM_MODE &&\
 			touch_cdev->pdata.fw_load_resume) {
@@ -275,6 +345,7 @@ static void ts_mmi_queued_resume(struct ts_mmi_dev *touch_cdev)
 #endif
 
 	TRY_TO_CALL(pre_resume);
+	ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_PRE);
 
 	/* touch IC baseline update always done when IC resume.
 	 * So touchscreen class need let vendor driver know baseline update work need to be done
@@ -307,6 +378,7 @@ static void ts_mmi_queued_resume(struct ts_mmi_dev *touch_cdev)
 		TRY_TO_CALL(panel_state, touch_cdev->pm_mode, TS_MMI_PM_ACTIVE);
 		wait4_boot_complete = false;
 	}
+	ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_READY);
 
 	if (wait4_boot_complete) {
 		/* IC is just power on or reseted.
@@ -318,8 +390,10 @@ static void ts_mmi_queued_resume(struct ts_mmi_dev *touch_cdev)
 
 	if (IS_DEEPSLEEP_MODE)
 		TRY_TO_CALL(drv_irq, TS_MMI_IRQ_ON);
+	ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_IRQ);
 
 	TRY_TO_CALL(post_resume);
+	ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_POST);
 
 	/* Incase user space interface is R/W during restore cached value,
 	 * hold extif mutex when restore those values.
@@ -328,6 +402,7 @@ static void ts_mmi_queued_resume(struct ts_mmi_dev *touch_cdev)
 	ts_mmi_restore_settings(touch_cdev);
 	touch_cdev->pm_mode = TS_MMI_PM_ACTIVE;
 	mutex_unlock(&touch_cdev->extif_mutex);
+	ts_mmi_resume_mark(touch_cdev, TS_MMI_RESUME_DONE);
 	dev_info(DEV_MMI, "%s: done\n", __func__);
 }
 
@@ -85,6 +85,11 @@ int ts_mmi_parse_dt(struct ts_mmi_dev *touch_cdev,
 		}
 	}
 
+	if (of_property_read_bool(of_node, "mmi,staged-resume")) {
+		dev_info(DEV_TS, "%s: start resume on early panel on\n", __func__);
+		ppdata->staged_resume = true;
+	}
+
 	if (of_property_read_bool(of_node, "mmi,enable-gestures")) {
 		dev_info(DEV_TS, "%s: using enable gestures\n", __func__);
 		ppdata->gestures_enabled = true;
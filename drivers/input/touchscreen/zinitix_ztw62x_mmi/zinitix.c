@@ -2282,6 +2282,19 @@ void clear_report_data(struct bt541_ts_info *info)
 #define	PALM_REPORT_WIDTH	200
 #define	PALM_REJECT_WIDTH	255
 
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+/* top half: stamp the frame in the class and wake the thread */
+static irqreturn_t bt541_touch_irq(int irq, void *data)
+{
+	struct bt541_ts_info *info = data;
+
+	ts_mmi_irq_timestamp(info->imports);
+	return IRQ_WAKE_THREAD;
+}
+#else
+#define bt541_touch_irq NULL
+#endif
+
 static irqreturn_t bt541_touch_work(int irq, void *data)
 {
 	struct bt541_ts_info *info = (struct bt541_ts_info *)data;
@@ -2512,7 +2525,11 @@ static irqreturn_t bt541_touch_work(int irq, void *data)
 			}
 		}
 		memset(&info->reported_touch_info, 0x0, sizeof(struct point_info));
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+		ts_mmi_input_sync(info->imports, info->input_dev);
+#else
 		input_sync(info->input_dev);
+#endif
 
 		if (reported == true) /* for button event */
 			udelay(100);
@@ -2658,7 +2675,11 @@ static irqreturn_t bt541_touch_work(int irq, void *data)
 	}
 	memcpy((char *)&info->reported_touch_info, (char *)&info->touch_info,
 		sizeof(struct point_info));
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	ts_mmi_input_sync(info->imports, info->input_dev);
+#else
 	input_sync(info->input_dev);
+#endif
 
 out:
 
@@ -6181,6 +6202,10 @@ static int bt541_ts_probe(struct i2c_client *client,
 
 	set_bit(EV_SYN, info->input_dev->evbit);
 	set_bit(EV_KEY, info->input_dev->evbit);
+#ifdef CONFIG_INPUT_TOUCHSCREEN_MMI
+	/* frames are stamped with the hard IRQ time by the class */
+	input_set_capability(info->input_dev, EV_MSC, MSC_TIMESTAMP);
+#endif
 	set_bit(EV_ABS, info->input_dev->evbit);
 	set_bit(BTN_TOUCH, info->input_dev->keybit);
 
@@ -6292,7 +6317,7 @@ static int bt541_ts_probe(struct i2c_client *client,
 	info->irq_enabled = true;
 
 	pdata->tsp_irq = info->irq;
-	ret = request_threaded_irq(info->irq, NULL, bt541_touch_work,
+	ret = request_threaded_irq(info->irq, bt541_touch_irq, bt541_touch_work,
 		IRQF_TRIGGER_FALLING | IRQF_ONESHOT , BT541_TS_DEVICE, info);
 
 	if (ret) {
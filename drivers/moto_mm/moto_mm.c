@@ -17,14 +17,161 @@
 #include <linux/types.h>
 #include <trace/hooks/vmscan.h>
 #include <linux/swap.h>
+#include <linux/vmstat.h>
+#include <linux/workqueue.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
+static bool dynamic_inactive_ratio = true;
+module_param(dynamic_inactive_ratio, bool, 0644);
+MODULE_PARM_DESC(dynamic_inactive_ratio, "Adjust the inactive ratio from refault rates");
+
+static unsigned int inactive_ratio_period_ms = 1000;
+module_param(inactive_ratio_period_ms, uint, 0644);
+MODULE_PARM_DESC(inactive_ratio_period_ms, "Refault sampling period");
+
+/* refaults per second below which the ratio is left alone */
+static unsigned int refault_rate_floor = 256;
+module_param(refault_rate_floor, uint, 0644);
+MODULE_PARM_DESC(refault_rate_floor, "Refaults/s below which the ratio is not adjusted");
+
+/*
+ * Inactive ratio controller.
+ *
+ * The hook doesn't say which lruvec it is asked about, so refaults are
+ * sampled node wide, separately for file and anon. The ratio is held while
+ * the refault rate stays within 1/8 of the reference rate, which slowly
+ * follows it. Only when the rate gets worse than that does the ratio take
+ * one step: back the way it came if the previous period was a step, which
+ * evidently didn't help, otherwise on in the current direction. So the
+ * ratio settles on a step that doesn't make refaults worse and stays there
+ * until the workload changes.
+ */
+struct ratio_ctl {
+	const char			*name;
+	enum node_stat_item	refault_item;
+	unsigned long		last_refaults;
+	unsigned long		rate;
+	unsigned long		ref_rate;
+	unsigned long		adjustments;
+	bool				stepped;
+	int					ratio;
+	int					dir;
+	int					min;
+	int					max;
+};
+
+static struct ratio_ctl ratio_ctls[2] = {
+	[0] = {
+		.name = "anon",
+		.refault_item = WORKINGSET_REFAULT_ANON,
+		.ratio = 1,
+		.dir = 1,
+		.min = 1,
+		.max = 2,
+	},
+	[1] = {
+		.name = "file",
+		.refault_item = WORKINGSET_REFAULT_FILE,
+		.ratio = 2,
+		.dir = -1,
+		.min = 1,
+		.max = 4,
+	},
+};
+
+static void ratio_ctl_update(struct ratio_ctl *ctl, unsigned int period_ms)
+{
+	unsigned long refaults = global_node_page_state(ctl->refault_item);
+	int ratio = ctl->ratio;
+	bool stepped = ctl->stepped;
+
+	ctl->rate = (refaults - ctl->last_refaults) * MSEC_PER_SEC / period_ms;
+	ctl->last_refaults = refaults;
+	ctl->stepped = false;
+
+	/* hold within the 1/8 band, and follow slow drift of the rate */
+	if (ctl->rate < refault_rate_floor ||
+			ctl->rate <= ctl->ref_rate + ctl->ref_rate / 8) {
+		ctl->ref_rate = (ctl->ref_rate * 3 + ctl->rate) / 4;
+		return;
+	}
+
+	/* worse: undo the last step, or try the next one */
+	if (stepped)
+		ctl->dir = -ctl->dir;
+
+	ratio += ctl->dir;
+	if (ratio < ctl->min || ratio > ctl->max) {
+		/* at the bound, only the other way is left for next time */
+		ctl->dir = -ctl->dir;
+		ratio = ctl->ratio;
+	}
+
+	ctl->ref_rate = ctl->rate;
+	if (ratio != ctl->ratio) {
+		WRITE_ONCE(ctl->ratio, ratio);
+		ctl->adjustments++;
+		ctl->stepped = true;
+	}
+}
+
+/*
+ * Deferrable, so an idle device isn't woken up to sample. The rates are
+ * computed over the time that actually passed, which is longer than the
+ * period when the work was deferred.
+ */
+static void inactive_ratio_work_func(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(inactive_ratio_work, inactive_ratio_work_func);
+static unsigned long inactive_ratio_last;
+
+static void inactive_ratio_work_func(struct work_struct *work)
+{
+	unsigned int period_ms = max(inactive_ratio_period_ms, 100U);
+	unsigned int elapsed_ms = max(jiffies_to_msecs(jiffies - inactive_ratio_last), 1U);
+	int i;
+
+	inactive_ratio_last = jiffies;
+	if (READ_ONCE(dynamic_inactive_ratio)) {
+		for (i = 0; i < ARRAY_SIZE(ratio_ctls); i++)
+			ratio_ctl_update(&ratio_ctls[i], elapsed_ms);
+	}
+
+	queue_delayed_work(system_power_efficient_wq, &inactive_ratio_work,
+			msecs_to_jiffies(period_ms));
+}
+
+static int inactive_ratio_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	seq_printf(m, "dynamic=%d\n", dynamic_inactive_ratio);
+	for (i = 0; i < ARRAY_SIZE(ratio_ctls); i++) {
+		struct ratio_ctl *ctl = &ratio_ctls[i];
+
+		seq_printf(m, "%s ratio=%d range=[%d,%d] refaults/s=%lu ref=%lu adjustments=%lu\n",
+				ctl->name, READ_ONCE(ctl->ratio), ctl->min, ctl->max,
+				ctl->rate, ctl->ref_rate, ctl->adjustments);
+	}
+
+	return 0;
+}
 
 static void tune_inactive_ratio_hook(void *data, unsigned long *inactive_ratio, int file)
 {
+	if (!READ_ONCE(dynamic_inactive_ratio)) {
+		if (file)
+			*inactive_ratio = min(2UL, *inactive_ratio);
+		else
+			*inactive_ratio = 1;
+		return;
+	}
+
+	/* never go above what the kernel computed for the file list */
 	if (file)
-		*inactive_ratio = min(2UL, *inactive_ratio);
+		*inactive_ratio = min_t(unsigned long, READ_ONCE(ratio_ctls[1].ratio), *inactive_ratio);
 	else
-		*inactive_ratio = 1;
+		*inactive_ratio = READ_ONCE(ratio_ctls[0].ratio);
 
 	return;
 }
@@ -71,12 +218,23 @@ static int __init moto_mm_init(void)
 		return ret;
 	}
 
+	ratio_ctls[0].last_refaults = global_node_page_state(ratio_ctls[0].refault_item);
+	ratio_ctls[1].last_refaults = global_node_page_state(ratio_ctls[1].refault_item);
+	inactive_ratio_last = jiffies;
+	queue_delayed_work(system_power_efficient_wq, &inactive_ratio_work,
+			msecs_to_jiffies(inactive_ratio_period_ms));
+
+	if (!proc_create_single("moto_mm_inactive_ratio", 0444, NULL, inactive_ratio_show))
+		pr_warn("failed to create proc node moto_mm_inactive_ratio\n");
+
 	pr_info("moto_mm_init succeed!\n");
 	return 0;
 }
 
 static void __exit moto_mm_exit(void)
 {
+	remove_proc_entry("moto_mm_inactive_ratio", NULL);
+	cancel_delayed_work_sync(&inactive_ratio_work);
 	unregister_all_hook();
 
 	pr_info("moto_mm_exit succeed!\n");
@@ -15,11 +15,744 @@
 #include <trace/hooks/mm.h>
 #include <linux/pagemap.h>
 #include <linux/version.h>
+#include <linux/hash.h>
+#include <linux/jiffies.h>
+#include <linux/mm.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/fadvise.h>
+#include <linux/fs.h>
+#include <linux/mm_types.h>
+#include <linux/mmap_lock.h>
+#include <linux/slab.h>
+#include <linux/tracepoint.h>
+#include <linux/uaccess.h>
+#include <linux/uidgid.h>
+#include <linux/workqueue.h>
+#include <linux/cred.h>
 
 static int max_ra_pages = -1;
 module_param(max_ra_pages, int, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(max_ra_pages, "Max read ahead pages");
 
+static int max_adaptive_ra_pages = 128;
+module_param(max_adaptive_ra_pages, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(max_adaptive_ra_pages, "Max read ahead pages for sequential fault streams");
+
+static int min_ra_pages = 2;
+module_param(min_ra_pages, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(min_ra_pages, "Min read ahead pages for sparse fault streams");
+
+/*
+ * Adaptive readaround.
+ *
+ * Faults are grouped into streams, one per file region. A fault landing in or
+ * right after the previous window of its stream is a hit and doubles the
+ * window, up to max_adaptive_ra_pages, or max_ra_pages under memory pressure.
+ * A fault near the stream but outside its window is a miss: the previous
+ * window is counted as waste and the window is halved, down to min_ra_pages.
+ *
+ * The stream key is the mapping of the faulting file, so files faulted by
+ * the same process don't break each other's streams.
+ *
+ * Memory pressure is sampled by ra_mem_work every RA_MEM_SAMPLE_MS, the
+ * fault path only reads the cached result. The work is deferrable, so an
+ * idle cpu isn't woken up just to sample.
+ */
+#define RA_STREAM_BUCKET_BITS	4
+#define RA_STREAM_WAYS			8
+/* a fault this close to a stream, in pages, belongs to it */
+#define RA_STREAM_NEAR			256
+#define RA_MEM_SAMPLE_MS		1000
+
+struct ra_stream {
+	const void		*key;
+	/* identity of the file, for ra_stats only */
+	dev_t			dev;
+	unsigned long	ino;
+	pgoff_t			start;
+	unsigned int	size;
+	unsigned int	window;
+	unsigned long	hits;
+	unsigned long	misses;
+	unsigned long	waste;
+	unsigned long	last_used;
+};
+
+struct ra_stream_bucket {
+	spinlock_t		lock;
+	struct ra_stream	streams[RA_STREAM_WAYS];
+};
+
+static struct ra_stream_bucket ra_buckets[1 << RA_STREAM_BUCKET_BITS];
+
+static atomic_long_t ra_total_hits;
+static atomic_long_t ra_total_misses;
+static atomic_long_t ra_total_waste;
+static atomic_long_t ra_total_streams;
+
+static bool ra_mem_low;
+
+static void ra_mem_sample(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(ra_mem_work, ra_mem_sample);
+
+static void ra_mem_sample(struct work_struct *work)
+{
+	WRITE_ONCE(ra_mem_low, si_mem_available() < totalram_pages() / 8);
+	queue_delayed_work(system_power_efficient_wq, &ra_mem_work,
+			msecs_to_jiffies(RA_MEM_SAMPLE_MS));
+}
+
+static unsigned int ra_window_cap(void)
+{
+	/* under memory pressure never grow past the static limit */
+	if (READ_ONCE(ra_mem_low))
+		return max_ra_pages;
+
+	return max(max_ra_pages, max_adaptive_ra_pages);
+}
+
+/*
+ * Account the fault at @pgoff and compute the readaround window for it.
+ * Return true if the fault continues a sequential stream, in which case the
+ * window should be read forward from @pgoff.
+ */
+static bool ra_stream_update(struct address_space *mapping, pgoff_t pgoff, unsigned int *window)
+{
+	const void *key = mapping;
+	struct ra_stream_bucket *bucket = &ra_buckets[hash_ptr((void *)key, RA_STREAM_BUCKET_BITS)];
+	struct ra_stream *s, *near = NULL, *victim = NULL;
+	bool hit = false;
+	int i;
+
+	spin_lock(&bucket->lock);
+	for (i = 0; i < RA_STREAM_WAYS; i++) {
+		s = &bucket->streams[i];
+
+		if (s->key == key) {
+			if (pgoff >= s->start && pgoff < s->start + s->size + s->window) {
+				near = s;
+				hit = true;
+				break;
+			}
+
+			if (!near && pgoff + RA_STREAM_NEAR > s->start
+					&& pgoff < s->start + s->size + RA_STREAM_NEAR)
+				near = s;
+		}
+
+		/* replace an empty slot first, then the least recently used one */
+		if (!victim || (victim->key && (!s->key || time_before(s->last_used, victim->last_used))))
+			victim = s;
+	}
+
+	if (hit) {
+		s = near;
+		s->hits++;
+		s->window = min(s->window * 2, ra_window_cap());
+		atomic_long_inc(&ra_total_hits);
+	} else if (near) {
+		s = near;
+		s->misses++;
+		s->waste += s->size;
+		s->window = max_t(unsigned int, s->window / 2, min_ra_pages);
+		atomic_long_inc(&ra_total_misses);
+		atomic_long_add(s->size, &ra_total_waste);
+	} else {
+		s = victim;
+		memset(s, 0, sizeof(*s));
+		s->key = key;
+		if (mapping->host) {
+			s->dev = mapping->host->i_sb->s_dev;
+			s->ino = mapping->host->i_ino;
+		}
+		s->window = max_ra_pages;
+		atomic_long_inc(&ra_total_streams);
+	}
+
+	s->window = max_t(unsigned int, s->window, min_ra_pages);
+	s->start = hit ? pgoff : (pgoff > s->window / 2 ? pgoff - s->window / 2 : 0);
+	s->size = s->window;
+	s->last_used = jiffies;
+	*window = s->window;
+	spin_unlock(&bucket->lock);
+
+	return hit;
+}
+
+static int ra_stats_show(struct seq_file *m, void *v)
+{
+	int b, i;
+
+	seq_printf(m, "streams=%ld hits=%ld misses=%ld waste_pages=%ld cap=%u\n",
+			atomic_long_read(&ra_total_streams),
+			atomic_long_read(&ra_total_hits),
+			atomic_long_read(&ra_total_misses),
+			atomic_long_read(&ra_total_waste),
+			ra_window_cap());
+
+	for (b = 0; b < ARRAY_SIZE(ra_buckets); b++) {
+		struct ra_stream_bucket *bucket = &ra_buckets[b];
+
+		spin_lock(&bucket->lock);
+		for (i = 0; i < RA_STREAM_WAYS; i++) {
+			struct ra_stream *s = &bucket->streams[i];
+
+			if (!s->key)
+				continue;
+			seq_printf(m, "dev=%u:%u ino=%lu start=%lu window=%u hits=%lu misses=%lu waste=%lu\n",
+					MAJOR(s->dev), MINOR(s->dev), s->ino,
+					s->start, s->window, s->hits, s->misses, s->waste);
+		}
+		spin_unlock(&bucket->lock);
+	}
+
+	return 0;
+}
+
+/*
+ * Launch prefetch.
+ *
+ * Userspace writes the uid of an app being cold launched to
+ * /proc/moto_mmap_fault/launch. Without a profile for that uid, the page
+ * cache misses of the app's mapped files during the next launch_record_ms
+ * are recorded as (file, page range) pairs. With a profile, those ranges
+ * are prefetched with async readahead right away, and the misses the app
+ * still takes are counted to estimate how much of the original misses the
+ * profile saved. A profile saving less than launch_stale_pct is dropped and
+ * recorded again on the next launch.
+ *
+ * Android apps get one memcg per uid, so the uid selects the memcg as well.
+ *
+ * Profiles don't pin the files: a file is kept as its device, inode and
+ * path, and replay opens the path again. A path that now leads to another
+ * inode, as after an app update, is not prefetched.
+ */
+static int launch_record_ms = 3000;
+module_param(launch_record_ms, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(launch_record_ms, "Time window recorded/replayed after an app launch");
+
+static int launch_max_ranges = 512;
+module_param(launch_max_ranges, int, S_IRUGO);
+MODULE_PARM_DESC(launch_max_ranges, "Max page ranges kept per launch profile");
+
+static int launch_stale_pct = 50;
+module_param(launch_stale_pct, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(launch_stale_pct, "Drop a launch profile saving less than this % of the misses");
+
+#define LP_MAX_PROFILES		16
+#define LP_MAX_FILES		64
+#define LP_NEG_BITS			6
+
+struct lp_range {
+	u16				file;
+	u32				start;
+	u32				nr;
+};
+
+struct lp_file {
+	dev_t			dev;
+	unsigned long	ino;
+	char			*path;
+};
+
+struct launch_profile {
+	struct list_head	list;
+	uid_t			uid;
+	int				nr_files;
+	int				nr_ranges;
+	struct lp_file	files[LP_MAX_FILES];
+	struct lp_range	*ranges;
+	/* pages missed while recording, and while replaying the last launch */
+	unsigned long	recorded_pages;
+	unsigned long	missed_pages;
+	unsigned long	launches;
+	int				hit_pct;
+};
+
+/* lp_mutex protects the profile list and profile lifetime */
+static DEFINE_MUTEX(lp_mutex);
+static LIST_HEAD(lp_profiles);
+static int lp_nr_profiles;
+
+/* lp_lock protects the launch being recorded or replayed */
+static DEFINE_SPINLOCK(lp_lock);
+static struct launch_profile *lp_active;
+static bool lp_recording;
+static unsigned long lp_deadline;
+/* bumped whenever lp_active changes, to revalidate after dropping lp_lock */
+static unsigned long lp_gen;
+/*
+ * Mappings of the launch known not to be mapped by the app, so page cache
+ * inserts of unrelated files don't walk the vmas again. Direct mapped,
+ * cleared on every launch.
+ */
+static struct address_space *lp_neg[1 << LP_NEG_BITS];
+
+static struct tracepoint *lp_tp;
+
+static void lp_replay_func(struct work_struct *work);
+static void lp_finish_func(struct work_struct *work);
+static DECLARE_WORK(lp_replay_work, lp_replay_func);
+static DECLARE_DELAYED_WORK(lp_finish_work, lp_finish_func);
+
+static void lp_free(struct launch_profile *p)
+{
+	int i;
+
+	for (i = 0; i < p->nr_files; i++)
+		kfree(p->files[i].path);
+	kvfree(p->ranges);
+	kfree(p);
+}
+
+/* caller holds lp_mutex */
+static void lp_drop(struct launch_profile *p)
+{
+	spin_lock(&lp_lock);
+	if (lp_active == p) {
+		lp_active = NULL;
+		lp_gen++;
+	}
+	spin_unlock(&lp_lock);
+
+	list_del(&p->list);
+	lp_nr_profiles--;
+	lp_free(p);
+}
+
+/*
+ * Return a reference to a file of @mapping the current task has mapped,
+ * NULL if it has none, or ERR_PTR(-EAGAIN) if the vmas couldn't be walked.
+ */
+static struct file *lp_find_mapped_file(struct address_space *mapping)
+{
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+	struct file *file = NULL;
+
+	if (!mm)
+		return NULL;
+
+	/* may already be held for read by the fault, never wait for it */
+	if (!mmap_read_trylock(mm))
+		return ERR_PTR(-EAGAIN);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+	{
+		VMA_ITERATOR(vmi, mm, 0);
+
+		for_each_vma(vmi, vma) {
+			if (vma->vm_file && vma->vm_file->f_mapping == mapping) {
+				file = get_file(vma->vm_file);
+				break;
+			}
+		}
+	}
+#else
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_file && vma->vm_file->f_mapping == mapping) {
+			file = get_file(vma->vm_file);
+			break;
+		}
+	}
+#endif
+	mmap_read_unlock(mm);
+
+	return file;
+}
+
+/*
+ * Path of @file for replay. This runs from page cache insertion, so it
+ * must not enter reclaim.
+ */
+static char *lp_file_path(struct file *file)
+{
+	char *buf, *path;
+
+	buf = kmalloc(PATH_MAX, GFP_NOWAIT | __GFP_NOWARN);
+	if (!buf)
+		return NULL;
+
+	path = d_path(&file->f_path, buf, PATH_MAX);
+	path = IS_ERR(path) ? NULL : kstrdup(path, GFP_NOWAIT | __GFP_NOWARN);
+	kfree(buf);
+
+	return path;
+}
+
+static inline bool lp_file_match(struct lp_file *f, struct inode *inode)
+{
+	return f->ino == inode->i_ino && f->dev == inode->i_sb->s_dev;
+}
+
+static int lp_file_index(struct launch_profile *p, struct inode *inode)
+{
+	int i;
+
+	for (i = 0; i < p->nr_files; i++) {
+		if (lp_file_match(&p->files[i], inode))
+			return i;
+	}
+
+	return -1;
+}
+
+static inline struct address_space **lp_neg_slot(struct address_space *mapping)
+{
+	return &lp_neg[hash_ptr(mapping, LP_NEG_BITS)];
+}
+
+/* caller holds lp_lock */
+static void lp_record(struct launch_profile *p, int idx, pgoff_t index, unsigned long nr)
+{
+	struct lp_range *last;
+
+	p->recorded_pages += nr;
+
+	last = p->nr_ranges ? &p->ranges[p->nr_ranges - 1] : NULL;
+	if (last && last->file == idx && index >= last->start && index <= last->start + last->nr) {
+		last->nr = max_t(u32, last->nr, index + nr - last->start);
+		return;
+	}
+
+	if (p->nr_ranges >= launch_max_ranges)
+		return;
+
+	p->ranges[p->nr_ranges].file = idx;
+	p->ranges[p->nr_ranges].start = index;
+	p->ranges[p->nr_ranges].nr = nr;
+	p->nr_ranges++;
+}
+
+/* caller holds lp_lock, @p is lp_active */
+static void lp_account(struct launch_profile *p, int idx, pgoff_t index, unsigned long nr)
+{
+	if (lp_recording)
+		lp_record(p, idx, index, nr);
+	else
+		p->missed_pages += nr;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0)
+static void lp_add_to_page_cache(void *data, struct folio *folio)
+{
+	struct address_space *mapping = folio->mapping;
+	pgoff_t index = folio->index;
+	unsigned long nr = folio_nr_pages(folio);
+#else
+static void lp_add_to_page_cache(void *data, struct page *page)
+{
+	struct address_space *mapping = page->mapping;
+	pgoff_t index = page->index;
+	unsigned long nr = thp_nr_pages(page);
+#endif
+	struct inode *inode = mapping->host;
+	struct launch_profile *p;
+	struct file *file = NULL;
+	char *path = NULL;
+	unsigned long gen;
+	int idx;
+
+	if (likely(!READ_ONCE(lp_active)) || !inode)
+		return;
+
+	spin_lock(&lp_lock);
+	p = lp_active;
+	if (!p || from_kuid(&init_user_ns, current_uid()) != p->uid)
+		goto unlock;
+
+	if (time_after(jiffies, lp_deadline))
+		goto unlock;
+
+	idx = lp_file_index(p, inode);
+	if (idx >= 0) {
+		lp_account(p, idx, index, nr);
+		goto unlock;
+	}
+
+	/* a new file is only recorded, or counted, if the app has it mapped */
+	if (*lp_neg_slot(mapping) == mapping ||
+			(lp_recording && p->nr_files >= LP_MAX_FILES))
+		goto unlock;
+	gen = lp_gen;
+	spin_unlock(&lp_lock);
+
+	/* the vma walk is slow, keep it out of lp_lock */
+	file = lp_find_mapped_file(mapping);
+
+	if (IS_ERR(file))
+		return;
+
+	if (file && READ_ONCE(lp_recording)) {
+		path = lp_file_path(file);
+		if (!path)
+			goto out;
+	}
+
+	spin_lock(&lp_lock);
+	if (lp_gen != gen)
+		goto unlock;
+
+	if (!file) {
+		*lp_neg_slot(mapping) = mapping;
+		goto unlock;
+	}
+
+	/* someone may have added it while lp_lock was dropped */
+	idx = lp_file_index(p, inode);
+	if (idx < 0 && lp_recording) {
+		if (p->nr_files >= LP_MAX_FILES || !path)
+			goto unlock;
+		idx = p->nr_files++;
+		p->files[idx].dev = inode->i_sb->s_dev;
+		p->files[idx].ino = inode->i_ino;
+		p->files[idx].path = path;
+		path = NULL;
+	}
+	lp_account(p, idx, index, nr);
+unlock:
+	spin_unlock(&lp_lock);
+out:
+	kfree(path);
+	if (file)
+		fput(file);
+}
+
+static void lp_replay_func(struct work_struct *work)
+{
+	struct launch_profile *p;
+	struct lp_file *files = NULL;
+	struct lp_range *ranges = NULL;
+	int nr_files = 0, nr_ranges = 0;
+	int i, j;
+
+	/* copy the profile, the files are opened and read without lp_mutex */
+	mutex_lock(&lp_mutex);
+	p = READ_ONCE(lp_active);
+	if (!p || lp_recording || !p->nr_ranges)
+		goto unlock;
+
+	files = kcalloc(p->nr_files, sizeof(*files), GFP_KERNEL);
+	ranges = kvmalloc_array(p->nr_ranges, sizeof(*ranges), GFP_KERNEL);
+	if (!files || !ranges)
+		goto unlock;
+
+	for (i = 0; i < p->nr_files; i++) {
+		files[i] = p->files[i];
+		files[i].path = kstrdup(p->files[i].path, GFP_KERNEL);
+	}
+	memcpy(ranges, p->ranges, p->nr_ranges * sizeof(*ranges));
+	nr_files = p->nr_files;
+	nr_ranges = p->nr_ranges;
+unlock:
+	mutex_unlock(&lp_mutex);
+
+	for (i = 0; i < nr_files; i++) {
+		struct file *file;
+
+		if (!files[i].path)
+			continue;
+
+		file = filp_open(files[i].path, O_RDONLY | O_LARGEFILE, 0);
+		if (IS_ERR(file))
+			continue;
+
+		if (lp_file_match(&files[i], file_inode(file))) {
+			for (j = 0; j < nr_ranges; j++) {
+				if (ranges[j].file != i)
+					continue;
+				vfs_fadvise(file, (loff_t)ranges[j].start << PAGE_SHIFT,
+						(loff_t)ranges[j].nr << PAGE_SHIFT, POSIX_FADV_WILLNEED);
+			}
+		}
+		fput(file);
+	}
+
+	for (i = 0; i < nr_files; i++)
+		kfree(files[i].path);
+	kfree(files);
+	kvfree(ranges);
+}
+
+/* caller holds lp_mutex */
+static void lp_finish(void)
+{
+	struct launch_profile *p;
+	bool recording;
+
+	spin_lock(&lp_lock);
+	p = lp_active;
+	recording = lp_recording;
+	lp_active = NULL;
+	lp_gen++;
+	spin_unlock(&lp_lock);
+
+	if (!p)
+		return;
+
+	if (recording) {
+		if (!p->nr_ranges)
+			lp_drop(p);
+		return;
+	}
+
+	p->hit_pct = p->recorded_pages > p->missed_pages ?
+			(p->recorded_pages - p->missed_pages) * 100 / p->recorded_pages : 0;
+	if (p->hit_pct < launch_stale_pct) {
+		pr_info("launch profile of uid %u is stale, hit %d%%\n", p->uid, p->hit_pct);
+		lp_drop(p);
+	}
+}
+
+static void lp_finish_func(struct work_struct *work)
+{
+	mutex_lock(&lp_mutex);
+	lp_finish();
+	mutex_unlock(&lp_mutex);
+}
+
+static int lp_launch(uid_t uid)
+{
+	struct launch_profile *p, *found = NULL;
+
+	if (!lp_tp)
+		return -ENODEV;
+
+	cancel_delayed_work_sync(&lp_finish_work);
+
+	mutex_lock(&lp_mutex);
+	lp_finish();
+
+	list_for_each_entry(p, &lp_profiles, list) {
+		if (p->uid == uid) {
+			found = p;
+			break;
+		}
+	}
+
+	if (!found) {
+		if (lp_nr_profiles >= LP_MAX_PROFILES)
+			lp_drop(list_last_entry(&lp_profiles, struct launch_profile, list));
+
+		found = kzalloc(sizeof(*found), GFP_KERNEL);
+		if (found)
+			found->ranges = kvcalloc(launch_max_ranges, sizeof(*found->ranges), GFP_KERNEL);
+		if (!found || !found->ranges) {
+			kfree(found);
+			mutex_unlock(&lp_mutex);
+			return -ENOMEM;
+		}
+		found->uid = uid;
+		list_add(&found->list, &lp_profiles);
+		lp_nr_profiles++;
+	} else {
+		list_move(&found->list, &lp_profiles);
+		found->launches++;
+		found->missed_pages = 0;
+	}
+
+	spin_lock(&lp_lock);
+	lp_recording = !found->nr_ranges;
+	lp_deadline = jiffies + msecs_to_jiffies(launch_record_ms);
+	memset(lp_neg, 0, sizeof(lp_neg));
+	lp_gen++;
+	WRITE_ONCE(lp_active, found);
+	spin_unlock(&lp_lock);
+
+	if (!lp_recording)
+		queue_work(system_unbound_wq, &lp_replay_work);
+	mutex_unlock(&lp_mutex);
+
+	schedule_delayed_work(&lp_finish_work, msecs_to_jiffies(launch_record_ms));
+	return 0;
+}
+
+static ssize_t lp_launch_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	char buffer[16];
+	unsigned int uid;
+	int err;
+
+	memset(buffer, 0, sizeof(buffer));
+
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	err = kstrtouint(strstrip(buffer), 10, &uid);
+	if (err)
+		return err;
+
+	err = lp_launch(uid);
+	if (err)
+		return err;
+
+	return count;
+}
+
+static const struct proc_ops lp_launch_fops = {
+	.proc_write		= lp_launch_write,
+};
+
+static int lp_profiles_show(struct seq_file *m, void *v)
+{
+	struct launch_profile *p;
+	unsigned long pages;
+	int i;
+
+	mutex_lock(&lp_mutex);
+	list_for_each_entry(p, &lp_profiles, list) {
+		for (i = 0, pages = 0; i < p->nr_ranges; i++)
+			pages += p->ranges[i].nr;
+
+		seq_printf(m, "uid=%u files=%d ranges=%d pages=%lu recorded=%lu launches=%lu missed=%lu hit=%d%%\n",
+				p->uid, p->nr_files, p->nr_ranges, pages, p->recorded_pages,
+				p->launches, p->missed_pages, p->hit_pct);
+	}
+	mutex_unlock(&lp_mutex);
+
+	return 0;
+}
+
+static void lp_find_tracepoint(struct tracepoint *tp, void *priv)
+{
+	if (!strcmp(tp->name, "mm_filemap_add_to_page_cache"))
+		lp_tp = tp;
+}
+
+static void lp_init(void)
+{
+	/* the tracepoint isn't exported to modules, look it up by name */
+	for_each_kernel_tracepoint(lp_find_tracepoint, NULL);
+	if (!lp_tp || tracepoint_probe_register(lp_tp, lp_add_to_page_cache, NULL)) {
+		pr_warn("mm_filemap_add_to_page_cache not available, launch prefetch disabled\n");
+		lp_tp = NULL;
+	}
+}
+
+static void lp_exit(void)
+{
+	struct launch_profile *p, *n;
+
+	if (lp_tp) {
+		tracepoint_probe_unregister(lp_tp, lp_add_to_page_cache, NULL);
+		tracepoint_synchronize_unregister();
+	}
+
+	cancel_delayed_work_sync(&lp_finish_work);
+	cancel_work_sync(&lp_replay_work);
+
+	mutex_lock(&lp_mutex);
+	list_for_each_entry_safe(p, n, &lp_profiles, list)
+		lp_drop(p);
+	mutex_unlock(&lp_mutex);
+}
+
 #if LINUX_VERSION_CODE > KERNEL_VERSION(5, 15, 104) || (LINUX_VERSION_CODE > KERNEL_VERSION(5, 10, 177) && LINUX_VERSION_CODE < KERNEL_VERSION(5, 15, 0))
 #ifndef TUNE_MMAP_READAROUND
 #define TUNE_MMAP_READAROUND
@@ -30,9 +763,19 @@ MODULE_PARM_DESC(max_ra_pages, "Max read ahead pages");
 static void __nocfi tune_mmap_readaround(void *p, unsigned int ra_pages, pgoff_t pgoff,
 		pgoff_t *start, unsigned int *size, unsigned int *async_size)
 {
-	*start = max_t(long, 0, pgoff - max_ra_pages / 2);
-	*size = max_ra_pages;
-	*async_size = max_ra_pages / 4;
+	/*
+	 * The hook doesn't pass the file, but do_sync_mmap_readahead() hands
+	 * in &file->f_ra.start, which leads back to the faulting file.
+	 */
+	struct file *file = container_of(start, struct file, f_ra.start);
+	unsigned int window;
+	bool seq;
+
+	seq = ra_stream_update(file->f_mapping, pgoff, &window);
+
+	*start = seq ? pgoff : max_t(long, 0, pgoff - window / 2);
+	*size = window;
+	*async_size = window / 4;
 	return;
 }
 #else
@@ -66,11 +809,14 @@ static void __nocfi filemap_fault_get_page(void *p, struct vm_fault *vmf, struct
 			mmap_miss > 100) {
 			return;
 		} else {
+			unsigned int window;
+
+			ra_stream_update(mapping, offset, &window);
 			old_ra_pages = ra->ra_pages;
-			if (ra->ra_pages > max_ra_pages) {
-				ra->ra_pages = max_ra_pages; // reduce the read ahead limit to 8 pages
+			if (ra->ra_pages > window) {
+				ra->ra_pages = window; // reduce the read ahead limit to the stream window
 				vmf->android_oem_data1[0] = old_ra_pages;
-				vmf->android_oem_data1[1] = max_ra_pages;
+				vmf->android_oem_data1[1] = window;
 			}
 			return;
 		}
@@ -93,8 +839,8 @@ static void __nocfi filemap_fault_cache_page(void *p, struct vm_fault *vmf, stru
 	if(!ra)
 		return;
 
-	if ((ra->ra_pages == max_ra_pages) && (vmf->android_oem_data1[0] != 0)
-			&& (vmf->android_oem_data1[1] == max_ra_pages)) {
+	if ((vmf->android_oem_data1[0] != 0)
+			&& (ra->ra_pages == vmf->android_oem_data1[1])) {
 			ra->ra_pages = (unsigned int)vmf->android_oem_data1[0]; //restore the old ra_pages
 			vmf->android_oem_data1[0] = 0;
 			vmf->android_oem_data1[1] = 0;
@@ -106,6 +852,8 @@ static int __nocfi __init moto_mmap_fault_init(void)
 {
 	int ret = 0;
 	int ramsize_GB = (totalram_pages() >> (30 - PAGE_SHIFT)) + 1;
+	struct proc_dir_entry *proc_dir;
+	int i;
 
 	if (max_ra_pages == -1) {
 		/* Set 8 pages for < 8G RAM and set 16 pages for >= 8G RAM */
@@ -115,6 +863,19 @@ static int __nocfi __init moto_mmap_fault_init(void)
 			max_ra_pages = 16;
 	}
 
+	for (i = 0; i < ARRAY_SIZE(ra_buckets); i++)
+		spin_lock_init(&ra_buckets[i].lock);
+	ra_mem_sample(NULL);
+
+	proc_dir = proc_mkdir("moto_mmap_fault", NULL);
+	if (!proc_dir
+			|| !proc_create_single("ra_stats", 0444, proc_dir, ra_stats_show)
+			|| !proc_create("launch", 0220, proc_dir, &lp_launch_fops)
+			|| !proc_create_single("launch_profiles", 0444, proc_dir, lp_profiles_show))
+		pr_warn("failed to create proc nodes moto_mmap_fault\n");
+
+	lp_init();
+
 #if defined(TUNE_MMAP_READAROUND)
 	pr_info("Using the new mmap fault driver, totalram size=%dGB", ramsize_GB);
 	ret = register_trace_android_vh_tune_mmap_readaround(tune_mmap_readaround, NULL);
@@ -123,13 +884,19 @@ static int __nocfi __init moto_mmap_fault_init(void)
 	ret = register_trace_android_vh_filemap_fault_get_page(filemap_fault_get_page, NULL) ?:
 		register_trace_android_vh_filemap_fault_cache_page(filemap_fault_cache_page, NULL);
 #endif
-	if (ret != 0)
+	if (ret != 0) {
+		cancel_delayed_work_sync(&ra_mem_work);
+		lp_exit();
+		remove_proc_subtree("moto_mmap_fault", NULL);
 		return -ENXIO;
-	else
+	} else
 		return 0;
 }
 static void __nocfi __exit moto_mmap_fault_exit(void)
 {
+	lp_exit();
+	remove_proc_subtree("moto_mmap_fault", NULL);
+	cancel_delayed_work_sync(&ra_mem_work);
 #if defined(TUNE_MMAP_READAROUND)
 	unregister_trace_android_vh_tune_mmap_readaround(tune_mmap_readaround, NULL);
 #else
@@ -83,7 +83,7 @@ static inline bool curr_is_inherit_futex(void)
 	return task_get_ux_type(current) & UX_TYPE_INHERIT_FUTEX;
 }
 
-static bool boost_holder(struct task_struct *holder, struct task_struct *waiter)
+bool futex_boost_holder(struct task_struct *holder, struct task_struct *waiter)
 {
 	struct moto_task_struct *mts;
 
@@ -97,7 +97,7 @@ static bool boost_holder(struct task_struct *holder, struct task_struct *waiter)
 	 * 1. modify ux thread's pnode-prio in android_vh_alter_futex_plist_add() hook.
 	 * 2. set inherit ux thread with futex type in android_vh_futex_sleep_start() hook.
 	 */
-	if (unlikely(!locking_opt_enable(LK_FUTEX_ENABLE)))
+	if (unlikely(!locking_opt_enable()))
 		return false;
 
 	/*
@@ -151,7 +151,12 @@ static bool set_holder(struct task_struct *waiter, struct task_struct *holder)
 		mts = get_moto_task_struct(waiter);
 		/* If waiter's holder is set, do put_task_struct(holder) in futex_wait_end() */
 		if (likely(!IS_ERR_OR_NULL(mts))) {
+			if (mts->lkinfo.holder)
+				put_task_struct(mts->lkinfo.holder);
 			mts->lkinfo.holder = holder;
+			/* same tid as the futex word, see lock_next_holder() */
+			lock_set_holder(waiter, task_pid_nr_ns(holder, task_active_pid_ns(waiter)),
+					LK_HOLDER_FUTEX);
 			return true;
 		}
 	}
@@ -179,8 +184,8 @@ static void futex_notify_waiter(unsigned long pid)
 	try_to_boost = set_holder(waiter, holder);
 
 	/* TODO: should check waiter's state? it should be sleeping */
-	if (try_to_boost)
-		boost_holder(holder, waiter);
+	if (try_to_boost && futex_boost_holder(holder, waiter))
+		lock_boost_chain(waiter, holder, "futex_notify");
 
 out_put_waiter:
 	put_task_struct(waiter);
@@ -248,14 +253,21 @@ static void android_vh_futex_wait_start_handler(void *unused, unsigned int flags
 		  u32 bitset)
 {
 	struct task_struct *holder;
+	pid_t holder_pid = (flags & ~(0x3 << LOCK_TYPE_SHIFT)) >> FLAGS_OWNER_SHIFT;
 
 	cond_trace_printk(moto_sched_debug,
-			"current_is_important_ux %d, set_holder %d -> %d\n", current_is_important_ux(), current->pid, (flags & ~(0x3 << LOCK_TYPE_SHIFT)) >> FLAGS_OWNER_SHIFT);
+			"current_is_important_ux %d, set_holder %d -> %d\n", current_is_important_ux(), current->pid, holder_pid);
+
+	if (unlikely(!locking_opt_enable()))
+		return;
+
+	/* Every waiter records its holder, so a later ux waiter can boost through us. */
+	lock_set_holder(current, holder_pid, LK_HOLDER_FUTEX);
 
 	if (!current_is_important_ux())
 		return;
 
-	holder = futex_find_task_by_pid((flags & ~(0x3 << LOCK_TYPE_SHIFT)) >> FLAGS_OWNER_SHIFT);
+	holder = futex_find_task_by_pid(holder_pid);
 	if (!holder)
 		return;
 
@@ -271,6 +283,8 @@ static void android_vh_futex_wait_end_handler(void *unused, unsigned int flags,
 	if (IS_ERR_OR_NULL(mts))
 		return;
 
+	lock_clear_holder(current);
+
 	if (mts->lkinfo.holder) {
 		if (unlikely(mts->lkinfo.ux_contrib)) {
 			futex_unset_inherit_ux_refs(mts->lkinfo.holder, 1, 3);
@@ -278,6 +292,7 @@ static void android_vh_futex_wait_end_handler(void *unused, unsigned int flags,
 
 		put_task_struct(mts->lkinfo.holder);
 		mts->lkinfo.holder = NULL;
+		mts->lkinfo.ux_contrib = false;
 	}
 }
 
@@ -293,15 +308,15 @@ void android_vh_alter_futex_plist_add_handler(void *unused, struct plist_node *n
 	int prio;
 	struct moto_task_struct *mts;
 
-	if (unlikely(!locking_opt_enable(LK_FUTEX_ENABLE) || *already_on_hb))
+	if (unlikely(!locking_opt_enable() || *already_on_hb))
 		return;
 
 	if (!current_is_important_ux())
 		return;
 
 	mts = get_moto_task_struct(current);
-	if (mts->lkinfo.holder)
-		boost_holder(mts->lkinfo.holder, current);
+	if (mts->lkinfo.holder && futex_boost_holder(mts->lkinfo.holder, current))
+		lock_boost_chain(current, mts->lkinfo.holder, "futex_wait");
 
 	cur = (struct futex_q *) node;
 	/*
@@ -6,10 +6,217 @@
 #define pr_fmt(fmt) "moto_locking_boost:" fmt
 
 #include <linux/sched.h>
+#include <linux/sched/task.h>
+#include <linux/rcupdate.h>
+#include <linux/pid_namespace.h>
 #include <linux/module.h>
 
 #include "locking_main.h"
 
+atomic64_t lock_chain_len[UX_DEPTH_MAX + 1];
+atomic64_t lock_chain_cycles;
+atomic64_t lock_chain_truncated;
+atomic64_t lock_boost_count;
+atomic64_t lock_boost_time_total;
+atomic64_t lock_boost_time_max;
+
+/*
+ * Every waiter records the pid of the task it is blocked on, and nothing
+ * else: a single store to its own moto_task_struct, no lock and no task
+ * reference. Only a ux waiter that boosts an owner walks the records, and
+ * it resolves each pid under RCU, so a holder that has exited just ends
+ * the chain.
+ *
+ * Mutex and rwsem records hold the global pid. Futex records hold the tid
+ * userspace put in the futex word, which is only meaningful in the pid
+ * namespace of the waiter.
+ */
+void lock_set_holder(struct task_struct *waiter, pid_t holder_pid, int type)
+{
+	struct moto_task_struct *mts = get_moto_task_struct(waiter);
+
+	if (unlikely(!holder_pid || holder_pid == waiter->pid))
+		return;
+
+	WRITE_ONCE(mts->lkinfo.holder_type, type);
+	/* pairs with smp_load_acquire() in lock_next_holder() */
+	smp_store_release(&mts->lkinfo.holder_pid, holder_pid);
+}
+
+void lock_clear_holder(struct task_struct *waiter)
+{
+	struct moto_task_struct *mts = get_moto_task_struct(waiter);
+
+	if (READ_ONCE(mts->lkinfo.holder_pid))
+		WRITE_ONCE(mts->lkinfo.holder_pid, 0);
+}
+
+/*
+ * The record is only a pid, so after the lookup make sure @p is still blocked
+ * on the same holder. A record that was cleared or rewritten meanwhile, or a
+ * pid that now belongs to an unrelated task, ends the chain instead.
+ */
+static bool lock_holder_valid(struct task_struct *p, struct task_struct *next,
+			pid_t pid, int type)
+{
+	struct moto_task_struct *mts = get_moto_task_struct(p);
+
+	if (smp_load_acquire(&mts->lkinfo.holder_pid) != pid ||
+		READ_ONCE(mts->lkinfo.holder_type) != type)
+		return false;
+
+	if (next->flags & PF_EXITING)
+		return false;
+
+	/* futex holders are only followed within the process, as set_holder() does */
+	if (type == LK_HOLDER_FUTEX && next->tgid != p->tgid)
+		return false;
+
+	return true;
+}
+
+/* Return a referenced task @p is blocked on, or NULL. */
+static struct task_struct *lock_next_holder(struct task_struct *p, int *type)
+{
+	struct moto_task_struct *mts = get_moto_task_struct(p);
+	struct pid_namespace *ns = &init_pid_ns;
+	struct task_struct *next = NULL;
+	pid_t pid;
+
+	pid = smp_load_acquire(&mts->lkinfo.holder_pid);
+	if (!pid)
+		return NULL;
+	*type = READ_ONCE(mts->lkinfo.holder_type);
+
+	rcu_read_lock();
+	if (*type == LK_HOLDER_FUTEX)
+		ns = task_active_pid_ns(p);
+	if (ns)
+		next = find_task_by_pid_ns(pid, ns);
+	if (next && lock_holder_valid(p, next, pid, *type))
+		get_task_struct(next);
+	else
+		next = NULL;
+	rcu_read_unlock();
+
+	return next;
+}
+
+static bool lock_boost_hop(struct task_struct *owner, struct task_struct *waiter,
+			int type, char *lock_name)
+{
+#ifdef CONFIG_MOTO_FUTEX_INHERIT
+	/* futex owners are unboosted by the futex wake path, keep its accounting */
+	if (type == LK_HOLDER_FUTEX)
+		return futex_boost_holder(owner, waiter);
+#endif
+	return lock_inherit_ux_type(owner, waiter, lock_name);
+}
+
+/*
+ * @owner has just been boosted on behalf of @waiter. If the owner is itself
+ * blocked on another mutex, rwsem or futex, follow the blocked-on chain and
+ * boost each holder in turn, up to UX_DEPTH_MAX tasks in total. A holder that
+ * is already on the chain means a deadlock cycle, the walk stops there.
+ *
+ * Every hop is unboosted by its own release path, same as a direct boost.
+ *
+ * Return the number of boosted tasks, including @owner.
+ */
+int lock_boost_chain(struct task_struct *waiter, struct task_struct *owner, char *lock_name)
+{
+	struct task_struct *chain[UX_DEPTH_MAX + 2];
+	int types[UX_DEPTH_MAX + 2];
+	struct task_struct *next;
+	bool cycle = false;
+	bool truncated = false;
+	int len = 2;
+	int boosted = 1;
+	int type = LK_HOLDER_NONE;
+	int i;
+
+	if (unlikely(!waiter || !owner))
+		return 0;
+
+	chain[0] = waiter;
+	chain[1] = owner;
+
+	while (!cycle) {
+		next = lock_next_holder(chain[len - 1], &type);
+		if (!next)
+			break;
+
+		if (len > UX_DEPTH_MAX) {
+			put_task_struct(next);
+			truncated = true;
+			break;
+		}
+
+		for (i = 0; i < len; i++) {
+			if (chain[i] == next) {
+				put_task_struct(next);
+				cycle = true;
+				break;
+			}
+		}
+
+		if (!cycle) {
+			types[len] = type;
+			chain[len++] = next;
+		}
+	}
+
+	for (i = 2; i < len; i++) {
+		if (!lock_boost_hop(chain[i], chain[i - 1], types[i], lock_name))
+			break;
+		boosted++;
+	}
+
+	cond_trace_printk(unlikely(is_debuggable(DEBUG_LOCK)),
+			"lock_boost_chain %s %d -> %d boosted=%d len=%d cycle=%d truncated=%d\n",
+			lock_name, waiter->pid, owner->pid, boosted, len - 1, cycle, truncated);
+
+	for (i = 2; i < len; i++)
+		put_task_struct(chain[i]);
+
+	atomic64_inc(&lock_chain_len[min(boosted, UX_DEPTH_MAX)]);
+	if (cycle)
+		atomic64_inc(&lock_chain_cycles);
+	if (truncated)
+		atomic64_inc(&lock_chain_truncated);
+
+	return boosted;
+}
+
+void lock_account_boost_time(u64 delta)
+{
+	s64 max = atomic64_read(&lock_boost_time_max);
+
+	atomic64_inc(&lock_boost_count);
+	atomic64_add(delta, &lock_boost_time_total);
+
+	while ((s64)delta > max) {
+		s64 old = atomic64_cmpxchg(&lock_boost_time_max, max, delta);
+
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
+void lock_stats_reset(void)
+{
+	int i;
+
+	for (i = 0; i <= UX_DEPTH_MAX; i++)
+		atomic64_set(&lock_chain_len[i], 0);
+	atomic64_set(&lock_chain_cycles, 0);
+	atomic64_set(&lock_chain_truncated, 0);
+	atomic64_set(&lock_boost_count, 0);
+	atomic64_set(&lock_boost_time_total, 0);
+	atomic64_set(&lock_boost_time_max, 0);
+}
+
 int locking_opt_init(void)
 {
 	int ret = 0;
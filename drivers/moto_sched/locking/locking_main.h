@@ -40,7 +40,11 @@ struct futex_uinfo {
 #define LK_RWSEM_ENABLE (1 << 1)
 #define LK_FUTEX_ENABLE (1 << 2)
 
-extern int __read_mostly moto_sched_enabled;
+/* Type of the lock recorded in moto_lock_info.holder_type */
+#define LK_HOLDER_NONE  (0)
+#define LK_HOLDER_MUTEX (1)
+#define LK_HOLDER_RWSEM (2)
+#define LK_HOLDER_FUTEX (3)
 
 extern atomic64_t futex_inherit_set_times;
 extern atomic64_t futex_inherit_unset_times;
@@ -48,12 +52,27 @@ extern atomic64_t futex_inherit_useless_times;
 extern atomic64_t futex_low_count;
 extern atomic64_t futex_high_count;
 
+/* inherit chain statistics, index is the number of boosted tasks */
+extern atomic64_t lock_chain_len[UX_DEPTH_MAX + 1];
+extern atomic64_t lock_chain_cycles;
+extern atomic64_t lock_chain_truncated;
+extern atomic64_t lock_boost_count;
+extern atomic64_t lock_boost_time_total;
+extern atomic64_t lock_boost_time_max;
+
 static inline bool locking_opt_enable(void)
 {
 	return is_enabled(UX_ENABLE_LOCK);
 }
 
+void lock_set_holder(struct task_struct *waiter, pid_t holder_pid, int type);
+void lock_clear_holder(struct task_struct *waiter);
+int lock_boost_chain(struct task_struct *waiter, struct task_struct *owner, char *lock_name);
+void lock_account_boost_time(u64 delta);
+void lock_stats_reset(void);
+
 #ifdef CONFIG_MOTO_FUTEX_INHERIT
+bool futex_boost_holder(struct task_struct *holder, struct task_struct *waiter);
 void register_futex_vendor_hooks(void);
 void unregister_futex_vendor_hooks(void);
 #endif
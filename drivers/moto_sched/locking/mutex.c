@@ -90,28 +90,43 @@ static void android_vh_mutex_wait_start_handler(void *unused, struct mutex *lock
 		return;
 	}
 
-	if ((current->prio >= 100) && (!current_is_important_ux())) {
-		return;
-	}
-
+	/* the owner is only RCU protected until we hold a reference */
+	rcu_read_lock();
 	owner_ts = __mutex_owner(lock);
 	if (!owner_ts) {
+		rcu_read_unlock();
 		cond_trace_printk(unlikely(is_debuggable(DEBUG_BASE)),
 				"mutex owner not found!!! =%d\n", current->pid);
 		return;
 	}
 
-	get_task_struct(owner_ts);
+	/* Every waiter records its owner, so a later ux waiter can boost through us. */
+	lock_set_holder(current, task_pid_nr(owner_ts), LK_HOLDER_MUTEX);
+
+	if (((current->prio >= 100) && (!current_is_important_ux())) ||
+		!refcount_inc_not_zero(&owner_ts->usage)) {
+		rcu_read_unlock();
+		return;
+	}
+	rcu_read_unlock();
+
 	boost = lock_inherit_ux_type(owner_ts, current, "mutex_wait");
 
 	if (boost && (__mutex_owner(lock) != owner_ts)) {
 		cond_trace_printk(unlikely(is_debuggable(DEBUG_BASE)),
 			"mutex owner has been changed owner=%p(%p)\n", __mutex_owner(lock), owner_ts);
 		lock_clear_inherited_ux_type(owner_ts, "mutex_wait");
+	} else if (boost) {
+		lock_boost_chain(current, owner_ts, "mutex_wait");
 	}
 	put_task_struct(owner_ts);
 }
 
+static void android_vh_mutex_wait_finish_handler(void *unused, struct mutex *lock)
+{
+	lock_clear_holder(current);
+}
+
 void android_vh_mutex_unlock_slowpath_handler(void *unused, struct mutex *lock)
 {
 	if (unlikely(!locking_opt_enable()))
@@ -124,6 +139,7 @@ void register_mutex_vendor_hooks(void)
 {
 	register_trace_android_vh_alter_mutex_list_add(android_vh_alter_mutex_list_add_handler, NULL);
 	register_trace_android_vh_mutex_wait_start(android_vh_mutex_wait_start_handler, NULL);
+	register_trace_android_vh_mutex_wait_finish(android_vh_mutex_wait_finish_handler, NULL);
 	register_trace_android_vh_mutex_unlock_slowpath(android_vh_mutex_unlock_slowpath_handler, NULL);
 }
 
@@ -131,5 +147,6 @@ void unregister_mutex_vendor_hooks(void)
 {
 	unregister_trace_android_vh_alter_mutex_list_add(android_vh_alter_mutex_list_add_handler, NULL);
 	unregister_trace_android_vh_mutex_wait_start(android_vh_mutex_wait_start_handler, NULL);
+	unregister_trace_android_vh_mutex_wait_finish(android_vh_mutex_wait_finish_handler, NULL);
 	unregister_trace_android_vh_mutex_unlock_slowpath(android_vh_mutex_unlock_slowpath_handler, NULL);
 }
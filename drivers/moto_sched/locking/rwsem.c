@@ -196,6 +196,15 @@ static void android_vh_rwsem_wake_handler(void *unused, struct rw_semaphore *sem
 		return;
 	}
 
+	/* Every writer-owned waiter records its owner, so the chain can be followed. */
+	if (!is_rwsem_reader_owned(sem)) {
+		rcu_read_lock();
+		owner_ts = rwsem_owner(sem);
+		if (owner_ts)
+			lock_set_holder(current, task_pid_nr(owner_ts), LK_HOLDER_RWSEM);
+		rcu_read_unlock();
+	}
+
 	if (!current_is_important_ux() && (current->prio > 100)) {
 		return;
 	}
@@ -207,7 +216,12 @@ static void android_vh_rwsem_wake_handler(void *unused, struct rw_semaphore *sem
 		return;
 	}
 
+	/* the owner is only RCU protected until we hold a reference */
+	rcu_read_lock();
 	owner_ts = rwsem_owner(sem);
+	if (owner_ts && !refcount_inc_not_zero(&owner_ts->usage))
+		owner_ts = NULL;
+	rcu_read_unlock();
 	if (!owner_ts) {
 		cond_trace_printk(unlikely(is_debuggable(DEBUG_BASE)),
 			"rwsem can't find owner=%lx count=%lx\n", atomic_long_read(&sem->owner),
@@ -215,7 +229,6 @@ static void android_vh_rwsem_wake_handler(void *unused, struct rw_semaphore *sem
 		return;
 	}
 
-	get_task_struct(owner_ts);
 	boost = lock_inherit_ux_type(owner_ts, current, "rwsem_wake");
 
 	if (boost && (atomic_long_read(&sem->owner) != owner || is_rwsem_reader_owned(sem))) {
@@ -223,10 +236,17 @@ static void android_vh_rwsem_wake_handler(void *unused, struct rw_semaphore *sem
 			"rwsem owner status has been changed owner=%lx(%lx)\n",
 			atomic_long_read(&sem->owner), owner);
 		lock_clear_inherited_ux_type(owner_ts, "rwsem_wake_finish");
+	} else if (boost) {
+		lock_boost_chain(current, owner_ts, "rwsem_wake");
 	}
 	put_task_struct(owner_ts);
 }
 
+static void android_vh_rwsem_wait_finish_handler(void *unused, struct rw_semaphore *sem)
+{
+	lock_clear_holder(current);
+}
+
 static void android_vh_rwsem_wake_finish_handler(void *unused, struct rw_semaphore *sem)
 {
 	if (unlikely(!locking_opt_enable())) {
@@ -257,6 +277,8 @@ void register_rwsem_vendor_hooks(void)
 #ifdef ENABLE_INHERITE
 	register_trace_android_vh_rwsem_wake(android_vh_rwsem_wake_handler, NULL);
 	register_trace_android_vh_rwsem_wake_finish(android_vh_rwsem_wake_finish_handler, NULL);
+	register_trace_android_vh_rwsem_read_wait_finish(android_vh_rwsem_wait_finish_handler, NULL);
+	register_trace_android_vh_rwsem_write_wait_finish(android_vh_rwsem_wait_finish_handler, NULL);
 #endif
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
@@ -272,6 +294,8 @@ void unregister_rwsem_vendor_hooks(void)
 #ifdef ENABLE_INHERITE
 	unregister_trace_android_vh_rwsem_wake(android_vh_rwsem_wake_handler, NULL);
 	unregister_trace_android_vh_rwsem_wake_finish(android_vh_rwsem_wake_finish_handler, NULL);
+	unregister_trace_android_vh_rwsem_read_wait_finish(android_vh_rwsem_wait_finish_handler, NULL);
+	unregister_trace_android_vh_rwsem_write_wait_finish(android_vh_rwsem_wait_finish_handler, NULL);
 #endif
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
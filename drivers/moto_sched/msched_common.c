@@ -75,7 +75,7 @@ static inline bool task_in_ux_related_group(struct task_struct *p)
 	}
 
 	// Base feature: always boost top app's high prio threads.
-	if(p->prio <= moto_boost_prio && task_in_top_app_group(p))
+	if(p->prio <= msched_get(boost_prio) && task_in_top_app_group(p))
 		return true;
 
 	return false;
@@ -106,14 +106,14 @@ int task_get_mvp_prio(struct task_struct *p, bool with_inherit)
 		prio = UX_PRIO_CAMERA;
 	else if (is_enabled(UX_ENABLE_KSWAPD) && (ux_type & UX_TYPE_KSWAPD))
 		prio = UX_PRIO_KSWAPD;
-	else if (with_inherit && (ux_type & (UX_TYPE_INHERIT_BINDER|UX_TYPE_INHERIT_LOCK)))
+	else if (with_inherit && (ux_type & (UX_TYPE_INHERIT_BINDER|UX_TYPE_INHERIT_LOCK|UX_TYPE_INHERIT_FUTEX)))
 		prio = UX_PRIO_OTHER;
 	else if (task_in_ux_related_group(p))
 		prio = UX_PRIO_OTHER;
 
 	cond_trace_printk(unlikely(is_debuggable(DEBUG_BASE)),
 		"pid=%d tgid=%d prio=%d scene=%d ux_type=%d mvp_prio=%d\n",
-		p->pid, p->tgid, p->prio, moto_sched_scene, ux_type, prio);
+		p->pid, p->tgid, p->prio, msched_get(scene), ux_type, prio);
 
 	return prio;
 }
@@ -172,6 +172,8 @@ void binder_clear_inherited_ux_type(struct task_struct *task) {
 EXPORT_SYMBOL(binder_clear_inherited_ux_type);
 
 void queue_ux_task(struct rq *rq, struct task_struct *task, int enqueue) {
+	ux_occupancy_update(rq, task, enqueue);
+
 	if (is_enabled(UX_ENABLE_LOCK) && !enqueue){
 		struct moto_task_struct *wts = get_moto_task_struct(task);
 		if (task_has_ux_type(task, UX_TYPE_INHERIT_LOCK)) {
@@ -179,6 +181,7 @@ void queue_ux_task(struct rq *rq, struct task_struct *task, int enqueue) {
 				cond_trace_printk(unlikely(is_debuggable(DEBUG_BASE)),
 						"lock_clear_inherited_ux_type %s  %d  ux_type %d  cost=%llu\n", "dequeue task",
 						task->pid, wts->ux_type, (jiffies_to_nsecs(jiffies) - wts->inherit_start) / 1000000U);
+				lock_account_boost_time(jiffies_to_nsecs(jiffies) - wts->inherit_start);
 				task_clr_inherit_type(task);
 			}
 		}
@@ -264,6 +267,7 @@ bool lock_clear_inherited_ux_type(struct task_struct *owner, char* lock_name) {
 			"lock_clear_inherited_ux_type %s  %d  ux_type %d cost=%llu\n", lock_name,
 			owner->pid, owner_wts->ux_type,
 			(jiffies_to_nsecs(jiffies) - owner_wts->inherit_start) / 1000000U);
+	lock_account_boost_time(jiffies_to_nsecs(jiffies) - owner_wts->inherit_start);
 	task_clr_inherit_type(owner);
 
 	task_rq_unlock(rq, owner, &flags);
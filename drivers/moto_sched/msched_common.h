@@ -21,6 +21,7 @@
 #include <linux/atomic.h>
 #include <linux/cgroup.h>
 #include <linux/hashtable.h>
+#include <linux/rcupdate.h>
 #if IS_ENABLED(CONFIG_SCHED_WALT)
 #include <linux/sched/walt.h>
 #endif
@@ -31,7 +32,7 @@
 #include <drivers/misc/mediatek/sched/common.h>
 #endif
 
-#define VERION 1009
+#define VERION 1012
 
 #define cond_trace_printk(cond, fmt, ...)	\
 do {										\
@@ -83,6 +84,7 @@ do {										\
 #define UX_TYPE_INHERIT_LOCK		(1 << 19)
 #define UX_TYPE_CAMERAAPP			(1 << 20)
 #define UX_TYPE_KERNEL				(1 << 21)
+#define UX_TYPE_INHERIT_FUTEX		(1 << 22)
 
 /* define for UX scene type, keep same as the define in java file */
 #define UX_SCENE_LAUNCH				(1 << 0)
@@ -108,6 +110,20 @@ do {										\
 
 #define UX_DEPTH_MAX		5
 
+/* ux wakeup placement decisions */
+enum {
+	UX_PLACE_PREV_IDLE = 0,
+	UX_PLACE_IDLE,
+	UX_PLACE_LOW_UX,
+	UX_PLACE_KEEP,
+	UX_PLACE_UPMIGRATE,
+
+	UX_PLACE_NR,
+};
+
+/* ux wake-to-run latency log2 buckets, from <128us to >=16ms */
+#define UX_LAT_NR			9
+
 enum {
 	CGROUP_RESV = 0,
 	CGROUP_DEFAULT = 1,         /* sys */
@@ -118,6 +134,14 @@ enum {
 	CGROUP_NRS,
 };
 
+/* Lock the task is currently blocked on, used to walk inherit chains */
+struct moto_lock_info {
+	struct task_struct	*holder;	/* futex holder of a ux waiter, referenced */
+	pid_t			holder_pid;	/* holder of any waiter, 0 if not blocked */
+	u8				holder_type;
+	bool			ux_contrib;
+};
+
 /* Moto task struct */
 struct moto_task_struct {
 	int				ux_type;
@@ -126,14 +150,56 @@ struct moto_task_struct {
 	u64				inherit_start;
 
 	u64				boost_kernel_start;
-	int				boost_kernel_lock_depth;
+	/* s16 keeps ux_queued in its padding, the struct must fit android_oem_data1 */
+	s16				boost_kernel_lock_depth;
+	bool			ux_queued;	/* counted in ux_nr_running */
+
+	u32				ux_wake_ts;	/* wakeup time in us, 0 if none */
+
+	struct moto_lock_info	lkinfo;
 };
 
+/*
+ * Scene dependent tunables. The active set is only ever replaced as a whole,
+ * see msched_profile.c.
+ */
+struct msched_tunables {
+	int				enabled;
+	int				scene;
+	int				boost_prio;
+	int				ux_placement;
+	struct rcu_head	rcu;
+};
+
+enum {
+	MSCHED_TUN_ENABLED = 0,
+	MSCHED_TUN_SCENE,
+	MSCHED_TUN_BOOST_PRIO,
+	MSCHED_TUN_UX_PLACEMENT,
+};
+
+#define MSCHED_PROFILE_NAME_LEN		16
+#define MSCHED_PROFILE_MAX			16
+
+extern struct msched_tunables __rcu *msched_tunables;
+
+/* read one tunable of the active set */
+#define msched_get(field)								\
+({														\
+	int __val;											\
+	rcu_read_lock();									\
+	__val = rcu_dereference(msched_tunables)->field;	\
+	rcu_read_unlock();									\
+	__val;												\
+})
+
+extern int msched_tunable_set(int id, int val);
+extern int msched_profile_load(char *buf);
+extern int msched_profile_activate(const char *name);
+extern size_t msched_profile_show(char *buf, size_t size, bool table);
+
 /* global vars and functions */
-extern int __read_mostly moto_sched_enabled;
 extern int __read_mostly moto_sched_debug;
-extern int __read_mostly moto_sched_scene;
-extern int __read_mostly moto_boost_prio;
 extern pid_t __read_mostly global_systemserver_tgid;
 extern pid_t __read_mostly global_launcher_tgid;
 extern pid_t __read_mostly global_sysui_tgid;
@@ -153,21 +219,40 @@ extern bool lock_clear_inherited_ux_type(struct task_struct *waiter, char* lock_
 extern void lock_protect_update_starttime(struct task_struct *tsk, unsigned long settime_jiffies, char* lock_name, void* pointer);
 extern void register_vendor_comm_hooks(void);
 
+extern atomic64_t ux_place_stats[UX_PLACE_NR];
+extern atomic64_t ux_lat_hist[UX_LAT_NR];
+extern atomic64_t ux_lat_total;
+extern atomic64_t ux_lat_max;
+extern int msched_select_ux_cpu(struct task_struct *p, int prev_cpu, int sched_cpu);
+extern void ux_occupancy_update(struct rq *rq, struct task_struct *p, int enqueue);
+extern void ux_placement_stats_reset(void);
+extern void ux_placement_apply(int on);
+extern void register_placement_hooks(void);
+
 static inline bool is_debuggable(int type) {
 	return (moto_sched_debug & type) != 0;
 }
 
 static inline bool is_enabled(int type) {
-	return (moto_sched_enabled & type) != 0;
+	return (msched_get(enabled) & type) != 0;
 }
 
 static inline bool is_scene(int scene) {
-	return (moto_sched_scene & scene) != 0;
+	return (msched_get(scene) & scene) != 0;
 }
 
 static inline bool is_heavy_scene(void) {
-	return (is_enabled(UX_ENABLE_INTERACTION) && is_scene(UX_SCENE_LAUNCH|UX_SCENE_TOUCH))
-			|| (is_enabled(UX_ENABLE_BOOST) && is_scene(UX_SCENE_BOOST));
+	struct msched_tunables *tun;
+	bool heavy;
+
+	/* enabled and scene must come from the same set */
+	rcu_read_lock();
+	tun = rcu_dereference(msched_tunables);
+	heavy = ((tun->enabled & UX_ENABLE_INTERACTION) && (tun->scene & (UX_SCENE_LAUNCH|UX_SCENE_TOUCH)))
+			|| ((tun->enabled & UX_ENABLE_BOOST) && (tun->scene & UX_SCENE_BOOST));
+	rcu_read_unlock();
+
+	return heavy;
 }
 
 static inline struct moto_task_struct *get_moto_task_struct(struct task_struct *p)
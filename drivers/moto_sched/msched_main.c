@@ -44,6 +44,7 @@ static int __init moto_sched_init(void)
 		return ret;
 
 	register_vendor_comm_hooks();
+	register_placement_hooks();
 	locking_opt_init();
 
 	pr_info("moto_sched_init succeed!\n");
@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2024 Motorola Mobility LLC
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/atomic.h>
+#include <linux/cpumask.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/sched/clock.h>
+#include <linux/sched/topology.h>
+#include <linux/version.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+#include <linux/sched/cputime.h>
+#endif
+#include <trace/hooks/sched.h>
+#include <trace/events/sched.h>
+#include <kernel/sched/sched.h>
+
+#include "msched_common.h"
+
+/* same margin as fits_capacity() in kernel/sched/fair.c */
+#define ux_fits_capacity(util, cap)	((util) * 1280 < (cap) * 1024)
+
+/*
+ * Number of runnable ux tasks per cpu. Maintained from queue_ux_task() on
+ * WALT and MTK, which call it on every enqueue and dequeue, and from the
+ * enqueue/dequeue hooks elsewhere.
+ */
+static DEFINE_PER_CPU(int, ux_nr_running);
+
+atomic64_t ux_place_stats[UX_PLACE_NR];
+atomic64_t ux_lat_hist[UX_LAT_NR];
+atomic64_t ux_lat_total;
+atomic64_t ux_lat_max;
+
+static inline int cpu_ux_nr_running(int cpu)
+{
+	return READ_ONCE(per_cpu(ux_nr_running, cpu));
+}
+
+/*
+ * Called with the rq locked. A task is counted when it is ux at enqueue and
+ * remembers that, so its dequeue matches even if its ux type changed while
+ * it was queued.
+ */
+void ux_occupancy_update(struct rq *rq, struct task_struct *p, int enqueue)
+{
+	struct moto_task_struct *wts = get_moto_task_struct(p);
+	int *nr = per_cpu_ptr(&ux_nr_running, cpu_of(rq));
+
+	if (enqueue) {
+		if (wts->ux_queued || !task_is_important_ux(p))
+			return;
+		wts->ux_queued = true;
+		WRITE_ONCE(*nr, *nr + 1);
+	} else if (wts->ux_queued) {
+		wts->ux_queued = false;
+		if (*nr > 0)
+			WRITE_ONCE(*nr, *nr - 1);
+	}
+}
+
+/*
+ * Pick the capacity level the task should wake up on: its previous cluster
+ * when the task fits there, so that it doesn't bounce between clusters,
+ * otherwise the smallest capacity that fits.
+ */
+static unsigned long ux_target_capacity(struct task_struct *p, int prev_cpu, unsigned long util)
+{
+	unsigned long prev_cap = arch_scale_cpu_capacity(prev_cpu);
+	unsigned long fit_cap = ULONG_MAX, max_cap = prev_cap, cap;
+	int cpu;
+
+	if (ux_fits_capacity(util, prev_cap))
+		return prev_cap;
+
+	for_each_cpu_and(cpu, p->cpus_ptr, cpu_active_mask) {
+		cap = arch_scale_cpu_capacity(cpu);
+		if (cap > max_cap)
+			max_cap = cap;
+		if (ux_fits_capacity(util, cap) && cap < fit_cap)
+			fit_cap = cap;
+	}
+
+	return fit_cap != ULONG_MAX ? fit_cap : max_cap;
+}
+
+/*
+ * Select a wakeup cpu for an important ux task. @sched_cpu is the cpu the
+ * platform scheduler already picked, -1 if none. Return -1 to keep the
+ * scheduler's own choice.
+ */
+int msched_select_ux_cpu(struct task_struct *p, int prev_cpu, int sched_cpu)
+{
+	unsigned long util, target_cap, min_util = ULONG_MAX;
+	int cpu, idle_cpu = -1, low_cpu = -1;
+	int place;
+
+	if (!msched_get(ux_placement) || !msched_get(enabled))
+		return -1;
+
+	if (task_get_mvp_prio(p, true) < UX_PRIO_TOPAPP)
+		return -1;
+
+	util = READ_ONCE(p->se.avg.util_avg);
+	target_cap = ux_target_capacity(p, prev_cpu, util);
+
+	/* the platform pick is as good as ours, don't override it */
+	if (sched_cpu >= 0 && arch_scale_cpu_capacity(sched_cpu) == target_cap
+			&& cpumask_test_cpu(sched_cpu, p->cpus_ptr)
+			&& available_idle_cpu(sched_cpu)
+			&& !cpu_ux_nr_running(sched_cpu)) {
+		cpu = -1;
+		place = UX_PLACE_KEEP;
+		goto out;
+	}
+
+	if (arch_scale_cpu_capacity(prev_cpu) == target_cap
+			&& cpumask_test_cpu(prev_cpu, p->cpus_ptr)
+			&& available_idle_cpu(prev_cpu)) {
+		cpu = prev_cpu;
+		place = UX_PLACE_PREV_IDLE;
+		goto out;
+	}
+
+	for_each_cpu_and(cpu, p->cpus_ptr, cpu_active_mask) {
+		unsigned long cpu_util;
+
+		if (arch_scale_cpu_capacity(cpu) != target_cap)
+			continue;
+
+		if (cpu_ux_nr_running(cpu))
+			continue;
+
+		if (available_idle_cpu(cpu)) {
+			idle_cpu = cpu;
+			break;
+		}
+
+		cpu_util = cpu_util_cfs(cpu);
+		if (cpu_util < min_util) {
+			min_util = cpu_util;
+			low_cpu = cpu;
+		}
+	}
+
+	if (idle_cpu >= 0) {
+		cpu = idle_cpu;
+		place = UX_PLACE_IDLE;
+	} else if (low_cpu >= 0) {
+		cpu = low_cpu;
+		place = UX_PLACE_LOW_UX;
+	} else {
+		/* every cpu of the cluster runs ux already, don't bounce away */
+		cpu = -1;
+		place = UX_PLACE_KEEP;
+	}
+
+out:
+	atomic64_inc(&ux_place_stats[place]);
+	if (cpu >= 0 && arch_scale_cpu_capacity(cpu) != arch_scale_cpu_capacity(prev_cpu))
+		atomic64_inc(&ux_place_stats[UX_PLACE_UPMIGRATE]);
+
+	cond_trace_printk(unlikely(is_debuggable(DEBUG_BASE)),
+			"ux_place pid=%d prev=%d cpu=%d util=%lu cap=%lu place=%d\n",
+			p->pid, prev_cpu, cpu, util, target_cap, place);
+
+	return cpu;
+}
+EXPORT_SYMBOL(msched_select_ux_cpu);
+
+#if !IS_ENABLED(CONFIG_SCHED_WALT) && !IS_ENABLED(CONFIG_MTK_SCHED_VIP_TASK)
+/*
+ * Plain CFS only. On WALT and MTK the restricted hook belongs to the
+ * platform scheduler, which can call msched_select_ux_cpu() with its pick.
+ */
+static void android_rvh_select_task_rq_fair(void *unused, struct task_struct *p, int prev_cpu,
+			int sd_flag, int wake_flags, int *new_cpu)
+{
+	int cpu;
+
+	if (!(wake_flags & WF_TTWU))
+		return;
+
+	cpu = msched_select_ux_cpu(p, prev_cpu, *new_cpu);
+	if (cpu >= 0)
+		*new_cpu = cpu;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+static void android_rvh_after_enqueue_task(void *unused, struct rq *rq,
+			struct task_struct *p, int flags)
+#else
+static void android_rvh_after_enqueue_task(void *unused, struct rq *rq,
+			struct task_struct *p)
+#endif
+{
+	ux_occupancy_update(rq, p, 1);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+static void android_rvh_after_dequeue_task(void *unused, struct rq *rq,
+			struct task_struct *p, int flags)
+#else
+static void android_rvh_after_dequeue_task(void *unused, struct rq *rq,
+			struct task_struct *p)
+#endif
+{
+	ux_occupancy_update(rq, p, 0);
+}
+#endif
+
+/* stamp real wakeups only, not every enqueue */
+static void ux_sched_wakeup(void *unused, struct task_struct *p)
+{
+	struct moto_task_struct *wts;
+	u32 now;
+
+	if (!msched_get(enabled) || !task_is_important_ux(p))
+		return;
+
+	wts = get_moto_task_struct(p);
+	now = (u32)(local_clock() / NSEC_PER_USEC);
+	/* 0 means no pending wakeup */
+	wts->ux_wake_ts = now ? now : 1;
+}
+
+static void ux_account_wake_latency(struct task_struct *next)
+{
+	struct moto_task_struct *wts = get_moto_task_struct(next);
+	u32 ts = wts->ux_wake_ts;
+	s64 delta, max;
+	int bucket;
+
+	if (!ts)
+		return;
+
+	wts->ux_wake_ts = 0;
+	delta = (u32)((u32)(local_clock() / NSEC_PER_USEC) - ts);
+
+	/* buckets: <128us <256us ... <16ms >=16ms */
+	bucket = delta < 128 ? 0 : min_t(int, ilog2(delta) - 6, UX_LAT_NR - 1);
+	atomic64_inc(&ux_lat_hist[bucket]);
+	atomic64_add(delta, &ux_lat_total);
+
+	max = atomic64_read(&ux_lat_max);
+	while (delta > max) {
+		s64 old = atomic64_cmpxchg(&ux_lat_max, max, delta);
+
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 18, 0)
+static void ux_sched_switch(void *unused, bool preempt, struct task_struct *prev,
+			struct task_struct *next, unsigned int prev_state)
+#else
+static void ux_sched_switch(void *unused, bool preempt, struct task_struct *prev,
+			struct task_struct *next)
+#endif
+{
+	ux_account_wake_latency(next);
+}
+
+void ux_placement_stats_reset(void)
+{
+	int i;
+
+	for (i = 0; i < UX_PLACE_NR; i++)
+		atomic64_set(&ux_place_stats[i], 0);
+	for (i = 0; i < UX_LAT_NR; i++)
+		atomic64_set(&ux_lat_hist[i], 0);
+	atomic64_set(&ux_lat_total, 0);
+	atomic64_set(&ux_lat_max, 0);
+}
+
+/*
+ * The wake latency probes only run while ux_placement is on. Called from
+ * msched_tunables_publish() under msched_profile_mutex when it changes.
+ */
+void ux_placement_apply(int on)
+{
+	static bool probes_on;
+
+	if (!!on == probes_on)
+		return;
+
+	if (on) {
+		if (register_trace_sched_wakeup(ux_sched_wakeup, NULL) ||
+			register_trace_sched_wakeup_new(ux_sched_wakeup, NULL) ||
+			register_trace_sched_switch(ux_sched_switch, NULL))
+			sched_warn("sched tracepoints are busy, ux wake latency not tracked\n");
+	} else {
+		unregister_trace_sched_wakeup(ux_sched_wakeup, NULL);
+		unregister_trace_sched_wakeup_new(ux_sched_wakeup, NULL);
+		unregister_trace_sched_switch(ux_sched_switch, NULL);
+	}
+	probes_on = !!on;
+}
+
+void register_placement_hooks(void)
+{
+#if !IS_ENABLED(CONFIG_SCHED_WALT) && !IS_ENABLED(CONFIG_MTK_SCHED_VIP_TASK)
+	/* WALT and MTK place and count through their own hooks, see above */
+	if (register_trace_android_rvh_select_task_rq_fair(android_rvh_select_task_rq_fair, NULL))
+		sched_warn("select_task_rq_fair hook is busy, ux placement disabled\n");
+
+	if (register_trace_android_rvh_after_enqueue_task(android_rvh_after_enqueue_task, NULL) ||
+		register_trace_android_rvh_after_dequeue_task(android_rvh_after_dequeue_task, NULL))
+		sched_warn("enqueue/dequeue hooks are busy, ux occupancy not tracked\n");
+#endif
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2024 Motorola Mobility LLC
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "msched_common.h"
+#include "msched_sysfs.h"
+
+#define CREATE_TRACE_POINTS
+#include "msched_trace.h"
+
+#define MSCHED_PROFILE_NAME_MANUAL	"manual"
+
+struct msched_profile {
+	char			name[MSCHED_PROFILE_NAME_LEN];
+	struct msched_tunables	tun;
+};
+
+static struct msched_tunables msched_default_tunables = {
+	.enabled	= 0,
+	.scene		= 0,
+	.boost_prio	= 119,
+	.ux_placement	= 0,
+};
+
+struct msched_tunables __rcu *msched_tunables = &msched_default_tunables;
+
+/* serializes all tunable updates and the profile table */
+static DEFINE_MUTEX(msched_profile_mutex);
+static struct msched_profile *msched_profiles;
+static int msched_nr_profiles;
+static char msched_active_profile[MSCHED_PROFILE_NAME_LEN] = MSCHED_PROFILE_NAME_MANUAL;
+
+/*
+ * Publish @new as the active tunables with a single pointer swap, so readers
+ * see either the whole old set or the whole new one.
+ */
+static void msched_tunables_publish(struct msched_tunables *new, const char *name)
+{
+	struct msched_tunables *old;
+
+	lockdep_assert_held(&msched_profile_mutex);
+
+	old = rcu_dereference_protected(msched_tunables,
+			lockdep_is_held(&msched_profile_mutex));
+	rcu_assign_pointer(msched_tunables, new);
+
+	if (old->enabled != new->enabled)
+		moto_sched_apply_enabled(new->enabled);
+	if (old->ux_placement != new->ux_placement)
+		ux_placement_apply(new->ux_placement);
+
+	strlcpy(msched_active_profile, name, sizeof(msched_active_profile));
+	trace_msched_profile_switch(name, old->scene, new->scene, new->enabled,
+			new->boost_prio, new->ux_placement);
+
+	if (old != &msched_default_tunables)
+		kfree_rcu(old, rcu);
+}
+
+int msched_tunable_set(int id, int val)
+{
+	struct msched_tunables *new;
+
+	mutex_lock(&msched_profile_mutex);
+	new = kmemdup(rcu_dereference_protected(msched_tunables,
+				lockdep_is_held(&msched_profile_mutex)),
+			sizeof(*new), GFP_KERNEL);
+	if (!new) {
+		mutex_unlock(&msched_profile_mutex);
+		return -ENOMEM;
+	}
+
+	switch (id) {
+	case MSCHED_TUN_ENABLED:
+		new->enabled = val;
+		break;
+	case MSCHED_TUN_SCENE:
+		new->scene = val;
+		break;
+	case MSCHED_TUN_BOOST_PRIO:
+		new->boost_prio = val;
+		break;
+	case MSCHED_TUN_UX_PLACEMENT:
+		new->ux_placement = val;
+		break;
+	}
+
+	msched_tunables_publish(new, MSCHED_PROFILE_NAME_MANUAL);
+	mutex_unlock(&msched_profile_mutex);
+
+	return 0;
+}
+
+/*
+ * Replace the profile table. One profile per line:
+ *   <name> <enabled(hex)> <scene> <boost_prio> <ux_placement>
+ * The active tunables are left untouched until a profile is activated.
+ */
+int msched_profile_load(char *buf)
+{
+	struct msched_profile *table, *old;
+	unsigned int enabled;
+	char *line;
+	int nr = 0;
+
+	table = kcalloc(MSCHED_PROFILE_MAX, sizeof(*table), GFP_KERNEL);
+	if (!table)
+		return -ENOMEM;
+
+	while ((line = strsep(&buf, "\n")) != NULL) {
+		struct msched_profile *prof;
+
+		line = strstrip(line);
+		if (!*line)
+			continue;
+
+		if (nr >= MSCHED_PROFILE_MAX) {
+			kfree(table);
+			return -E2BIG;
+		}
+
+		prof = &table[nr];
+		if (sscanf(line, "%15s %x %d %d %d", prof->name, &enabled,
+				&prof->tun.scene, &prof->tun.boost_prio,
+				&prof->tun.ux_placement) != 5) {
+			sched_err("invalid profile line: %s\n", line);
+			kfree(table);
+			return -EINVAL;
+		}
+		prof->tun.enabled = enabled;
+		prof->tun.ux_placement = !!prof->tun.ux_placement;
+		nr++;
+	}
+
+	mutex_lock(&msched_profile_mutex);
+	old = msched_profiles;
+	msched_profiles = table;
+	msched_nr_profiles = nr;
+	mutex_unlock(&msched_profile_mutex);
+
+	kfree(old);
+	return 0;
+}
+
+int msched_profile_activate(const char *name)
+{
+	struct msched_tunables *new;
+	int i, ret = -ENOENT;
+
+	mutex_lock(&msched_profile_mutex);
+	for (i = 0; i < msched_nr_profiles; i++) {
+		if (strcmp(msched_profiles[i].name, name))
+			continue;
+
+		new = kmemdup(&msched_profiles[i].tun, sizeof(*new), GFP_KERNEL);
+		if (!new) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		msched_tunables_publish(new, msched_profiles[i].name);
+		ret = 0;
+		break;
+	}
+	mutex_unlock(&msched_profile_mutex);
+
+	return ret;
+}
+
+size_t msched_profile_show(char *buf, size_t size, bool table)
+{
+	size_t len = 0;
+	int i;
+
+	mutex_lock(&msched_profile_mutex);
+	if (!table) {
+		len = scnprintf(buf, size, "%s\n", msched_active_profile);
+		goto out;
+	}
+
+	for (i = 0; i < msched_nr_profiles; i++) {
+		struct msched_profile *prof = &msched_profiles[i];
+
+		len += scnprintf(buf + len, size - len, "%s 0x%x %d %d %d\n",
+				prof->name, prof->tun.enabled, prof->tun.scene,
+				prof->tun.boost_prio, prof->tun.ux_placement);
+	}
+out:
+	mutex_unlock(&msched_profile_mutex);
+
+	return len;
+}
@@ -16,18 +16,18 @@
 #include <linux/proc_fs.h>
 #include <linux/uaccess.h>
 #include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
 
 #include "msched_sysfs.h"
 #include "msched_common.h"
+#include "locking/locking_main.h"
 
 #define MOTO_SCHED_PROC_DIR		"moto_sched"
 
 #define MAX_SET (128)
 
-int __read_mostly moto_sched_enabled;
 int __read_mostly moto_sched_debug;
-int __read_mostly moto_sched_scene;
-int __read_mostly moto_boost_prio = 119;
 pid_t __read_mostly global_systemserver_tgid = -1;
 pid_t __read_mostly global_launcher_tgid = -1;
 pid_t __read_mostly global_sysui_tgid = -1;
@@ -66,6 +66,18 @@ static struct msched_ops sched_ops = {
 };
 #endif
 
+/* called with the new enabled value whenever the active tunables change it */
+void moto_sched_apply_enabled(int enabled)
+{
+#if IS_ENABLED(CONFIG_SCHED_WALT)
+	set_moto_sched_enabled(enabled);
+	set_moto_sched_ops(enabled? &sched_ops : NULL);
+#elif IS_ENABLED(CONFIG_MTK_SCHED_VIP_TASK)
+	set_moto_sched_enabled(enabled);
+	set_moto_sched_ops(enabled? &sched_ops : NULL);
+#endif
+}
+
 static ssize_t proc_enabled_write(struct file *file, const char __user *buf,
 		size_t count, loff_t *ppos)
 {
@@ -85,15 +97,9 @@ static ssize_t proc_enabled_write(struct file *file, const char __user *buf,
 	if (err)
 		return err;
 
-	moto_sched_enabled = val;
-
-#if IS_ENABLED(CONFIG_SCHED_WALT)
-	set_moto_sched_enabled(moto_sched_enabled);
-	set_moto_sched_ops(moto_sched_enabled? &sched_ops : NULL);
-#elif IS_ENABLED(CONFIG_MTK_SCHED_VIP_TASK)
-	set_moto_sched_enabled(moto_sched_enabled);
-	set_moto_sched_ops(moto_sched_enabled? &sched_ops : NULL);
-#endif
+	err = msched_tunable_set(MSCHED_TUN_ENABLED, val);
+	if (err)
+		return err;
 
 	return count;
 }
@@ -105,7 +111,7 @@ static ssize_t proc_enabled_read(struct file *file, char __user *buf,
 	size_t len = 0;
 
 	len = snprintf(buffer, sizeof(buffer), "0x%x base=%d interaction=%d lock=%d binder=%d audio=%d camera=%d kswapd=%d boost=%d kernel=%d\n",
-			moto_sched_enabled,
+			msched_get(enabled),
 			is_enabled(UX_ENABLE_BASE),
 			is_enabled(UX_ENABLE_INTERACTION),
 			is_enabled(UX_ENABLE_LOCK),
@@ -164,7 +170,6 @@ static ssize_t proc_ux_scene_write(struct file *file, const char __user *buf,
 {
 	char buffer[13];
 	int err, val;
-	static DEFINE_MUTEX(ux_scene_mutex);
 
 	memset(buffer, 0, sizeof(buffer));
 
@@ -179,9 +184,10 @@ static ssize_t proc_ux_scene_write(struct file *file, const char __user *buf,
 	if (err)
 		return err;
 
-	mutex_lock(&ux_scene_mutex);
-	moto_sched_scene = val;
-	mutex_unlock(&ux_scene_mutex);
+	err = msched_tunable_set(MSCHED_TUN_SCENE, val);
+	if (err)
+		return err;
+
 	return count;
 }
 
@@ -191,7 +197,7 @@ static ssize_t proc_ux_scene_read(struct file *file, char __user *buf,
 	char buffer[13];
 	size_t len = 0;
 
-	len = snprintf(buffer, sizeof(buffer), "%d\n", moto_sched_scene);
+	len = snprintf(buffer, sizeof(buffer), "%d\n", msched_get(scene));
 
 	return simple_read_from_buffer(buf, count, ppos, buffer, len);
 }
@@ -340,7 +346,6 @@ static ssize_t proc_boost_prio_write(struct file *file, const char __user *buf,
 {
 	char buffer[13];
 	int err, val;
-	static DEFINE_MUTEX(boost_prio_mutex);
 
 	memset(buffer, 0, sizeof(buffer));
 
@@ -355,9 +360,10 @@ static ssize_t proc_boost_prio_write(struct file *file, const char __user *buf,
 	if (err)
 		return err;
 
-	mutex_lock(&boost_prio_mutex);
-	moto_boost_prio = val;
-	mutex_unlock(&boost_prio_mutex);
+	err = msched_tunable_set(MSCHED_TUN_BOOST_PRIO, val);
+	if (err)
+		return err;
+
 	return count;
 }
 
@@ -367,7 +373,213 @@ static ssize_t proc_boost_prio_read(struct file *file, char __user *buf,
 	char buffer[13];
 	size_t len = 0;
 
-	len = snprintf(buffer, sizeof(buffer), "%d\n", moto_boost_prio);
+	len = snprintf(buffer, sizeof(buffer), "%d\n", msched_get(boost_prio));
+
+	return simple_read_from_buffer(buf, count, ppos, buffer, len);
+}
+
+/*
+ * echo "launch 0x1ff 1 120 1
+ *       idle 0x1 0 119 0" > proc/moto_sched/ux_profiles
+ * load the profile table, one "<name> <enabled> <ux_scene> <boost_prio> <ux_placement>" per line
+ *
+ * echo launch > proc/moto_sched/ux_profile
+ * switch all tunables to profile "launch" at once
+ */
+static ssize_t proc_ux_profiles_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	char *buffer;
+	int err;
+
+	if (count > PAGE_SIZE)
+		return -EINVAL;
+
+	buffer = memdup_user_nul(buf, count);
+	if (IS_ERR(buffer))
+		return PTR_ERR(buffer);
+
+	err = msched_profile_load(buffer);
+	kfree(buffer);
+	if (err)
+		return err;
+
+	return count;
+}
+
+static ssize_t proc_ux_profiles_read(struct file *file, char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	char *buffer;
+	size_t len;
+	ssize_t ret;
+
+	buffer = kzalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buffer)
+		return -ENOMEM;
+
+	len = msched_profile_show(buffer, PAGE_SIZE, true);
+	ret = simple_read_from_buffer(buf, count, ppos, buffer, len);
+	kfree(buffer);
+
+	return ret;
+}
+
+static ssize_t proc_ux_profile_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	char buffer[MSCHED_PROFILE_NAME_LEN];
+	int err;
+
+	memset(buffer, 0, sizeof(buffer));
+
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	buffer[count] = '\0';
+	err = msched_profile_activate(strstrip(buffer));
+	if (err)
+		return err;
+
+	return count;
+}
+
+static ssize_t proc_ux_profile_read(struct file *file, char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	char buffer[MSCHED_PROFILE_NAME_LEN + 1];
+	size_t len = 0;
+
+	len = msched_profile_show(buffer, sizeof(buffer), false);
+
+	return simple_read_from_buffer(buf, count, ppos, buffer, len);
+}
+
+static ssize_t proc_ux_placement_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	char buffer[13];
+	int err, val;
+
+	memset(buffer, 0, sizeof(buffer));
+
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	buffer[count] = '\0';
+	err = kstrtoint(strstrip(buffer), 10, &val);
+	if (err)
+		return err;
+
+	err = msched_tunable_set(MSCHED_TUN_UX_PLACEMENT, !!val);
+	if (err)
+		return err;
+
+	return count;
+}
+
+static ssize_t proc_ux_placement_read(struct file *file, char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	char buffer[13];
+	size_t len = 0;
+
+	len = snprintf(buffer, sizeof(buffer), "%d\n", msched_get(ux_placement));
+
+	return simple_read_from_buffer(buf, count, ppos, buffer, len);
+}
+
+/*
+ * cat proc/moto_sched/ux_placement_stats
+ * ux wakeup placement decisions and wake-to-run latency histogram
+ *
+ * echo 0 > proc/moto_sched/ux_placement_stats
+ * reset the statistics
+ */
+static ssize_t proc_ux_placement_stats_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	ux_placement_stats_reset();
+
+	return count;
+}
+
+static ssize_t proc_ux_placement_stats_read(struct file *file, char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	static const char * const lat_name[UX_LAT_NR] = {
+		"<128us", "<256us", "<512us", "<1ms", "<2ms", "<4ms", "<8ms", "<16ms", ">=16ms",
+	};
+	char buffer[512];
+	size_t len = 0;
+	s64 wakeups = 0;
+	int i;
+
+	for (i = 0; i < UX_LAT_NR; i++)
+		wakeups += atomic64_read(&ux_lat_hist[i]);
+
+	len += snprintf(buffer + len, sizeof(buffer) - len,
+			"prev_idle=%lld idle=%lld low_ux=%lld keep=%lld upmigrate=%lld\n",
+			atomic64_read(&ux_place_stats[UX_PLACE_PREV_IDLE]),
+			atomic64_read(&ux_place_stats[UX_PLACE_IDLE]),
+			atomic64_read(&ux_place_stats[UX_PLACE_LOW_UX]),
+			atomic64_read(&ux_place_stats[UX_PLACE_KEEP]),
+			atomic64_read(&ux_place_stats[UX_PLACE_UPMIGRATE]));
+
+	len += snprintf(buffer + len, sizeof(buffer) - len,
+			"wakeups=%lld avg_us=%lld max_us=%lld\n",
+			wakeups,
+			wakeups ? atomic64_read(&ux_lat_total) / wakeups : 0,
+			atomic64_read(&ux_lat_max));
+
+	for (i = 0; i < UX_LAT_NR; i++)
+		len += snprintf(buffer + len, sizeof(buffer) - len, "%s %lld\n",
+				lat_name[i], atomic64_read(&ux_lat_hist[i]));
+
+	return simple_read_from_buffer(buf, count, ppos, buffer, len);
+}
+
+/*
+ * cat proc/moto_sched/lock_stats
+ * lock inherit chain length histogram and boost durations
+ *
+ * echo 0 > proc/moto_sched/lock_stats
+ * reset the statistics
+ */
+static ssize_t proc_lock_stats_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	lock_stats_reset();
+
+	return count;
+}
+
+static ssize_t proc_lock_stats_read(struct file *file, char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	char buffer[256];
+	size_t len = 0;
+	s64 boosts = atomic64_read(&lock_boost_count);
+	int i;
+
+	len += snprintf(buffer + len, sizeof(buffer) - len, "chain_len");
+	for (i = 1; i <= UX_DEPTH_MAX; i++)
+		len += snprintf(buffer + len, sizeof(buffer) - len, " %d:%lld",
+				i, atomic64_read(&lock_chain_len[i]));
+
+	len += snprintf(buffer + len, sizeof(buffer) - len,
+			"\ncycles=%lld truncated=%lld\nboosts=%lld avg_ms=%lld max_ms=%lld\n",
+			atomic64_read(&lock_chain_cycles),
+			atomic64_read(&lock_chain_truncated),
+			boosts,
+			boosts ? atomic64_read(&lock_boost_time_total) / boosts / NSEC_PER_MSEC : 0,
+			atomic64_read(&lock_boost_time_max) / NSEC_PER_MSEC);
 
 	return simple_read_from_buffer(buf, count, ppos, buffer, len);
 }
@@ -408,6 +620,31 @@ static const struct proc_ops proc_boost_prio_fops = {
 	.proc_read		= proc_boost_prio_read,
 };
 
+static const struct proc_ops proc_ux_profiles_fops = {
+	.proc_write		= proc_ux_profiles_write,
+	.proc_read		= proc_ux_profiles_read,
+};
+
+static const struct proc_ops proc_ux_profile_fops = {
+	.proc_write		= proc_ux_profile_write,
+	.proc_read		= proc_ux_profile_read,
+};
+
+static const struct proc_ops proc_ux_placement_fops = {
+	.proc_write		= proc_ux_placement_write,
+	.proc_read		= proc_ux_placement_read,
+};
+
+static const struct proc_ops proc_ux_placement_stats_fops = {
+	.proc_write		= proc_ux_placement_stats_write,
+	.proc_read		= proc_ux_placement_stats_read,
+};
+
+static const struct proc_ops proc_lock_stats_fops = {
+	.proc_write		= proc_lock_stats_write,
+	.proc_read		= proc_lock_stats_read,
+};
+
 static const struct proc_ops proc_version_fops = {
 	.proc_read		= proc_version_read,
 };
@@ -458,8 +695,53 @@ int moto_sched_proc_init(void)
 		goto err_creat_debug;
 	}
 
+	proc_node = proc_create("lock_stats", 0664, d_moto_sched, &proc_lock_stats_fops);
+	if (!proc_node) {
+		sched_err("failed to create proc node lock_stats\n");
+		goto err_creat_lock_stats;
+	}
+
+	proc_node = proc_create("ux_placement", 0666, d_moto_sched, &proc_ux_placement_fops);
+	if (!proc_node) {
+		sched_err("failed to create proc node ux_placement\n");
+		goto err_creat_ux_placement;
+	}
+
+	proc_node = proc_create("ux_placement_stats", 0664, d_moto_sched, &proc_ux_placement_stats_fops);
+	if (!proc_node) {
+		sched_err("failed to create proc node ux_placement_stats\n");
+		goto err_creat_ux_placement_stats;
+	}
+
+	proc_node = proc_create("ux_profiles", 0666, d_moto_sched, &proc_ux_profiles_fops);
+	if (!proc_node) {
+		sched_err("failed to create proc node ux_profiles\n");
+		goto err_creat_ux_profiles;
+	}
+
+	proc_node = proc_create("ux_profile", 0666, d_moto_sched, &proc_ux_profile_fops);
+	if (!proc_node) {
+		sched_err("failed to create proc node ux_profile\n");
+		goto err_creat_ux_profile;
+	}
+
 	return 0;
 
+err_creat_ux_profile:
+	remove_proc_entry("ux_profiles", d_moto_sched);
+
+err_creat_ux_profiles:
+	remove_proc_entry("ux_placement_stats", d_moto_sched);
+
+err_creat_ux_placement_stats:
+	remove_proc_entry("ux_placement", d_moto_sched);
+
+err_creat_ux_placement:
+	remove_proc_entry("lock_stats", d_moto_sched);
+
+err_creat_lock_stats:
+	remove_proc_entry("debug", d_moto_sched);
+
 err_creat_debug:
 	remove_proc_entry("version", d_moto_sched);
 
@@ -484,6 +766,11 @@ err_creat_d_moto_sched:
 
 void moto_sched_proc_deinit(void)
 {
+	remove_proc_entry("ux_profile", d_moto_sched);
+	remove_proc_entry("ux_profiles", d_moto_sched);
+	remove_proc_entry("ux_placement_stats", d_moto_sched);
+	remove_proc_entry("ux_placement", d_moto_sched);
+	remove_proc_entry("lock_stats", d_moto_sched);
 	remove_proc_entry("debug", d_moto_sched);
 	remove_proc_entry("version", d_moto_sched);
 	remove_proc_entry("boost_prio", d_moto_sched);
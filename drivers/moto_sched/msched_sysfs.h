@@ -16,6 +16,7 @@
 
 int moto_sched_proc_init(void);
 void moto_sched_proc_deinit(void);
+void moto_sched_apply_enabled(int enabled);
 
 
 extern struct task_struct *find_task_by_vpid(pid_t vnr);
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) 2024 Motorola Mobility LLC
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM moto_sched
+
+#if !defined(_MSCHED_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _MSCHED_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(msched_profile_switch,
+
+	TP_PROTO(const char *name, int old_scene, int scene, int enabled,
+		 int boost_prio, int ux_placement),
+
+	TP_ARGS(name, old_scene, scene, enabled, boost_prio, ux_placement),
+
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(int, old_scene)
+		__field(int, scene)
+		__field(int, enabled)
+		__field(int, boost_prio)
+		__field(int, ux_placement)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->old_scene = old_scene;
+		__entry->scene = scene;
+		__entry->enabled = enabled;
+		__entry->boost_prio = boost_prio;
+		__entry->ux_placement = ux_placement;
+	),
+
+	TP_printk("profile=%s scene=%d->%d enabled=0x%x boost_prio=%d ux_placement=%d",
+		__get_str(name), __entry->old_scene, __entry->scene,
+		__entry->enabled, __entry->boost_prio, __entry->ux_placement)
+);
+
+#endif /* _MSCHED_TRACE_H */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH ../../../../motorola/kernel/modules/drivers/moto_sched
+#define TRACE_INCLUDE_FILE msched_trace
+#include <trace/define_trace.h>
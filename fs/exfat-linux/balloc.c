@@ -9,37 +9,372 @@
 
 #include "exfat_fs.h"
 
-static const unsigned char free_bit[] = {
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2,/*  0 ~  19*/
-	0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 5, 0, 1, 0, 2, 0, 1, 0, 3,/* 20 ~  39*/
-	0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2,/* 40 ~  59*/
-	0, 1, 0, 6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4,/* 60 ~  79*/
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 5, 0, 1, 0, 2,/* 80 ~  99*/
-	0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3,/*100 ~ 119*/
-	0, 1, 0, 2, 0, 1, 0, 7, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2,/*120 ~ 139*/
-	0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 5,/*140 ~ 159*/
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2,/*160 ~ 179*/
-	0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 6, 0, 1, 0, 2, 0, 1, 0, 3,/*180 ~ 199*/
-	0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2,/*200 ~ 219*/
-	0, 1, 0, 5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4,/*220 ~ 239*/
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0                /*240 ~ 254*/
-};
+/*
+ *  Free Extent Cache
+ *
+ *  A few runs of clusters known to be free, so that allocation on a nearly
+ *  full volume doesn't have to scan the bitmap. Every extent is exact: the
+ *  bitmap is only changed through exfat_set_bitmap()/exfat_clear_bitmap(),
+ *  which keep the cache in sync. Extents may overlap. All of this runs
+ *  under bitmap_lock.
+ */
+static void exfat_free_ext_add(struct exfat_sb_info *sbi, unsigned int start,
+		unsigned int len)
+{
+	struct exfat_free_extent *ext, *victim = NULL;
+	int i;
 
-static const unsigned char used_bit[] = {
-	0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3,/*  0 ~  19*/
-	2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4,/* 20 ~  39*/
-	2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5,/* 40 ~  59*/
-	4, 5, 5, 6, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,/* 60 ~  79*/
-	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4,/* 80 ~  99*/
-	3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6,/*100 ~ 119*/
-	4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4,/*120 ~ 139*/
-	3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,/*140 ~ 159*/
-	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5,/*160 ~ 179*/
-	4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 2, 3, 3, 4, 3, 4, 4, 5,/*180 ~ 199*/
-	3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6,/*200 ~ 219*/
-	5, 6, 6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,/*220 ~ 239*/
-	4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8             /*240 ~ 255*/
-};
+	for (i = 0; i < EXFAT_FREE_EXTENTS; i++) {
+		unsigned int end;
+
+		ext = &sbi->free_ext[i];
+		if (!ext->len) {
+			if (!victim || victim->len)
+				victim = ext;
+			continue;
+		}
+
+		/* both runs are free, so their union is free too */
+		end = ext->start + ext->len;
+		if (start <= end && ext->start <= start + len) {
+			end = max(end, start + len);
+			ext->start = min(ext->start, start);
+			ext->len = end - ext->start;
+			return;
+		}
+
+		if (!victim || (victim->len && ext->len < victim->len))
+			victim = ext;
+	}
+
+	if (victim->len < len) {
+		victim->start = start;
+		victim->len = len;
+	}
+}
+
+static void exfat_free_ext_remove(struct exfat_sb_info *sbi, unsigned int clu)
+{
+	struct exfat_free_extent *ext;
+	unsigned int end;
+	int i;
+
+	for (i = 0; i < EXFAT_FREE_EXTENTS; i++) {
+		ext = &sbi->free_ext[i];
+		end = ext->start + ext->len;
+		if (!ext->len || clu < ext->start || clu >= end)
+			continue;
+
+		if (clu == ext->start) {
+			ext->start++;
+			ext->len--;
+		} else if (clu == end - 1) {
+			ext->len--;
+		} else if (clu - ext->start >= end - clu - 1) {
+			/* split, keeping the larger half in place */
+			ext->len = clu - ext->start;
+			exfat_free_ext_add(sbi, clu + 1, end - clu - 1);
+		} else {
+			unsigned int left = ext->start;
+
+			ext->start = clu + 1;
+			ext->len = end - clu - 1;
+			exfat_free_ext_add(sbi, left, clu - left);
+		}
+	}
+}
+
+/*
+ * Return the start of the smallest cached extent that holds num_alloc
+ * clusters, or of the largest one if none is big enough.
+ */
+static unsigned int exfat_free_ext_pick(struct exfat_sb_info *sbi,
+		unsigned int num_alloc)
+{
+	struct exfat_free_extent *ext, *best = NULL;
+	int i;
+
+	for (i = 0; i < EXFAT_FREE_EXTENTS; i++) {
+		ext = &sbi->free_ext[i];
+		if (!ext->len)
+			continue;
+
+		if (!best ||
+		    (ext->len >= num_alloc &&
+		     (best->len < num_alloc || ext->len < best->len)) ||
+		    (best->len < num_alloc && ext->len > best->len))
+			best = ext;
+	}
+
+	return best ? best->start : EXFAT_EOF_CLUSTER;
+}
+
+/*
+ *  Preallocation Windows
+ *
+ *  A regular file being written reserves a window of free clusters past
+ *  its end, in memory only, and other files allocate around it. Files
+ *  written at the same time then don't interleave, and stay NoFatChain.
+ *  The window doubles each time it is used up, so streaming writers get
+ *  long runs. All of this runs under bitmap_lock.
+ */
+
+/* Return the inode other than "inode" whose window holds "clu", if any */
+static struct exfat_inode_info *exfat_pa_owner(struct exfat_sb_info *sbi,
+		struct inode *inode, unsigned int clu)
+{
+	struct exfat_inode_info *ei;
+
+	list_for_each_entry(ei, &sbi->pa_windows, pa_list) {
+		if (&ei->vfs_inode != inode && clu >= ei->pa_start &&
+		    clu - ei->pa_start < ei->pa_len)
+			return ei;
+	}
+
+	return NULL;
+}
+
+/* A cluster is being allocated, take it out of every window */
+static void exfat_pa_consume(struct exfat_sb_info *sbi, unsigned int clu)
+{
+	struct exfat_inode_info *ei;
+
+	list_for_each_entry(ei, &sbi->pa_windows, pa_list) {
+		if (clu >= ei->pa_start && clu - ei->pa_start < ei->pa_len) {
+			ei->pa_len -= clu + 1 - ei->pa_start;
+			ei->pa_start = clu + 1;
+		}
+	}
+}
+
+/*
+ *  Allocation Bitmap Chunks
+ *
+ *  The bitmap isn't read at mount. It is read in EXFAT_AMAP_CHUNK_BITS
+ *  sized chunks when the allocator or the used cluster count first needs
+ *  them, and the buffers of a chunk stay in vol_amap until the shrinker
+ *  finds the chunk clean and unused since its previous pass. All of this
+ *  runs under bitmap_lock.
+ */
+static unsigned int exfat_amap_chunk_end(struct exfat_sb_info *sbi,
+		unsigned int c)
+{
+	return min((c + 1) << sbi->amap_chunk_bits, sbi->map_sectors);
+}
+
+static void exfat_amap_readahead(struct super_block *sb, unsigned int c)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	sector_t sector = exfat_cluster_to_sector(sbi, sbi->map_clu);
+	unsigned int i, end = exfat_amap_chunk_end(sbi, c);
+	struct blk_plug plug;
+
+	blk_start_plug(&plug);
+	for (i = c << sbi->amap_chunk_bits; i < end; i++)
+		sb_breadahead(sb, sector + i);
+	blk_finish_plug(&plug);
+}
+
+static int exfat_amap_load(struct super_block *sb, unsigned int c)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	sector_t sector = exfat_cluster_to_sector(sbi, sbi->map_clu);
+	unsigned int i, first = c << sbi->amap_chunk_bits;
+	unsigned int end = exfat_amap_chunk_end(sbi, c);
+
+	exfat_amap_readahead(sb, c);
+	for (i = first; i < end; i++) {
+		sbi->vol_amap[i] = sb_bread(sb, sector + i);
+		if (!sbi->vol_amap[i]) {
+			/* release the buffers read so far */
+			while (i > first) {
+				i--;
+				brelse(sbi->vol_amap[i]);
+				sbi->vol_amap[i] = NULL;
+			}
+			return -EIO;
+		}
+	}
+
+	sbi->amap_loaded++;
+	return 0;
+}
+
+/* Release a loaded chunk, unless some of its buffers are still dirty */
+static bool exfat_amap_release(struct exfat_sb_info *sbi, unsigned int c)
+{
+	unsigned int i, first = c << sbi->amap_chunk_bits;
+	unsigned int end = exfat_amap_chunk_end(sbi, c);
+
+	for (i = first; i < end; i++) {
+		if (buffer_dirty(sbi->vol_amap[i]))
+			return false;
+	}
+
+	for (i = first; i < end; i++) {
+		brelse(sbi->vol_amap[i]);
+		sbi->vol_amap[i] = NULL;
+	}
+
+	sbi->amap_loaded--;
+	return true;
+}
+
+/*
+ * Return the buffer of the i-th bitmap sector, reading its chunk in if
+ * needed, or NULL on I/O error.
+ */
+static struct buffer_head *exfat_amap_get(struct super_block *sb,
+		unsigned int i)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	unsigned int c = i >> sbi->amap_chunk_bits;
+
+	if (!test_bit(c, sbi->amap_ref))
+		__set_bit(c, sbi->amap_ref);
+
+	if (unlikely(!sbi->vol_amap[i]) && exfat_amap_load(sb, c)) {
+		exfat_fs_error_ratelimit(sb,
+			"failed to read allocation bitmap (sector %u)", i);
+		return NULL;
+	}
+
+	return sbi->vol_amap[i];
+}
+
+static unsigned long exfat_amap_shrink_count(struct shrinker *shrink,
+		struct shrink_control *sc)
+{
+	struct exfat_sb_info *sbi =
+		container_of(shrink, struct exfat_sb_info, amap_shrinker);
+
+	return READ_ONCE(sbi->amap_loaded);
+}
+
+static unsigned long exfat_amap_shrink_scan(struct shrinker *shrink,
+		struct shrink_control *sc)
+{
+	struct exfat_sb_info *sbi =
+		container_of(shrink, struct exfat_sb_info, amap_shrinker);
+	unsigned long freed = 0;
+	unsigned int n;
+
+	/* the allocator may be holding it while it waits for memory */
+	if (!mutex_trylock(&sbi->bitmap_lock))
+		return SHRINK_STOP;
+
+	for (n = 0; n < sbi->amap_chunks && freed < sc->nr_to_scan; n++) {
+		unsigned int c = sbi->amap_scan;
+
+		if (++sbi->amap_scan == sbi->amap_chunks)
+			sbi->amap_scan = 0;
+
+		if (!sbi->vol_amap[c << sbi->amap_chunk_bits])
+			continue;
+
+		/* give chunks used since the previous pass a second chance */
+		if (__test_and_clear_bit(c, sbi->amap_ref))
+			continue;
+
+		if (exfat_amap_release(sbi, c))
+			freed++;
+	}
+	mutex_unlock(&sbi->bitmap_lock);
+
+	return freed;
+}
+
+/*
+ *  Used Cluster Accounting
+ */
+static unsigned int exfat_count_used_in_sector(struct buffer_head *bh,
+		unsigned int nbits)
+{
+	const __le64 *map = (const __le64 *)bh->b_data;
+	unsigned int i, count = 0;
+
+	for (i = 0; i < nbits / 64; i++)
+		count += hweight64(le64_to_cpu(map[i]));
+	if (nbits % 64)
+		count += hweight64(le64_to_cpu(map[i]) &
+				   GENMASK_ULL(nbits % 64 - 1, 0));
+
+	return count;
+}
+
+/* number of bitmap entries held by the i-th bitmap sector */
+static unsigned int exfat_bitmap_sector_bits(struct super_block *sb,
+		unsigned int i)
+{
+	unsigned int bits = BITS_PER_SECTOR(sb);
+
+	return min(EXFAT_DATA_CLUSTER_COUNT(EXFAT_SB(sb)) - i * bits, bits);
+}
+
+/*
+ * Count the used clusters after mount, one bitmap chunk at a time under
+ * bitmap_lock, so that allocation can go on meanwhile. Until the count is
+ * complete, bitmap updates are accounted into scan_used only for sectors
+ * that were already counted; the rest will be seen by the scan.
+ */
+void exfat_count_used_work(struct work_struct *work)
+{
+	struct exfat_sb_info *sbi =
+		container_of(work, struct exfat_sb_info, count_work);
+	struct super_block *sb = sbi->sb;
+	struct buffer_head *bh;
+	unsigned int c, i, first, end, nbits;
+	bool loaded;
+
+	for (c = 0; c < sbi->amap_chunks; c++) {
+		first = c << sbi->amap_chunk_bits;
+		end = exfat_amap_chunk_end(sbi, c);
+
+		/* do the I/O outside of bitmap_lock */
+		exfat_amap_readahead(sb, c);
+
+		mutex_lock(&sbi->bitmap_lock);
+		loaded = sbi->vol_amap[first] != NULL;
+		for (i = first; i < end; i++) {
+			nbits = exfat_bitmap_sector_bits(sb, i);
+			bh = exfat_amap_get(sb, i);
+			/* nothing is allocated from an unreadable sector */
+			sbi->scan_used += bh ?
+				exfat_count_used_in_sector(bh, nbits) : nbits;
+		}
+		sbi->scan_sectors = end;
+		if (sbi->scan_sectors == sbi->map_sectors)
+			sbi->used_clusters = sbi->scan_used;
+
+		/* don't keep the chunks that were only read to be counted */
+		if (!loaded && sbi->vol_amap[first] &&
+		    exfat_amap_release(sbi, c))
+			__clear_bit(c, sbi->amap_ref);
+		mutex_unlock(&sbi->bitmap_lock);
+
+		cond_resched();
+	}
+}
+
+void exfat_start_count_used(struct super_block *sb)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+
+	sbi->used_clusters = EXFAT_CLUSTERS_UNTRACKED;
+	sbi->scan_used = 0;
+	sbi->scan_sectors = 0;
+	queue_work(system_unbound_wq, &sbi->count_work);
+}
+
+/* This function must be called with bitmap_lock held */
+static void exfat_account_used(struct exfat_sb_info *sbi, unsigned int i,
+		int delta)
+{
+	if (sbi->used_clusters != EXFAT_CLUSTERS_UNTRACKED)
+		sbi->used_clusters += delta;
+	else if (i < sbi->scan_sectors)
+		sbi->scan_used += delta;
+}
 
 /*
  *  Allocation Bitmap Management Functions
@@ -49,8 +384,8 @@ static int exfat_allocate_bitmap(struct super_block *sb,
 {
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
 	long long map_size;
-	unsigned int i, need_map_size;
-	sector_t sector;
+	unsigned int need_map_size;
+	int err;
 
 	sbi->map_clu = le32_to_cpu(ep->dentry.bitmap.start_clu);
 	map_size = le64_to_cpu(ep->dentry.bitmap.size);
@@ -68,28 +403,39 @@ static int exfat_allocate_bitmap(struct super_block *sb,
 	}
 	sbi->map_sectors = ((need_map_size - 1) >>
 			(sb->s_blocksize_bits)) + 1;
-	sbi->vol_amap = kmalloc_array(sbi->map_sectors,
-				sizeof(struct buffer_head *), GFP_KERNEL);
-	if (!sbi->vol_amap)
-		return -ENOMEM;
+	memset(sbi->free_ext, 0, sizeof(sbi->free_ext));
 
-	sector = exfat_cluster_to_sector(sbi, sbi->map_clu);
-	for (i = 0; i < sbi->map_sectors; i++) {
-		sbi->vol_amap[i] = sb_bread(sb, sector + i);
-		if (!sbi->vol_amap[i]) {
-			/* release all buffers and free vol_amap */
-			int j = 0;
+	/* the chunks are read in on first use, see exfat_amap_get() */
+	sbi->amap_chunk_bits = EXFAT_AMAP_CHUNK_BITS > sb->s_blocksize_bits ?
+		EXFAT_AMAP_CHUNK_BITS - sb->s_blocksize_bits : 0;
+	sbi->amap_chunks = ((sbi->map_sectors - 1) >> sbi->amap_chunk_bits) + 1;
+	sbi->amap_loaded = 0;
+	sbi->amap_scan = 0;
 
-			while (j < i)
-				brelse(sbi->vol_amap[j++]);
-
-			kfree(sbi->vol_amap);
-			sbi->vol_amap = NULL;
-			return -EIO;
-		}
+	sbi->vol_amap = kcalloc(sbi->map_sectors,
+				sizeof(struct buffer_head *), GFP_KERNEL);
+	sbi->amap_ref = kcalloc(BITS_TO_LONGS(sbi->amap_chunks),
+				sizeof(unsigned long), GFP_KERNEL);
+	if (!sbi->vol_amap || !sbi->amap_ref) {
+		err = -ENOMEM;
+		goto free;
 	}
 
+	sbi->amap_shrinker.count_objects = exfat_amap_shrink_count;
+	sbi->amap_shrinker.scan_objects = exfat_amap_shrink_scan;
+	sbi->amap_shrinker.seeks = DEFAULT_SEEKS;
+	err = register_shrinker(&sbi->amap_shrinker);
+	if (err)
+		goto free;
+
 	return 0;
+
+free:
+	kfree(sbi->amap_ref);
+	sbi->amap_ref = NULL;
+	kfree(sbi->vol_amap);
+	sbi->vol_amap = NULL;
+	return err;
 }
 
 int exfat_load_bitmap(struct super_block *sb)
@@ -134,10 +480,14 @@ void exfat_free_bitmap(struct exfat_sb_info *sbi)
 {
 	int i;
 
+	cancel_work_sync(&sbi->count_work);
+	unregister_shrinker(&sbi->amap_shrinker);
+
 	for (i = 0; i < sbi->map_sectors; i++)
-		__brelse(sbi->vol_amap[i]);
+		brelse(sbi->vol_amap[i]);
 
 	kfree(sbi->vol_amap);
+	kfree(sbi->amap_ref);
 }
 
 int exfat_set_bitmap(struct inode *inode, unsigned int clu,bool sync)
@@ -146,14 +496,22 @@ int exfat_set_bitmap(struct inode *inode, unsigned int clu,bool sync)
 	unsigned int ent_idx;
 	struct super_block *sb = inode->i_sb;
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	struct buffer_head *bh;
 
 	WARN_ON(clu < EXFAT_FIRST_CLUSTER);
 	ent_idx = CLUSTER_TO_BITMAP_ENT(clu);
 	i = BITMAP_OFFSET_SECTOR_INDEX(sb, ent_idx);
 	b = BITMAP_OFFSET_BIT_IN_SECTOR(sb, ent_idx);
 
-	set_bit_le(b, sbi->vol_amap[i]->b_data);
-	exfat_update_bh( sbi->vol_amap[i], sync);
+	bh = exfat_amap_get(sb, i);
+	if (!bh)
+		return -EIO;
+
+	if (!test_and_set_bit_le(b, bh->b_data))
+		exfat_account_used(sbi, i, 1);
+	exfat_update_bh(sb, bh, sync);
+	exfat_free_ext_remove(sbi, clu);
+	exfat_pa_consume(sbi, clu);
 	return 0;
 }
 
@@ -164,14 +522,21 @@ void exfat_clear_bitmap(struct inode *inode, unsigned int clu, bool sync)
 	struct super_block *sb = inode->i_sb;
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
 	struct exfat_mount_options *opts = &sbi->options;
+	struct buffer_head *bh;
 
 	WARN_ON(clu < EXFAT_FIRST_CLUSTER);
 	ent_idx = CLUSTER_TO_BITMAP_ENT(clu);
 	i = BITMAP_OFFSET_SECTOR_INDEX(sb, ent_idx);
 	b = BITMAP_OFFSET_BIT_IN_SECTOR(sb, ent_idx);
 
-	clear_bit_le(b, sbi->vol_amap[i]->b_data);
-	exfat_update_bh(sbi->vol_amap[i], sync);
+	bh = exfat_amap_get(sb, i);
+	if (!bh)
+		return;
+
+	if (test_and_clear_bit_le(b, bh->b_data))
+		exfat_account_used(sbi, i, -1);
+	exfat_update_bh(sb, bh, sync);
+	exfat_free_ext_add(sbi, clu, 1);
 
 	if (opts->discard) {
 		int ret_discard;
@@ -188,89 +553,288 @@ void exfat_clear_bitmap(struct inode *inode, unsigned int clu, bool sync)
 }
 
 /*
- * If the value of "clu" is 0, it means cluster 2 which is the first cluster of
- * the cluster heap.
+ * Find the first entry in [start, end) of the bitmap whose bit equals @used,
+ * a word at a time. Return end if there is none. Unreadable sectors are
+ * taken as fully used.
+ */
+static unsigned int exfat_find_bitmap_ent(struct super_block *sb,
+		unsigned int start, unsigned int end, bool used)
+{
+	unsigned int bits = BITS_PER_SECTOR(sb);
+	unsigned int ent = start;
+
+	while (ent < end) {
+		unsigned int base = ent - BITMAP_OFFSET_BIT_IN_SECTOR(sb, ent);
+		unsigned int limit = min(end - base, bits);
+		struct buffer_head *bh;
+		void *map;
+		unsigned long b;
+
+		bh = exfat_amap_get(sb, BITMAP_OFFSET_SECTOR_INDEX(sb, ent));
+		if (!bh) {
+			if (used)
+				return ent;
+			ent = base + limit;
+			continue;
+		}
+
+		map = bh->b_data;
+		if (used)
+			b = find_next_bit_le(map, limit, ent - base);
+		else
+			b = find_next_zero_bit_le(map, limit, ent - base);
+		if (b < limit)
+			return base + b;
+
+		ent = base + limit;
+	}
+
+	return end;
+}
+
+/*
+ * Return the first free cluster at or after "clu", wrapping around to the
+ * start of the cluster heap.
  */
 unsigned int exfat_find_free_bitmap(struct super_block *sb, unsigned int clu)
 {
-	unsigned int i, map_i, map_b, ent_idx;
-	unsigned int clu_base, clu_free;
-	unsigned char k, clu_mask;
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	unsigned int total_ents = EXFAT_DATA_CLUSTER_COUNT(sbi);
+	unsigned int ent_idx, ent;
 
 	WARN_ON(clu < EXFAT_FIRST_CLUSTER);
 	ent_idx = CLUSTER_TO_BITMAP_ENT(clu);
-	clu_base = BITMAP_ENT_TO_CLUSTER(ent_idx & ~(BITS_PER_BYTE_MASK));
-	clu_mask = IGNORED_BITS_REMAINED(clu, clu_base);
-
-	map_i = BITMAP_OFFSET_SECTOR_INDEX(sb, ent_idx);
-	map_b = BITMAP_OFFSET_BYTE_IN_SECTOR(sb, ent_idx);
-
-	for (i = EXFAT_FIRST_CLUSTER; i < sbi->num_clusters;
-	     i += BITS_PER_BYTE) {
-		k = *(sbi->vol_amap[map_i]->b_data + map_b);
-		if (clu_mask > 0) {
-			k |= clu_mask;
-			clu_mask = 0;
-		}
-		if (k < 0xFF) {
-			clu_free = clu_base + free_bit[k];
-			if (clu_free < sbi->num_clusters)
-				return clu_free;
-		}
-		clu_base += BITS_PER_BYTE;
+	if (ent_idx >= total_ents)
+		ent_idx = 0;
 
-		if (++map_b >= sb->s_blocksize ||
-		    clu_base >= sbi->num_clusters) {
-			if (++map_i >= sbi->map_sectors) {
-				clu_base = EXFAT_FIRST_CLUSTER;
-				map_i = 0;
-			}
-			map_b = 0;
-		}
-	}
+	ent = exfat_find_bitmap_ent(sb, ent_idx, total_ents, false);
+	if (ent < total_ents)
+		return BITMAP_ENT_TO_CLUSTER(ent);
+
+	ent = exfat_find_bitmap_ent(sb, 0, ent_idx, false);
+	if (ent < ent_idx)
+		return BITMAP_ENT_TO_CLUSTER(ent);
 
 	return EXFAT_EOF_CLUSTER;
 }
 
-int exfat_count_used_clusters(struct super_block *sb, unsigned int *ret_count)
+/* Open a new window for "inode" starting at the free cluster "clu" */
+static void exfat_pa_new(struct inode *inode, unsigned int clu,
+		unsigned int num_alloc)
+{
+	struct super_block *sb = inode->i_sb;
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	struct exfat_inode_info *ei = EXFAT_I(inode), *other;
+	unsigned int ent = CLUSTER_TO_BITMAP_ENT(clu);
+	unsigned int size, end;
+
+	size = clamp_t(unsigned int, max(num_alloc, ei->pa_size),
+		       EXFAT_PA_MIN_CLUSTERS, EXFAT_PA_MAX_CLUSTERS);
+	end = min(ent + size, EXFAT_DATA_CLUSTER_COUNT(sbi));
+	end = exfat_find_bitmap_ent(sb, ent, end, true);
+
+	/* don't run into someone else's window */
+	list_for_each_entry(other, &sbi->pa_windows, pa_list) {
+		if (other != ei && other->pa_len && other->pa_start > clu &&
+		    CLUSTER_TO_BITMAP_ENT(other->pa_start) < end)
+			end = CLUSTER_TO_BITMAP_ENT(other->pa_start);
+	}
+
+	ei->pa_start = clu;
+	ei->pa_len = end - ent;
+	ei->pa_size = min(ei->pa_size * 2, (unsigned int)EXFAT_PA_MAX_CLUSTERS);
+	if (list_empty(&ei->pa_list))
+		list_add(&ei->pa_list, &sbi->pa_windows);
+}
+
+/*
+ * Step from the free cluster "clu" over other files' windows to the next
+ * free cluster nobody reserved. Only when a whole pass over the volume
+ * finds nothing but reserved clusters, the other windows are given up,
+ * as they are only a placement hint, and the search starts over.
+ */
+static unsigned int exfat_pa_skip(struct inode *inode, unsigned int clu)
+{
+	struct super_block *sb = inode->i_sb;
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	unsigned int total_ents = EXFAT_DATA_CLUSTER_COUNT(sbi);
+	struct exfat_inode_info *owner, *tmp;
+	unsigned int start = clu, next, dist = 0, step;
+
+	while ((owner = exfat_pa_owner(sbi, inode, clu))) {
+		next = exfat_find_free_bitmap(sb, owner->pa_start + owner->pa_len);
+		if (next == EXFAT_EOF_CLUSTER)
+			return next;
+
+		step = (CLUSTER_TO_BITMAP_ENT(next) + total_ents -
+			CLUSTER_TO_BITMAP_ENT(clu)) % total_ents;
+		dist += step;
+		if (!step || dist >= total_ents)
+			goto reclaim;
+		clu = next;
+	}
+
+	return clu;
+
+reclaim:
+	list_for_each_entry_safe(owner, tmp, &sbi->pa_windows, pa_list) {
+		if (&owner->vfs_inode == inode)
+			continue;
+		list_del_init(&owner->pa_list);
+		owner->pa_len = 0;
+	}
+
+	return start;
+}
+
+void exfat_discard_prealloc(struct inode *inode)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(inode->i_sb);
+	struct exfat_inode_info *ei = EXFAT_I(inode);
+
+	mutex_lock(&sbi->bitmap_lock);
+	list_del_init(&ei->pa_list);
+	ei->pa_len = 0;
+	ei->pa_size = EXFAT_PA_MIN_CLUSTERS;
+	mutex_unlock(&sbi->bitmap_lock);
+}
+
+/*
+ * Pick a free cluster for allocation: "hint_clu" itself if it is free, so
+ * that files stay contiguous, then the start of the file's own window, then
+ * a cached free extent, then the next free cluster in the bitmap. Clusters
+ * in other files' windows are skipped, see exfat_pa_skip().
+ * This function must be called with bitmap_lock held.
+ */
+unsigned int exfat_find_free_cluster(struct inode *inode,
+		unsigned int hint_clu, unsigned int num_alloc)
 {
+	struct super_block *sb = inode->i_sb;
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
-	unsigned int count = 0;
-	unsigned int i, map_i = 0, map_b = 0;
-	unsigned int total_clus = EXFAT_DATA_CLUSTER_COUNT(sbi);
-	unsigned int last_mask = total_clus & BITS_PER_BYTE_MASK;
-	unsigned char clu_bits;
-	const unsigned char last_bit_mask[] = {0, 0b00000001, 0b00000011,
-		0b00000111, 0b00001111, 0b00011111, 0b00111111, 0b01111111};
-
-	total_clus &= ~last_mask;
-	for (i = 0; i < total_clus; i += BITS_PER_BYTE) {
-		clu_bits = *(sbi->vol_amap[map_i]->b_data + map_b);
-		count += used_bit[clu_bits];
-		if (++map_b >= (unsigned int)sb->s_blocksize) {
-			map_i++;
-			map_b = 0;
+	struct exfat_inode_info *ei = EXFAT_I(inode);
+	unsigned int total_ents = EXFAT_DATA_CLUSTER_COUNT(sbi);
+	bool prealloc = S_ISREG(inode->i_mode);
+	struct buffer_head *bh;
+	unsigned int clu, ent, end;
+
+	if (hint_clu >= EXFAT_FIRST_CLUSTER && hint_clu < sbi->num_clusters) {
+		ent = CLUSTER_TO_BITMAP_ENT(hint_clu);
+		bh = exfat_amap_get(sb, BITMAP_OFFSET_SECTOR_INDEX(sb, ent));
+		if (bh && !test_bit_le(BITMAP_OFFSET_BIT_IN_SECTOR(sb, ent),
+				bh->b_data) &&
+		    !exfat_pa_owner(sbi, inode, hint_clu)) {
+			clu = hint_clu;
+			goto found;
 		}
+	} else {
+		hint_clu = EXFAT_FIRST_CLUSTER;
 	}
 
-	if (last_mask) {
-		clu_bits = *(sbi->vol_amap[map_i]->b_data + map_b);
-		clu_bits &= last_bit_mask[last_mask];
-		count += used_bit[clu_bits];
+	if (prealloc && ei->pa_len)
+		return ei->pa_start;
+
+	clu = exfat_free_ext_pick(sbi, num_alloc);
+	if (clu == EXFAT_EOF_CLUSTER || exfat_pa_owner(sbi, inode, clu)) {
+		clu = exfat_find_free_bitmap(sb, hint_clu);
+		if (clu == EXFAT_EOF_CLUSTER)
+			return clu;
+
+		/* remember the free run we landed in, up to the end of its sector */
+		ent = CLUSTER_TO_BITMAP_ENT(clu);
+		end = min(ent - BITMAP_OFFSET_BIT_IN_SECTOR(sb, ent) +
+			  (unsigned int)BITS_PER_SECTOR(sb), total_ents);
+		end = exfat_find_bitmap_ent(sb, ent, end, true);
+		exfat_free_ext_add(sbi, clu, end - ent);
 	}
 
-	*ret_count = count;
+	clu = exfat_pa_skip(inode, clu);
+	if (clu == EXFAT_EOF_CLUSTER)
+		return clu;
+
+found:
+	if (prealloc && !ei->pa_len)
+		exfat_pa_new(inode, clu, num_alloc);
+
+	return clu;
+}
+
+/*
+ *  Trim
+ *
+ *  FITRIM goes through the free clusters a window at a time under
+ *  bitmap_lock. The free runs of a window are merged into batches, each
+ *  sent as one chain of discard bios, and the window ends once
+ *  EXFAT_TRIM_DEPTH batches are in flight. All of them complete before
+ *  bitmap_lock is dropped, so that no cluster is allocated while its
+ *  discard is still pending, and then the trim yields to other tasks.
+ */
+struct exfat_trim_ctl {
+	atomic_t pending;	/* batches in flight, plus one for the window */
+	struct completion done;
+	int err;
+	struct bio *bio;	/* batch being built */
+	unsigned int batch;	/* clusters in it */
+	unsigned int nr_batches;	/* batches sent in this window */
+};
+
+static void exfat_trim_end_io(struct bio *bio)
+{
+	struct exfat_trim_ctl *tc = bio->bi_private;
+	int err = exfat_bio_errno(bio);
+
+	if (err)
+		cmpxchg(&tc->err, 0, err);
+	bio_put(bio);
+
+	if (atomic_dec_and_test(&tc->pending))
+		complete(&tc->done);
+}
+
+static void exfat_trim_submit(struct exfat_trim_ctl *tc)
+{
+	if (!tc->bio)
+		return;
+
+	tc->bio->bi_end_io = exfat_trim_end_io;
+	tc->bio->bi_private = tc;
+	atomic_inc(&tc->pending);
+	submit_bio(tc->bio);
+
+	tc->bio = NULL;
+	tc->batch = 0;
+	tc->nr_batches++;
+}
+
+/* Add a free run to the batch being built, sending it once it is full */
+static int exfat_trim_add(struct super_block *sb, struct exfat_trim_ctl *tc,
+		unsigned int clu, unsigned int count)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	unsigned int shift = sb->s_blocksize_bits - 9;
+	int err;
+
+	err = __blkdev_issue_discard(sb->s_bdev,
+			exfat_cluster_to_sector(sbi, clu) << shift,
+			((sector_t)count << sbi->sect_per_clus_bits) << shift,
+			GFP_NOFS, 0, &tc->bio);
+	if (err)
+		return err;
+
+	tc->batch += count;
+	if (tc->batch >= (1U << (EXFAT_TRIM_BATCH_BITS - sbi->cluster_size_bits)))
+		exfat_trim_submit(tc);
 	return 0;
 }
 
 int exfat_trim_fs(struct inode *inode, struct fstrim_range *range)
 {
-	unsigned int trim_begin, trim_end, count, next_free_clu;
+	unsigned int clu, trim_begin, ent, end, end_ent, count;
 	u64 clu_start, clu_end, trim_minlen, trimmed_total = 0;
 	struct super_block *sb = inode->i_sb;
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
-	int err = 0;
+	struct exfat_trim_ctl tc;
+	ktime_t start = ktime_get();
+	int runs, err = 0;
 
 	clu_start = max_t(u64, range->start >> sbi->cluster_size_bits,
 				EXFAT_FIRST_CLUSTER);
@@ -283,63 +847,66 @@ int exfat_trim_fs(struct inode *inode, struct fstrim_range *range)
 	if (clu_end >= sbi->num_clusters)
 		clu_end = sbi->num_clusters - 1;
 
-	mutex_lock(&sbi->bitmap_lock);
+	end_ent = CLUSTER_TO_BITMAP_ENT(clu_end) + 1;
+	clu = clu_start;
+	while (clu <= clu_end) {
+		mutex_lock(&sbi->bitmap_lock);
+
+		atomic_set(&tc.pending, 1);
+		init_completion(&tc.done);
+		tc.err = 0;
+		tc.bio = NULL;
+		tc.batch = 0;
+		tc.nr_batches = 0;
+
+		for (runs = 0; runs < EXFAT_TRIM_SCAN_RUNS &&
+		     tc.nr_batches < EXFAT_TRIM_DEPTH; runs++) {
+			trim_begin = exfat_find_free_bitmap(sb, clu);
+			if (trim_begin == EXFAT_EOF_CLUSTER ||
+			    trim_begin < clu || trim_begin > clu_end) {
+				/* no free cluster left in the range */
+				clu = clu_end + 1;
+				break;
+			}
 
-	trim_begin = trim_end = exfat_find_free_bitmap(sb, clu_start);
-	if (trim_begin == EXFAT_EOF_CLUSTER)
-		goto unlock;
+			/* the free run goes up to the next used cluster */
+			ent = CLUSTER_TO_BITMAP_ENT(trim_begin);
+			end = exfat_find_bitmap_ent(sb, ent, end_ent, true);
+			count = end - ent;
+			clu = BITMAP_ENT_TO_CLUSTER(end);
 
-	next_free_clu = exfat_find_free_bitmap(sb, trim_end + 1);
-	if (next_free_clu == EXFAT_EOF_CLUSTER)
-		goto unlock;
+			if (count < trim_minlen)
+				continue;
 
-	do {
-		if (next_free_clu == trim_end + 1) {
-			/* extend trim range for continuous free cluster */
-			trim_end++;
-		} else {
-			/* trim current range if it's larger than trim_minlen */
-			count = trim_end - trim_begin + 1;
-			if (count >= trim_minlen) {
-				err = sb_issue_discard(sb,
-					exfat_cluster_to_sector(sbi, trim_begin),
-					count * sbi->sect_per_clus, GFP_NOFS, 0);
-				if (err)
-					goto unlock;
-
-				trimmed_total += count;
-			}
+			err = exfat_trim_add(sb, &tc, trim_begin, count);
+			if (err)
+				break;
 
-			/* set next start point of the free hole */
-			trim_begin = trim_end = next_free_clu;
+			trimmed_total += count;
 		}
 
-		if (next_free_clu >= clu_end)
+		/* send the last batch and wait for the window */
+		exfat_trim_submit(&tc);
+		if (!atomic_dec_and_test(&tc.pending))
+			wait_for_completion(&tc.done);
+		mutex_unlock(&sbi->bitmap_lock);
+
+		if (!err)
+			err = tc.err;
+		if (err)
 			break;
 
 		if (fatal_signal_pending(current)) {
 			err = -ERESTARTSYS;
-			goto unlock;
+			break;
 		}
 
-		next_free_clu = exfat_find_free_bitmap(sb, next_free_clu + 1);
-	} while (next_free_clu != EXFAT_EOF_CLUSTER &&
-			next_free_clu > trim_end);
-
-	/* try to trim remainder */
-	count = trim_end - trim_begin + 1;
-	if (count >= trim_minlen) {
-		err = sb_issue_discard(sb, exfat_cluster_to_sector(sbi, trim_begin),
-			count * sbi->sect_per_clus, GFP_NOFS, 0);
-		if (err)
-			goto unlock;
-
-		trimmed_total += count;
+		cond_resched();
 	}
 
-unlock:
-	mutex_unlock(&sbi->bitmap_lock);
 	range->len = trimmed_total << sbi->cluster_size_bits;
+	exfat_info(sb, "trimmed %llu bytes in %lld ms", range->len,
+		   ktime_to_ms(ktime_sub(ktime_get(), start)));
 
 	return err;
 }
@@ -13,13 +13,21 @@
 #include <linux/slab.h>
 #include <asm/unaligned.h>
 #include <linux/buffer_head.h>
+#include <linux/rbtree.h>
 
 #include "exfat_fs.h"
 
-#define EXFAT_MAX_CACHE		16
+/*
+ * The cluster chain of a file is cached as a tree of extents, sorted by
+ * cluster number in the file. Extents are added as the chain is walked, so
+ * the mapping of any cluster costs a tree lookup plus a walk from the end of
+ * the nearest extent below it. Extents are only freed with the inode, so
+ * their number is capped at EXFAT_MAX_CACHE per inode.
+ */
+#define EXFAT_MAX_CACHE		512
 
 struct exfat_cache {
-	struct list_head cache_list;
+	struct rb_node rb_node;
 	unsigned int nr_contig;	/* number of contiguous clusters */
 	unsigned int fcluster;	/* cluster number in the file. */
 	unsigned int dcluster;	/* cluster number on disk. */
@@ -34,19 +42,12 @@ struct exfat_cache_id {
 
 static struct kmem_cache *exfat_cachep;
 
-static void exfat_cache_init_once(void *c)
-{
-	struct exfat_cache *cache = (struct exfat_cache *)c;
-
-	INIT_LIST_HEAD(&cache->cache_list);
-}
-
 int exfat_cache_init(void)
 {
 	exfat_cachep = kmem_cache_create("exfat_cache",
 				sizeof(struct exfat_cache),
 				0, SLAB_RECLAIM_ACCOUNT|SLAB_MEM_SPREAD,
-				exfat_cache_init_once);
+				NULL);
 	if (!exfat_cachep)
 		return -ENOMEM;
 	return 0;
@@ -66,43 +67,33 @@ static inline struct exfat_cache *exfat_cache_alloc(void)
 
 static inline void exfat_cache_free(struct exfat_cache *cache)
 {
-	WARN_ON(!list_empty(&cache->cache_list));
 	kmem_cache_free(exfat_cachep, cache);
 }
 
-static inline void exfat_cache_update_lru(struct inode *inode,
-		struct exfat_cache *cache)
-{
-	struct exfat_inode_info *ei = EXFAT_I(inode);
-
-	if (ei->cache_lru.next != &cache->cache_list)
-		list_move(&cache->cache_list, &ei->cache_lru);
-}
-
 static unsigned int exfat_cache_lookup(struct inode *inode,
 		unsigned int fclus, struct exfat_cache_id *cid,
 		unsigned int *cached_fclus, unsigned int *cached_dclus)
 {
 	struct exfat_inode_info *ei = EXFAT_I(inode);
-	static struct exfat_cache nohit = { .fcluster = 0, };
-	struct exfat_cache *hit = &nohit, *p;
+	struct rb_node *n;
+	struct exfat_cache *hit = NULL, *p;
 	unsigned int offset = EXFAT_EOF_CLUSTER;
 
-	spin_lock(&ei->cache_lru_lock);
-	list_for_each_entry(p, &ei->cache_lru, cache_list) {
-		/* Find the cache of "fclus" or nearest cache. */
-		if (p->fcluster <= fclus && hit->fcluster < p->fcluster) {
+	spin_lock(&ei->cache_lock);
+	/* Find the extent of "fclus" or the nearest one below it. */
+	n = ei->cache_tree.rb_node;
+	while (n) {
+		p = rb_entry(n, struct exfat_cache, rb_node);
+		if (p->fcluster <= fclus) {
 			hit = p;
-			if (hit->fcluster + hit->nr_contig < fclus) {
-				offset = hit->nr_contig;
-			} else {
-				offset = fclus - hit->fcluster;
-				break;
-			}
+			n = n->rb_right;
+		} else {
+			n = n->rb_left;
 		}
 	}
-	if (hit != &nohit) {
-		exfat_cache_update_lru(inode, hit);
+
+	if (hit) {
+		offset = min(fclus - hit->fcluster, hit->nr_contig);
 
 		cid->id = ei->cache_valid_id;
 		cid->nr_contig = hit->nr_contig;
@@ -111,116 +102,122 @@ static unsigned int exfat_cache_lookup(struct inode *inode,
 		*cached_fclus = cid->fcluster + offset;
 		*cached_dclus = cid->dcluster + offset;
 	}
-	spin_unlock(&ei->cache_lru_lock);
+	spin_unlock(&ei->cache_lock);
 
 	return offset;
 }
 
-static struct exfat_cache *exfat_cache_merge(struct inode *inode,
-		struct exfat_cache_id *new)
-{
-	struct exfat_inode_info *ei = EXFAT_I(inode);
-	struct exfat_cache *p;
-
-	list_for_each_entry(p, &ei->cache_lru, cache_list) {
-		/* Find the same part as "new" in cluster-chain. */
-		if (p->fcluster == new->fcluster) {
-			if (new->nr_contig > p->nr_contig)
-				p->nr_contig = new->nr_contig;
-			return p;
-		}
-	}
-	return NULL;
-}
-
 static void exfat_cache_add(struct inode *inode,
 		struct exfat_cache_id *new)
 {
 	struct exfat_inode_info *ei = EXFAT_I(inode);
-	struct exfat_cache *cache, *tmp;
+	struct exfat_cache *cache = NULL, *p;
+	struct rb_node **link, *parent;
 
 	if (new->fcluster == EXFAT_EOF_CLUSTER) /* dummy cache */
 		return;
 
-	spin_lock(&ei->cache_lru_lock);
+	spin_lock(&ei->cache_lock);
+retry:
 	if (new->id != EXFAT_CACHE_VALID &&
 	    new->id != ei->cache_valid_id)
 		goto unlock;	/* this cache was invalidated */
 
-	cache = exfat_cache_merge(inode, new);
-	if (cache == NULL) {
-		if (ei->nr_caches < EXFAT_MAX_CACHE) {
-			ei->nr_caches++;
-			spin_unlock(&ei->cache_lru_lock);
-
-			tmp = exfat_cache_alloc();
-			if (!tmp) {
-				spin_lock(&ei->cache_lru_lock);
-				ei->nr_caches--;
-				spin_unlock(&ei->cache_lru_lock);
-				return;
-			}
-
-			spin_lock(&ei->cache_lru_lock);
-			cache = exfat_cache_merge(inode, new);
-			if (cache != NULL) {
-				ei->nr_caches--;
-				exfat_cache_free(tmp);
-				goto out_update_lru;
-			}
-			cache = tmp;
+	link = &ei->cache_tree.rb_node;
+	parent = NULL;
+	while (*link) {
+		parent = *link;
+		p = rb_entry(parent, struct exfat_cache, rb_node);
+		if (new->fcluster < p->fcluster) {
+			link = &parent->rb_left;
+		} else if (new->fcluster > p->fcluster) {
+			link = &parent->rb_right;
 		} else {
-			struct list_head *p = ei->cache_lru.prev;
-
-			cache = list_entry(p,
-					struct exfat_cache, cache_list);
+			/* the same part of the chain, maybe seen further */
+			if (new->nr_contig > p->nr_contig)
+				p->nr_contig = new->nr_contig;
+			goto unlock;
 		}
+	}
+
+	if (ei->nr_caches >= EXFAT_MAX_CACHE)
+		goto unlock;	/* lookups walk from the nearest extent */
+
+	if (!cache) {
+		/* allocate only for a new extent, then look again */
+		spin_unlock(&ei->cache_lock);
+		cache = exfat_cache_alloc();
+		if (!cache)
+			return;
 		cache->fcluster = new->fcluster;
 		cache->dcluster = new->dcluster;
 		cache->nr_contig = new->nr_contig;
+		spin_lock(&ei->cache_lock);
+		goto retry;
 	}
-out_update_lru:
-	exfat_cache_update_lru(inode, cache);
+
+	rb_link_node(&cache->rb_node, parent, link);
+	rb_insert_color(&cache->rb_node, &ei->cache_tree);
+	ei->nr_caches++;
+	cache = NULL;
+
 unlock:
-	spin_unlock(&ei->cache_lru_lock);
+	spin_unlock(&ei->cache_lock);
+	if (cache)
+		exfat_cache_free(cache);
 }
 
-/*
- * Cache invalidation occurs rarely, thus the LRU chain is not updated. It
- * fixes itself after a while.
- */
-static void __exfat_cache_inval_inode(struct inode *inode)
+/* Drop the extents beyond the first "nr_clusters" clusters of the file. */
+static void __exfat_cache_truncate(struct inode *inode,
+		unsigned int nr_clusters)
 {
 	struct exfat_inode_info *ei = EXFAT_I(inode);
-	struct exfat_cache *cache;
+	struct rb_node *n = rb_last(&ei->cache_tree);
+
+	while (n) {
+		struct exfat_cache *cache =
+			rb_entry(n, struct exfat_cache, rb_node);
+
+		n = rb_prev(n);
+		if (cache->fcluster >= nr_clusters) {
+			rb_erase(&cache->rb_node, &ei->cache_tree);
+			ei->nr_caches--;
+			exfat_cache_free(cache);
+			continue;
+		}
 
-	while (!list_empty(&ei->cache_lru)) {
-		cache = list_entry(ei->cache_lru.next,
-				   struct exfat_cache, cache_list);
-		list_del_init(&cache->cache_list);
-		ei->nr_caches--;
-		exfat_cache_free(cache);
+		if (cache->fcluster + cache->nr_contig >= nr_clusters)
+			cache->nr_contig = nr_clusters - cache->fcluster - 1;
+		break;
 	}
+
 	/* Update. The copy of caches before this id is discarded. */
 	ei->cache_valid_id++;
 	if (ei->cache_valid_id == EXFAT_CACHE_VALID)
 		ei->cache_valid_id++;
 }
 
-void exfat_cache_inval_inode(struct inode *inode)
+void exfat_cache_truncate(struct inode *inode, unsigned int nr_clusters)
 {
 	struct exfat_inode_info *ei = EXFAT_I(inode);
 
-	spin_lock(&ei->cache_lru_lock);
-	__exfat_cache_inval_inode(inode);
-	spin_unlock(&ei->cache_lru_lock);
+	spin_lock(&ei->cache_lock);
+	__exfat_cache_truncate(inode, nr_clusters);
+	spin_unlock(&ei->cache_lock);
+}
+
+void exfat_cache_inval_inode(struct inode *inode)
+{
+	exfat_cache_truncate(inode, 0);
 }
 
 static inline int cache_contiguous(struct exfat_cache_id *cid,
 		unsigned int dclus)
 {
+	if (cid->dcluster + cid->nr_contig + 1 != dclus)
+		return 0;
 	cid->nr_contig++;
-	return cid->dcluster + cid->nr_contig == dclus;
+	return 1;
 }
 
 static inline void cache_init(struct exfat_cache_id *cid,
@@ -304,8 +301,11 @@ int exfat_get_cluster(struct inode *inode, unsigned int cluster,
 			break;
 		}
 
-		if (!cache_contiguous(&cid, *dclus))
+		if (!cache_contiguous(&cid, *dclus)) {
+			/* remember every fragment the walk went through */
+			exfat_cache_add(inode, &cid);
 			cache_init(&cid, *fclus, *dclus);
+		}
 	}
 
 	exfat_cache_add(inode, &cid);
@@ -45,4 +45,32 @@
 #define sb_rdonly(sb) ((sb)->s_flags & SB_RDONLY)
 #endif
 
+/* bi_error was replaced by bi_status on v4.13 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 13, 0)
+#define exfat_bio_errno(bio) blk_status_to_errno((bio)->bi_status)
+#else
+#define exfat_bio_errno(bio) ((bio)->bi_error)
+#endif
+
+/* unmap_underlying_metadata() was replaced by clean_bdev_aliases() on v4.10 */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 10, 0)
+#include <linux/buffer_head.h>
+
+static inline void clean_bdev_aliases(struct block_device *bdev,
+		sector_t block, sector_t len)
+{
+	while (len--)
+		unmap_underlying_metadata(bdev, block++);
+}
+#endif
+
+/* blkdev_issue_zeroout() takes flags instead of a discard bool since v4.12 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 12, 0)
+#define exfat_issue_zeroout(bdev, sector, nr_sects) \
+	blkdev_issue_zeroout(bdev, sector, nr_sects, GFP_NOFS, 0)
+#else
+#define exfat_issue_zeroout(bdev, sector, nr_sects) \
+	blkdev_issue_zeroout(bdev, sector, nr_sects, GFP_NOFS, false)
+#endif
+
 #endif /* _EXFAT_COMPAT_H */
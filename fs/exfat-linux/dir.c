@@ -6,9 +6,21 @@
 #include <linux/slab.h>
 #include <linux/bio.h>
 #include <linux/buffer_head.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
 
 #include "exfat_fs.h"
 
+static void exfat_dir_index_insert(struct super_block *sb,
+		struct exfat_chain *p_dir, int entry, int num_entries,
+		u16 old_hash, struct exfat_uni_name *p_uniname);
+static void exfat_dir_index_remove(struct super_block *sb,
+		struct exfat_chain *p_dir, int entry, int order,
+		int num_entries, u16 name_hash);
+static int exfat_dir_index_find(struct super_block *sb,
+		struct exfat_chain *p_dir, struct exfat_uni_name *p_uniname,
+		unsigned int type, struct exfat_hint *hint_opt);
+
 static int exfat_extract_uni_name(struct exfat_dentry *ep,
 		unsigned short *uniname)
 {
@@ -158,7 +170,7 @@ static int exfat_readdir(struct inode *inode, loff_t *cpos, struct exfat_dir_ent
 			if (!ep)
 				return -EIO;
 			dir_entry->size =
-				le64_to_cpu(ep->dentry.stream.valid_size);
+				le64_to_cpu(ep->dentry.stream.size);
 			dir_entry->entry = dentry;
 			brelse(bh);
 
@@ -324,7 +336,12 @@ int exfat_alloc_new_dir(struct inode *inode, struct exfat_chain *clu)
 	if (ret)
 		return ret;
 
-	return exfat_zeroed_cluster(inode, clu->dir);
+	ret = exfat_zeroed_cluster(inode, clu->dir);
+	if (ret)
+		return ret;
+
+	/* the new directory is zeroed before its dentry is written */
+	return exfat_meta_batch_barrier(inode->i_sb);
 }
 
 int exfat_calc_num_entries(struct exfat_uni_name *p_uniname)
@@ -472,7 +489,7 @@ int exfat_init_dir_entry(struct inode *inode, struct exfat_chain *p_dir,
 			&ep->dentry.file.access_date,
 			NULL);
 
-	exfat_update_bh(bh, IS_DIRSYNC(inode));
+	exfat_update_bh(sb, bh, IS_DIRSYNC(inode));
 	brelse(bh);
 
 	ep = exfat_get_dentry(sb, p_dir, entry + 1, &bh, &sector);
@@ -482,7 +499,7 @@ int exfat_init_dir_entry(struct inode *inode, struct exfat_chain *p_dir,
 	exfat_init_stream_entry(ep,
 		(type == TYPE_FILE) ? ALLOC_FAT_CHAIN : ALLOC_NO_FAT_CHAIN,
 		start_clu, size);
-	exfat_update_bh(bh, IS_DIRSYNC(inode));
+	exfat_update_bh(sb, bh, IS_DIRSYNC(inode));
 	brelse(bh);
 
 	return 0;
@@ -518,7 +535,7 @@ int exfat_update_dir_chksum(struct inode *inode, struct exfat_chain *p_dir,
 	}
 
 	fep->dentry.file.checksum = cpu_to_le16(chksum);
-	exfat_update_bh(fbh, IS_DIRSYNC(inode));
+	exfat_update_bh(sb, fbh, IS_DIRSYNC(inode));
 release_fbh:
 	brelse(fbh);
 	return ret;
@@ -534,22 +551,24 @@ int exfat_init_ext_entry(struct inode *inode, struct exfat_chain *p_dir,
 	struct exfat_dentry *ep;
 	struct buffer_head *bh;
 	int sync = IS_DIRSYNC(inode);
+	u16 old_hash;
 
 	ep = exfat_get_dentry(sb, p_dir, entry, &bh, &sector);
 	if (!ep)
 		return -EIO;
 
 	ep->dentry.file.num_ext = (unsigned char)(num_entries - 1);
-	exfat_update_bh(bh, sync);
+	exfat_update_bh(sb, bh, sync);
 	brelse(bh);
 
 	ep = exfat_get_dentry(sb, p_dir, entry + 1, &bh, &sector);
 	if (!ep)
 		return -EIO;
 
+	old_hash = le16_to_cpu(ep->dentry.stream.name_hash);
 	ep->dentry.stream.name_len = p_uniname->name_len;
 	ep->dentry.stream.name_hash = cpu_to_le16(p_uniname->name_hash);
-	exfat_update_bh(bh, sync);
+	exfat_update_bh(sb, bh, sync);
 	brelse(bh);
 
 	for (i = EXFAT_FIRST_CLUSTER; i < num_entries; i++) {
@@ -558,12 +577,14 @@ int exfat_init_ext_entry(struct inode *inode, struct exfat_chain *p_dir,
 			return -EIO;
 
 		exfat_init_name_entry(ep, uniname);
-		exfat_update_bh(bh, sync);
+		exfat_update_bh(sb, bh, sync);
 		brelse(bh);
 		uniname += EXFAT_FILE_NAME_LEN;
 	}
 
 	exfat_update_dir_chksum(inode, p_dir, entry);
+	exfat_dir_index_insert(sb, p_dir, entry, num_entries, old_hash,
+			p_uniname);
 	return 0;
 }
 
@@ -575,17 +596,22 @@ int exfat_remove_entries(struct inode *inode, struct exfat_chain *p_dir,
 	sector_t sector;
 	struct exfat_dentry *ep;
 	struct buffer_head *bh;
+	u16 name_hash = 0;
 
 	for (i = order; i < num_entries; i++) {
 		ep = exfat_get_dentry(sb, p_dir, entry + i, &bh, &sector);
 		if (!ep)
 			return -EIO;
 
+		if (i == 1 && exfat_get_entry_type(ep) == TYPE_STREAM)
+			name_hash = le16_to_cpu(ep->dentry.stream.name_hash);
 		exfat_set_entry_type(ep, TYPE_DELETED);
-		exfat_update_bh(bh, IS_DIRSYNC(inode));
+		exfat_update_bh(sb, bh, IS_DIRSYNC(inode));
 		brelse(bh);
 	}
 
+	exfat_dir_index_remove(sb, p_dir, entry, order, num_entries,
+			name_hash);
 	return 0;
 }
 
@@ -611,7 +637,7 @@ int exfat_free_dentry_set(struct exfat_entry_set_cache *es, int sync)
 	int i, err = 0;
 
 		if (es->modified)
-		err = exfat_update_bhs(es->bh, es->num_bh, sync);
+		err = exfat_update_bhs(es->sb, es->bh, es->num_bh, sync);
 
 	for (i = 0; i < es->num_bh; i++)
 		if (err)
@@ -927,7 +953,7 @@ int exfat_find_dir_entry(struct super_block *sb, struct exfat_inode_info *ei,
 {
 	int i, rewind = 0, dentry = 0, end_eidx = 0, num_ext = 0, len;
 	int order, step, name_len = 0;
-	int dentries_per_clu, num_empty = 0;
+	int dentries_per_clu, num_empty = 0, ret;
 	unsigned int entry_type;
 	unsigned short *uniname = NULL;
 	struct exfat_chain clu;
@@ -937,6 +963,10 @@ int exfat_find_dir_entry(struct super_block *sb, struct exfat_inode_info *ei,
 
 	dentries_per_clu = sbi->dentries_per_clu;
 
+	ret = exfat_dir_index_find(sb, p_dir, p_uniname, type, hint_opt);
+	if (ret != -EAGAIN)
+		return ret;
+
 	exfat_chain_dup(&clu, p_dir);
 
 	if (hint_stat->eidx) {
@@ -1199,3 +1229,516 @@ int exfat_count_dir_entries(struct super_block *sb, struct exfat_chain *p_dir)
 
 	return count;
 }
+
+/*
+ *  Directory Index
+ *
+ *  Large directories get an in-memory index from the name hash of each
+ *  entry set to its position, built by one scan on the first lookup. It
+ *  also remembers runs of deleted entries and where the trailing unused
+ *  entries start, so that creating a file doesn't scan either. Every
+ *  entry set is written by exfat_init_ext_entry() and deleted by
+ *  exfat_remove_entries(), which keep the index in sync. The index is keyed
+ *  by the start cluster of the directory, and is protected by s_lock.
+ *  A directory found to be small by that scan is remembered in sbi->dir_small
+ *  until enough entries are added to it, so that it isn't scanned again.
+ */
+struct exfat_dir_index_node {
+	struct hlist_node hnode;
+	int entry;
+	u16 name_hash;
+	unsigned char name_len;
+};
+
+struct exfat_dir_index {
+	struct list_head list;
+	unsigned int dir; /* start cluster of the directory */
+	int tail; /* first entry of the trailing unused entries */
+	struct exfat_free_extent holes[EXFAT_DIR_INDEX_HOLES];
+	unsigned int bits; /* sized from the number of entry sets */
+	struct hlist_head *heads;
+};
+
+static inline struct hlist_head *exfat_dir_index_head(
+		struct exfat_dir_index *idx, u16 name_hash)
+{
+	return &idx->heads[hash_min(name_hash, idx->bits)];
+}
+
+static int exfat_dir_index_add_node(struct hlist_head *head, int entry,
+		u16 name_hash, unsigned char name_len)
+{
+	struct exfat_dir_index_node *node;
+
+	node = kmalloc(sizeof(*node), GFP_NOFS);
+	if (!node)
+		return -ENOMEM;
+
+	node->entry = entry;
+	node->name_hash = name_hash;
+	node->name_len = name_len;
+	hlist_add_head(&node->hnode, head);
+	return 0;
+}
+
+static inline int exfat_dir_index_add(struct exfat_dir_index *idx, int entry,
+		u16 name_hash, unsigned char name_len)
+{
+	return exfat_dir_index_add_node(exfat_dir_index_head(idx, name_hash),
+			entry, name_hash, name_len);
+}
+
+static void exfat_dir_index_del(struct exfat_dir_index *idx, int entry,
+		u16 name_hash)
+{
+	struct exfat_dir_index_node *node;
+
+	hlist_for_each_entry(node, exfat_dir_index_head(idx, name_hash), hnode) {
+		if (node->entry == entry) {
+			hlist_del(&node->hnode);
+			kfree(node);
+			return;
+		}
+	}
+}
+
+static void exfat_dir_index_add_hole(struct exfat_dir_index *idx, int entry,
+		int count)
+{
+	struct exfat_free_extent *hole, *victim = NULL;
+	int i;
+
+	for (i = 0; i < EXFAT_DIR_INDEX_HOLES; i++) {
+		hole = &idx->holes[i];
+		if (hole->len && entry <= hole->start + hole->len &&
+		    hole->start <= entry + count) {
+			int end = max_t(int, hole->start + hole->len,
+					entry + count);
+
+			hole->start = min_t(int, hole->start, entry);
+			hole->len = end - hole->start;
+			return;
+		}
+		if (!victim || hole->len < victim->len)
+			victim = hole;
+	}
+
+	if (victim->len < count) {
+		victim->start = entry;
+		victim->len = count;
+	}
+}
+
+/* entries [entry, entry + count) are in use now */
+static void exfat_dir_index_fill_hole(struct exfat_dir_index *idx, int entry,
+		int count)
+{
+	struct exfat_free_extent *hole;
+	int i;
+
+	for (i = 0; i < EXFAT_DIR_INDEX_HOLES; i++) {
+		int end, left, right;
+
+		hole = &idx->holes[i];
+		end = hole->start + hole->len;
+		if (!hole->len || entry >= end || hole->start >= entry + count)
+			continue;
+
+		/* keep the larger remaining part */
+		left = max_t(int, entry - (int)hole->start, 0);
+		right = max_t(int, end - (entry + count), 0);
+		if (left >= right) {
+			hole->len = left;
+		} else {
+			hole->start = entry + count;
+			hole->len = right;
+		}
+	}
+}
+
+static void exfat_dir_index_free_nodes(struct hlist_head *head)
+{
+	struct exfat_dir_index_node *node;
+	struct hlist_node *tmp;
+
+	hlist_for_each_entry_safe(node, tmp, head, hnode)
+		kfree(node);
+}
+
+static void exfat_dir_index_free(struct exfat_dir_index *idx)
+{
+	int i;
+
+	if (idx->heads) {
+		for (i = 0; i < 1 << idx->bits; i++)
+			exfat_dir_index_free_nodes(&idx->heads[i]);
+		kfree(idx->heads);
+	}
+	list_del(&idx->list);
+	kfree(idx);
+}
+
+static inline struct exfat_dir_small *exfat_dir_small_slot(
+		struct exfat_sb_info *sbi, unsigned int dir)
+{
+	return &sbi->dir_small[hash_32(dir, ilog2(EXFAT_DIR_SMALL_SLOTS))];
+}
+
+/*
+ * Scan the directory and index its entry sets. Return NULL if it fails or
+ * if the directory holds fewer than EXFAT_DIR_INDEX_MIN_ENTRIES entries, in
+ * which case *used is set to the number of entries in use.
+ */
+static struct exfat_dir_index *exfat_dir_index_build(struct super_block *sb,
+		struct exfat_chain *p_dir, int *used)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	struct exfat_dir_index *idx;
+	struct exfat_dir_index_node *node;
+	struct hlist_node *tmp;
+	struct exfat_chain clu;
+	HLIST_HEAD(nodes);
+	int i, dentry = 0, file_entry = -1, hole_start = -1, nr_sets = 0;
+
+	*used = -1;
+	idx = kzalloc(sizeof(*idx), GFP_NOFS);
+	if (!idx)
+		return NULL;
+	idx->dir = p_dir->dir;
+	INIT_LIST_HEAD(&idx->list);
+	*used = 0;
+
+	exfat_chain_dup(&clu, p_dir);
+	while (clu.dir != EXFAT_EOF_CLUSTER) {
+		for (i = 0; i < sbi->dentries_per_clu; i++, dentry++) {
+			struct exfat_dentry *ep;
+			struct buffer_head *bh;
+			unsigned int type;
+			u16 name_hash = 0;
+			unsigned char name_len = 0;
+
+			ep = exfat_get_dentry(sb, &clu, i, &bh, NULL);
+			if (!ep)
+				goto free_idx;
+			type = exfat_get_entry_type(ep);
+			if (type == TYPE_STREAM) {
+				name_hash = le16_to_cpu(ep->dentry.stream.name_hash);
+				name_len = ep->dentry.stream.name_len;
+			}
+			brelse(bh);
+
+			if (type == TYPE_DELETED) {
+				if (hole_start < 0)
+					hole_start = dentry;
+				continue;
+			}
+
+			if (hole_start >= 0) {
+				exfat_dir_index_add_hole(idx, hole_start,
+						dentry - hole_start);
+				hole_start = -1;
+			}
+
+			if (type == TYPE_UNUSED)
+				goto out;
+
+			(*used)++;
+			if (type == TYPE_FILE || type == TYPE_DIR) {
+				file_entry = dentry;
+			} else if (type == TYPE_STREAM &&
+				   file_entry == dentry - 1) {
+				/* hashed once the number of sets is known */
+				if (exfat_dir_index_add_node(&nodes, file_entry,
+						name_hash, name_len))
+					goto free_idx;
+				nr_sets++;
+			}
+		}
+
+		if (clu.flags == ALLOC_NO_FAT_CHAIN) {
+			if (--clu.size > 0)
+				clu.dir++;
+			else
+				clu.dir = EXFAT_EOF_CLUSTER;
+		} else {
+			if (exfat_get_next_cluster(sb, &clu.dir))
+				goto free_idx;
+		}
+	}
+
+	if (hole_start >= 0)
+		exfat_dir_index_add_hole(idx, hole_start, dentry - hole_start);
+out:
+	idx->tail = dentry;
+	if (*used < EXFAT_DIR_INDEX_MIN_ENTRIES)
+		goto free_nodes;
+
+	idx->bits = clamp_t(unsigned int, order_base_2(nr_sets),
+			EXFAT_DIR_INDEX_MIN_BITS, EXFAT_DIR_INDEX_MAX_BITS);
+	idx->heads = kcalloc(1 << idx->bits, sizeof(*idx->heads), GFP_NOFS);
+	if (!idx->heads)
+		goto free_idx;
+
+	hlist_for_each_entry_safe(node, tmp, &nodes, hnode) {
+		hlist_del(&node->hnode);
+		hlist_add_head(&node->hnode,
+				exfat_dir_index_head(idx, node->name_hash));
+	}
+	return idx;
+
+free_idx:
+	*used = -1;
+free_nodes:
+	exfat_dir_index_free_nodes(&nodes);
+	exfat_dir_index_free(idx);
+	return NULL;
+}
+
+/*
+ * Return the index of the directory, building it for a large directory if
+ * "build" is set. NULL means the directory is to be scanned.
+ */
+static struct exfat_dir_index *exfat_dir_index_get(struct super_block *sb,
+		struct exfat_chain *p_dir, bool build)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	struct exfat_dir_index *idx;
+	struct exfat_dir_small *small;
+	int used;
+
+	list_for_each_entry(idx, &sbi->dir_indexes, list) {
+		if (idx->dir == p_dir->dir) {
+			list_move(&idx->list, &sbi->dir_indexes);
+			return idx;
+		}
+	}
+
+	/* it can't hold enough entries, don't even scan it */
+	if (!build || p_dir->dir == EXFAT_EOF_CLUSTER ||
+	    (u64)p_dir->size * sbi->dentries_per_clu <
+	    EXFAT_DIR_INDEX_MIN_ENTRIES)
+		return NULL;
+
+	small = exfat_dir_small_slot(sbi, p_dir->dir);
+	if (small->dir == p_dir->dir)
+		return NULL;
+
+	idx = exfat_dir_index_build(sb, p_dir, &used);
+	if (!idx) {
+		if (used >= 0) {
+			small->dir = p_dir->dir;
+			small->used = used;
+		}
+		return NULL;
+	}
+
+	if (sbi->nr_dir_indexes >= EXFAT_DIR_INDEX_MAX)
+		exfat_dir_index_free(list_last_entry(&sbi->dir_indexes,
+				struct exfat_dir_index, list));
+	else
+		sbi->nr_dir_indexes++;
+	list_add(&idx->list, &sbi->dir_indexes);
+	return idx;
+}
+
+void exfat_dir_index_drop(struct super_block *sb, unsigned int dir)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	struct exfat_dir_index *idx;
+	struct exfat_dir_small *small = exfat_dir_small_slot(sbi, dir);
+
+	if (small->dir == dir)
+		small->dir = 0;
+
+	list_for_each_entry(idx, &sbi->dir_indexes, list) {
+		if (idx->dir == dir) {
+			exfat_dir_index_free(idx);
+			sbi->nr_dir_indexes--;
+			return;
+		}
+	}
+}
+
+void exfat_dir_index_drop_all(struct exfat_sb_info *sbi)
+{
+	struct exfat_dir_index *idx, *tmp;
+
+	list_for_each_entry_safe(idx, tmp, &sbi->dir_indexes, list)
+		exfat_dir_index_free(idx);
+	sbi->nr_dir_indexes = 0;
+	memset(sbi->dir_small, 0, sizeof(sbi->dir_small));
+}
+
+/* Check whether the entry set at "entry" has the name p_uniname */
+static int exfat_dir_index_match(struct super_block *sb,
+		struct exfat_chain *p_dir, int entry,
+		struct exfat_uni_name *p_uniname, unsigned int type)
+{
+	struct exfat_entry_set_cache *es;
+	unsigned short *uniname = p_uniname->name;
+	unsigned short entry_uniname[16];
+	unsigned int entry_type;
+	int i, len, name_len = 0, ret = 0;
+
+	es = exfat_get_dentry_set(sb, p_dir, entry, ES_ALL_ENTRIES);
+	if (!es)
+		return -EIO;
+
+	entry_type = exfat_get_entry_type(exfat_get_dentry_cached(es, 0));
+	if (type != TYPE_ALL && type != entry_type)
+		goto out;
+
+	for (i = 2; i < es->num_entries && name_len < p_uniname->name_len;
+	     i++) {
+		struct exfat_dentry *ep = exfat_get_dentry_cached(es, i);
+
+		if (exfat_get_entry_type(ep) != TYPE_EXTEND)
+			break;
+
+		len = exfat_extract_uni_name(ep, entry_uniname);
+		if (name_len + len > p_uniname->name_len ||
+		    exfat_uniname_ncmp(sb, uniname, entry_uniname, len))
+			goto out;
+
+		uniname += len;
+		name_len += len;
+	}
+	ret = name_len == p_uniname->name_len;
+out:
+	exfat_free_dentry_set(es, false);
+	return ret;
+}
+
+/*
+ * Look p_uniname up in the index of a large directory.
+ * Return -EAGAIN if the directory has to be scanned instead.
+ */
+static int exfat_dir_index_find(struct super_block *sb,
+		struct exfat_chain *p_dir, struct exfat_uni_name *p_uniname,
+		unsigned int type, struct exfat_hint *hint_opt)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	struct exfat_dir_index *idx;
+	struct exfat_dir_index_node *node;
+	unsigned int clu;
+	int ret;
+
+	idx = exfat_dir_index_get(sb, p_dir, true);
+	if (!idx)
+		return -EAGAIN;
+
+	hlist_for_each_entry(node,
+			exfat_dir_index_head(idx, p_uniname->name_hash), hnode) {
+		if (node->name_hash != p_uniname->name_hash ||
+		    node->name_len != p_uniname->name_len)
+			continue;
+
+		ret = exfat_dir_index_match(sb, p_dir, node->entry, p_uniname,
+				type);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			continue;
+
+		if (exfat_walk_fat_chain(sb, p_dir, EXFAT_DEN_TO_B(node->entry),
+				&clu))
+			return -EIO;
+		hint_opt->clu = clu;
+		hint_opt->eidx = node->entry & (sbi->dentries_per_clu - 1);
+		return node->entry;
+	}
+
+	return -ENOENT;
+}
+
+/* An entry set of num_entries entries was written at "entry" */
+static void exfat_dir_index_insert(struct super_block *sb,
+		struct exfat_chain *p_dir, int entry, int num_entries,
+		u16 old_hash, struct exfat_uni_name *p_uniname)
+{
+	struct exfat_dir_index *idx = exfat_dir_index_get(sb, p_dir, false);
+
+	if (!idx) {
+		struct exfat_dir_small *small =
+			exfat_dir_small_slot(EXFAT_SB(sb), p_dir->dir);
+
+		/* scan it again once it may have grown large enough */
+		if (small->dir == p_dir->dir) {
+			small->used += num_entries;
+			if (small->used >= EXFAT_DIR_INDEX_MIN_ENTRIES)
+				small->dir = 0;
+		}
+		return;
+	}
+
+	/* a rename in place reuses the entry set */
+	exfat_dir_index_del(idx, entry, old_hash);
+	if (exfat_dir_index_add(idx, entry, p_uniname->name_hash,
+			p_uniname->name_len)) {
+		exfat_dir_index_drop(sb, p_dir->dir);
+		return;
+	}
+
+	exfat_dir_index_fill_hole(idx, entry, num_entries);
+	if (idx->tail < entry + num_entries)
+		idx->tail = entry + num_entries;
+}
+
+/* Entries [entry + order, entry + num_entries) were deleted */
+static void exfat_dir_index_remove(struct super_block *sb,
+		struct exfat_chain *p_dir, int entry, int order,
+		int num_entries, u16 name_hash)
+{
+	struct exfat_dir_index *idx = exfat_dir_index_get(sb, p_dir, false);
+
+	if (!idx)
+		return;
+
+	if (!order)
+		exfat_dir_index_del(idx, entry, name_hash);
+	exfat_dir_index_add_hole(idx, entry + order, num_entries - order);
+}
+
+/*
+ * Point hint_femp at a free run of num_entries entries known to the index,
+ * so that exfat_search_empty_slot() doesn't scan the directory.
+ */
+bool exfat_dir_index_empty_hint(struct super_block *sb,
+		struct exfat_chain *p_dir, int num_entries,
+		struct exfat_hint_femp *hint_femp)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	struct exfat_dir_index *idx = exfat_dir_index_get(sb, p_dir, false);
+	struct exfat_free_extent *hole, *best = NULL;
+	int i, total;
+	unsigned int clu;
+
+	if (!idx)
+		return false;
+
+	for (i = 0; i < EXFAT_DIR_INDEX_HOLES; i++) {
+		hole = &idx->holes[i];
+		if (hole->len >= num_entries && (!best || hole->len < best->len))
+			best = hole;
+	}
+
+	if (best) {
+		hint_femp->eidx = best->start;
+		hint_femp->count = best->len;
+		exfat_chain_dup(&hint_femp->cur, p_dir);
+		return true;
+	}
+
+	/* the trailing unused entries, the directory may have to grow */
+	total = p_dir->size * sbi->dentries_per_clu;
+	if (idx->tail >= total ||
+	    exfat_walk_fat_chain(sb, p_dir, EXFAT_DEN_TO_B(idx->tail), &clu))
+		return false;
+
+	hint_femp->eidx = idx->tail;
+	hint_femp->count = total - idx->tail;
+	exfat_chain_set(&hint_femp->cur, clu,
+		p_dir->size - EXFAT_B_TO_CLU(EXFAT_DEN_TO_B(idx->tail), sbi),
+		p_dir->flags);
+	return true;
+}
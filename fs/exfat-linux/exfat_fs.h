@@ -9,6 +9,7 @@
 #include <linux/fs.h>
 #include <linux/ratelimit.h>
 #include <linux/nls.h>
+#include <linux/workqueue.h>
 
 #include "config.h"
 #include "compat.h"
@@ -80,6 +81,18 @@ enum {
 #define EXFAT_HINT_NONE		-1
 #define EXFAT_MIN_SUBDIR	2
 
+/*
+ * in-memory directory index, see exfat_dir_index_find().
+ * Directories with fewer than EXFAT_DIR_INDEX_MIN_ENTRIES entries in use are
+ * just scanned, and remembered in EXFAT_DIR_SMALL_SLOTS slots as such.
+ */
+#define EXFAT_DIR_INDEX_MIN_ENTRIES	1024
+#define EXFAT_DIR_INDEX_MAX		4
+#define EXFAT_DIR_INDEX_MIN_BITS	6
+#define EXFAT_DIR_INDEX_MAX_BITS	12
+#define EXFAT_DIR_INDEX_HOLES		8
+#define EXFAT_DIR_SMALL_SLOTS		32
+
 /*
  * helpers for cluster size to byte conversion.
  */
@@ -129,7 +142,38 @@ enum {
 #define BITMAP_OFFSET_BYTE_IN_SECTOR(sb, ent) \
 	((ent / BITS_PER_BYTE) & ((sb)->s_blocksize - 1))
 #define BITS_PER_BYTE_MASK	0x7
-#define IGNORED_BITS_REMAINED(clu, clu_base) ((1 << ((clu) - (clu_base))) - 1)
+
+/* the allocation bitmap is read in and released 128KB at a time */
+#define EXFAT_AMAP_CHUNK_BITS	17
+
+/*
+ * FITRIM sends discards in batches of up to 32MB, with up to 8 batches in
+ * flight, and goes through at most 1024 free runs per hold of bitmap_lock
+ */
+#define EXFAT_TRIM_BATCH_BITS	25
+#define EXFAT_TRIM_DEPTH	8
+#define EXFAT_TRIM_SCAN_RUNS	1024
+
+/* number of free extents remembered for allocation */
+#define EXFAT_FREE_EXTENTS	8
+
+/* metadata buffers queued by a write-combining batch before it is flushed */
+#define EXFAT_META_BATCH	32
+
+/* bounds of the per-inode preallocation window, in clusters */
+#define EXFAT_PA_MIN_CLUSTERS	16
+#define EXFAT_PA_MAX_CLUSTERS	2048
+
+struct exfat_free_extent {
+	unsigned int start; /* first free cluster */
+	unsigned int len; /* 0 if the slot is unused */
+};
+
+/* a directory too small to be indexed */
+struct exfat_dir_small {
+	unsigned int dir; /* start cluster, 0 if the slot is unused */
+	int used; /* entries in use when it was scanned, plus those added */
+};
 
 struct exfat_dentry_namebuf {
 	char *lfn;
@@ -187,6 +231,7 @@ struct exfat_dir_entry {
 	unsigned char flags;
 	unsigned short attr;
 	loff_t size;
+	loff_t valid_size;
 	unsigned int num_subdirs;
 	struct timespec64 atime;
 	struct timespec64 mtime;
@@ -235,16 +280,43 @@ struct exfat_sb_info {
 	unsigned int vol_flags_persistent; /* volume flags to retain */
 	struct buffer_head *boot_bh; /* buffer_head of BOOT sector */
 
+	struct super_block *sb; /* back pointer for the bitmap helpers */
 	unsigned int map_clu; /* allocation bitmap start cluster */
 	unsigned int map_sectors; /* num of allocation bitmap sectors */
-	struct buffer_head **vol_amap; /* allocation bitmap */
+	struct buffer_head **vol_amap; /* allocation bitmap, see exfat_amap_get() */
+	unsigned int amap_chunk_bits; /* log2 of bitmap sectors per chunk */
+	unsigned int amap_chunks; /* num of bitmap chunks */
+	unsigned int amap_loaded; /* num of chunks held in vol_amap */
+	unsigned int amap_scan; /* next chunk the shrinker looks at */
+	unsigned long *amap_ref; /* chunks used since the last shrink */
+	struct shrinker amap_shrinker;
 
 	unsigned short *vol_utbl; /* upcase table */
 
 	unsigned int clu_srch_ptr; /* cluster search pointer */
+	/* known free extents, protected by bitmap_lock */
+	struct exfat_free_extent free_ext[EXFAT_FREE_EXTENTS];
+	/* inodes holding a preallocation window, protected by bitmap_lock */
+	struct list_head pa_windows;
+	/* directory indexes, most recently used first, protected by s_lock */
+	struct list_head dir_indexes;
+	int nr_dir_indexes;
+	struct exfat_dir_small dir_small[EXFAT_DIR_SMALL_SLOTS];
 	unsigned int used_clusters; /* number of used clusters */
+	/* mount time count of used clusters, see exfat_count_used_work() */
+	struct work_struct count_work;
+	unsigned int scan_used; /* used clusters in the counted sectors */
+	unsigned int scan_sectors; /* bitmap sectors counted so far */
 
 	struct mutex s_lock; /* superblock lock */
+	/* metadata write combining, see exfat_meta_batch_start() */
+	struct buffer_head *meta_bhs[EXFAT_META_BATCH];
+	int meta_nr;
+	int meta_depth;
+	struct task_struct *meta_owner;
+	int meta_err;
+	unsigned long meta_writes; /* synchronous metadata writes issued */
+	unsigned long meta_merged; /* synchronous updates merged in a batch */
 	struct mutex bitmap_lock; /* bitmap lock */
 	struct exfat_mount_options options;
 	struct nls_table *nls_io; /* Charset used for input and display */
@@ -281,19 +353,35 @@ struct exfat_inode_info {
 	/* hint for first empty entry */
 	struct exfat_hint_femp hint_femp;
 
-	spinlock_t cache_lru_lock;
-	struct list_head cache_lru;
+	/* extents of the cluster chain, see cache.c */
+	spinlock_t cache_lock;
+	struct rb_root cache_tree;
 	int nr_caches;
 	/* for avoiding the race between alloc and free */
 	unsigned int cache_valid_id;
 
+	/*
+	 * in-memory preallocation window: free clusters other files don't
+	 * allocate from, so that this one grows contiguously. Protected by
+	 * sbi->bitmap_lock.
+	 */
+	struct list_head pa_list;
+	unsigned int pa_start;
+	unsigned int pa_len;
+	unsigned int pa_size; /* size of the next window */
+
 	/*
 	 * NOTE: i_size_ondisk is 64bits, so must hold ->inode_lock to access.
 	 * physically allocated size.
 	 */
 	loff_t i_size_ondisk;
-	/* block-aligned i_size (used in cont_write_begin) */
+	/* block-aligned i_size */
 	loff_t i_size_aligned;
+	/*
+	 * bytes that have been written (used in cont_write_begin). Blocks past
+	 * it are allocated but read as zeroes, see exfat_get_block().
+	 */
+	loff_t valid_size;
 	/* on-disk position of directory entry or 0 */
 	loff_t i_pos;
 	/* hash by i_location */
@@ -417,7 +505,11 @@ void exfat_free_bitmap(struct exfat_sb_info *sbi);
 int exfat_set_bitmap(struct inode *inode, unsigned int clu, bool sync);
 void exfat_clear_bitmap(struct inode *inode, unsigned int clu, bool sync);
 unsigned int exfat_find_free_bitmap(struct super_block *sb, unsigned int clu);
-int exfat_count_used_clusters(struct super_block *sb, unsigned int *ret_count);
+unsigned int exfat_find_free_cluster(struct inode *inode,
+		unsigned int hint_clu, unsigned int num_alloc);
+void exfat_discard_prealloc(struct inode *inode);
+void exfat_count_used_work(struct work_struct *work);
+void exfat_start_count_used(struct super_block *sb);
 int exfat_trim_fs(struct inode *inode, struct fstrim_range *range);
 
 /* file.c */
@@ -446,6 +538,7 @@ extern const struct dentry_operations exfat_utf8_dentry_ops;
 int exfat_cache_init(void);
 void exfat_cache_shutdown(void);
 void exfat_cache_inval_inode(struct inode *inode);
+void exfat_cache_truncate(struct inode *inode, unsigned int nr_clusters);
 int exfat_get_cluster(struct inode *inode, unsigned int cluster,
 		unsigned int *fclus, unsigned int *dclus,
 		unsigned int *last_dclus, int allow_eof);
@@ -480,6 +573,11 @@ struct exfat_entry_set_cache *exfat_get_dentry_set(struct super_block *sb,
 		struct exfat_chain *p_dir, int entry, unsigned int type);
 int exfat_free_dentry_set(struct exfat_entry_set_cache *es, int sync);
 int exfat_count_dir_entries(struct super_block *sb, struct exfat_chain *p_dir);
+bool exfat_dir_index_empty_hint(struct super_block *sb,
+		struct exfat_chain *p_dir, int num_entries,
+		struct exfat_hint_femp *hint_femp);
+void exfat_dir_index_drop(struct super_block *sb, unsigned int dir);
+void exfat_dir_index_drop_all(struct exfat_sb_info *sbi);
 
 /* inode.c */
 extern const struct inode_operations exfat_file_inode_operations;
@@ -541,8 +639,12 @@ void exfat_set_entry_time(struct exfat_sb_info *sbi, struct timespec64 *ts,
 		u8 *tz, __le16 *time, __le16 *date, u8 *time_cs);
 u16 exfat_calc_chksum16(void *data, int len, u16 chksum, int type);
 u32 exfat_calc_chksum32(void *data, int len, u32 chksum, int type);
-void exfat_update_bh(struct    buffer_head *bh, int sync);
-int exfat_update_bhs(struct buffer_head **bhs, int nr_bhs, int sync);
+void exfat_meta_batch_start(struct super_block *sb);
+int exfat_meta_batch_barrier(struct super_block *sb);
+int exfat_meta_batch_end(struct super_block *sb);
+int exfat_update_bh(struct super_block *sb, struct buffer_head *bh, int sync);
+int exfat_update_bhs(struct super_block *sb, struct buffer_head **bhs,
+		int nr_bhs, int sync);
 void exfat_chain_set(struct exfat_chain *ec, unsigned int dir,
 		unsigned int size, unsigned char flags);
 void exfat_chain_dup(struct exfat_chain *dup, struct exfat_chain *ec);
@@ -23,10 +23,7 @@ static int exfat_mirror_bh(struct super_block *sb, sector_t sec,
 		if (!c_bh)
 			return -ENOMEM;
 		memcpy(c_bh->b_data, bh->b_data, sb->s_blocksize);
-		set_buffer_uptodate(c_bh);
-		mark_buffer_dirty(c_bh);
-		if (sb->s_flags & SB_SYNCHRONOUS)
-			err = sync_dirty_buffer(c_bh);
+		err = exfat_update_bh(sb, c_bh, sb->s_flags & SB_SYNCHRONOUS);
 		brelse(c_bh);
 	}
 
@@ -74,7 +71,7 @@ int exfat_ent_set(struct super_block *sb, unsigned int loc,
 
 	fat_entry = (__le32 *)&(bh->b_data[off]);
 	*fat_entry = cpu_to_le32(content);
-	exfat_update_bh( bh, sb->s_flags & SB_SYNCHRONOUS);
+	exfat_update_bh(sb, bh, sb->s_flags & SB_SYNCHRONOUS);
 	exfat_mirror_bh(sb, sec, bh);
 	brelse(bh);
 	return 0;
@@ -221,12 +218,10 @@ static int __exfat_free_cluster(struct inode *inode, struct exfat_chain *p_chain
 			num_clusters++;
 
 			if (err)
-				goto dec_used_clus;
+				break;
 		} while (clu != EXFAT_EOF_CLUSTER);
 	}
 
-dec_used_clus:
-	sbi->used_clusters -= num_clusters;
 	return 0;
 }
 
@@ -234,6 +229,9 @@ int exfat_free_cluster(struct inode *inode, struct exfat_chain *p_chain)
 {
 	int ret = 0;
 
+	/* a removed directory's index must not outlive its clusters */
+	exfat_dir_index_drop(inode->i_sb, p_chain->dir);
+
 	mutex_lock(&EXFAT_SB(inode->i_sb)->bitmap_lock);
 	ret = __exfat_free_cluster(inode, p_chain);
 	mutex_unlock(&EXFAT_SB(inode->i_sb)->bitmap_lock);
@@ -302,7 +300,7 @@ int exfat_zeroed_cluster(struct inode *dir, unsigned int clu)
 		memset(bhs[n]->b_data, 0, sb->s_blocksize);
 	}
 
-		err = exfat_update_bhs(bhs, n, IS_DIRSYNC(dir));
+		err = exfat_update_bhs(sb, bhs, n, IS_DIRSYNC(dir));
 		if (err)
 			goto release_bhs;
 
@@ -329,17 +327,21 @@ int exfat_alloc_cluster(struct inode *inode, unsigned int num_alloc,
 
 	total_cnt = EXFAT_DATA_CLUSTER_COUNT(sbi);
 
-	if (unlikely(total_cnt < sbi->used_clusters)) {
-		exfat_fs_error_ratelimit(sb,
-			"%s: invalid used clusters(t:%u,u:%u)\n",
-			__func__, total_cnt, sbi->used_clusters);
-		return -EIO;
-	}
+	mutex_lock(&sbi->bitmap_lock);
 
-	if (num_alloc > total_cnt - sbi->used_clusters)
-		return -ENOSPC;
+	/* until the mount time count completes, the bitmap search decides */
+	if (sbi->used_clusters != EXFAT_CLUSTERS_UNTRACKED) {
+		if (unlikely(total_cnt < sbi->used_clusters)) {
+			exfat_fs_error_ratelimit(sb,
+				"%s: invalid used clusters(t:%u,u:%u)\n",
+				__func__, total_cnt, sbi->used_clusters);
+			ret = -EIO;
+			goto unlock;
+		}
 
-	mutex_lock(&sbi->bitmap_lock);
+		if (num_alloc > total_cnt - sbi->used_clusters)
+			goto unlock;
+	}
 
 	hint_clu = p_chain->dir;
 	/* find new cluster */
@@ -350,7 +352,8 @@ int exfat_alloc_cluster(struct inode *inode, unsigned int num_alloc,
 			sbi->clu_srch_ptr = EXFAT_FIRST_CLUSTER;
 		}
 
-		hint_clu = exfat_find_free_bitmap(sb, sbi->clu_srch_ptr);
+		hint_clu = exfat_find_free_cluster(inode, sbi->clu_srch_ptr,
+				num_alloc);
 		if (hint_clu == EXFAT_EOF_CLUSTER) {
 			ret = -ENOSPC;
 			goto unlock;
@@ -374,7 +377,7 @@ int exfat_alloc_cluster(struct inode *inode, unsigned int num_alloc,
 
 	p_chain->dir = EXFAT_EOF_CLUSTER;
 
-	while ((new_clu = exfat_find_free_bitmap(sb, hint_clu)) !=
+	while ((new_clu = exfat_find_free_cluster(inode, hint_clu, num_alloc)) !=
 	       EXFAT_EOF_CLUSTER) {
 		if (new_clu != hint_clu &&
 		    p_chain->flags == ALLOC_NO_FAT_CHAIN) {
@@ -413,8 +416,10 @@ int exfat_alloc_cluster(struct inode *inode, unsigned int num_alloc,
 		last_clu = new_clu;
 
 		if (--num_alloc == 0) {
-			sbi->clu_srch_ptr = hint_clu;
-			sbi->used_clusters += num_clusters;
+			/* next allocation continues right after this one */
+			sbi->clu_srch_ptr = new_clu + 1;
+			if (sbi->clu_srch_ptr >= sbi->num_clusters)
+				sbi->clu_srch_ptr = EXFAT_FIRST_CLUSTER;
 
 			p_chain->size += num_clusters;
 			mutex_unlock(&sbi->bitmap_lock);
@@ -11,33 +11,122 @@
 
 #include "exfat_fs.h"
 
+/*
+ * Grow the file to @size by allocating its clusters only. The new range is
+ * past valid_size, so it reads as zeroes and is zeroed lazily by
+ * exfat_get_block() if a later write skips over part of it.
+ */
 static int exfat_cont_expand(struct inode *inode, loff_t size)
 {
-	struct address_space *mapping = inode->i_mapping;
-	loff_t start = i_size_read(inode), count = size - i_size_read(inode);
-	int err, err2;
+	struct super_block *sb = inode->i_sb;
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	struct exfat_inode_info *ei = EXFAT_I(inode);
+	unsigned int num_clusters = 0, new_num_clusters, last_clu;
+	loff_t old_size = i_size_read(inode);
+	struct exfat_chain clu;
+	int err;
 
-	err = generic_cont_expand_simple(inode, size);
+	err = inode_newsize_ok(inode, size);
 	if (err)
 		return err;
 
+	/* the tail of the old last block must not read back as data */
+	err = exfat_block_truncate_page(inode, old_size);
+	if (err)
+		return err;
+
+	mutex_lock(&sbi->s_lock);
+	exfat_set_volume_dirty(sb);
+
+	if (ei->i_size_ondisk > 0)
+		num_clusters = EXFAT_B_TO_CLU_ROUND_UP(ei->i_size_ondisk, sbi);
+	new_num_clusters = EXFAT_B_TO_CLU_ROUND_UP(size, sbi);
+
+	if (new_num_clusters > num_clusters) {
+		if (num_clusters) {
+			exfat_chain_set(&clu, ei->start_clu, num_clusters,
+					ei->flags);
+			err = exfat_find_last_cluster(sb, &clu, &last_clu);
+			if (err)
+				goto unlock;
+			clu.dir = last_clu + 1;
+		} else {
+			last_clu = EXFAT_EOF_CLUSTER;
+			clu.dir = EXFAT_EOF_CLUSTER;
+		}
+		clu.size = 0;
+		clu.flags = ei->flags;
+
+		/* one request, so that the allocator can keep it contiguous */
+		err = exfat_alloc_cluster(inode, new_num_clusters - num_clusters,
+				&clu, inode_needs_sync(inode));
+		if (err)
+			goto unlock;
+
+		/* append to the FAT chain */
+		if (num_clusters) {
+			if (clu.flags != ei->flags &&
+			    exfat_chain_cont_cluster(sb, ei->start_clu,
+					num_clusters))
+				goto free_clu;
+			if (clu.flags == ALLOC_FAT_CHAIN &&
+			    exfat_ent_set(sb, last_clu, clu.dir))
+				goto free_clu;
+		} else {
+			ei->start_clu = clu.dir;
+		}
+		ei->flags = clu.flags;
+
+		inode->i_blocks += (blkcnt_t)(new_num_clusters - num_clusters) <<
+			sbi->sect_per_clus_bits;
+	}
+
+	/* the expanded range isn't zeroed, so valid_size stays behind */
+	if (ei->valid_size > old_size)
+		ei->valid_size = old_size;
+	i_size_write(inode, size);
+	ei->i_size_aligned = max(ei->i_size_aligned,
+			round_up(size, (loff_t)sb->s_blocksize));
+	ei->i_size_ondisk = max(ei->i_size_ondisk, ei->i_size_aligned);
+	ei->attr |= ATTR_ARCHIVE;
+
+	if (ei->dir.dir != DIR_DELETED) {
+		struct exfat_dentry *ep2;
+		struct exfat_entry_set_cache *es;
+
+		es = exfat_get_dentry_set(sb, &(ei->dir), ei->entry,
+				ES_ALL_ENTRIES);
+		if (!es) {
+			err = -EIO;
+			goto unlock;
+		}
+		ep2 = exfat_get_dentry_cached(es, 1);
+
+		ep2->dentry.stream.flags = ei->flags;
+		ep2->dentry.stream.start_clu = cpu_to_le32(ei->start_clu);
+		ep2->dentry.stream.valid_size = cpu_to_le64(ei->valid_size);
+		ep2->dentry.stream.size = cpu_to_le64(size);
+
+		exfat_update_dir_chksum_with_entry_set(es);
+		err = exfat_free_dentry_set(es, inode_needs_sync(inode));
+		if (err)
+			goto unlock;
+	}
+	mutex_unlock(&sbi->s_lock);
+
 	inode->i_ctime = inode->i_mtime = current_time(inode);
 	mark_inode_dirty(inode);
 
-	if (!IS_SYNC(inode))
-		return 0;
-
-	err = filemap_fdatawrite_range(mapping, start, start + count - 1);
-	err2 = sync_mapping_buffers(mapping);
-	if (!err)
-		err = err2;
-	err2 = write_inode_now(inode, 1);
-	if (!err)
-		err = err2;
-	if (err)
-		return err;
+	if (IS_SYNC(inode))
+		return write_inode_now(inode, 1);
+	return 0;
 
-	return filemap_fdatawait_range(mapping, start, start + count - 1);
+free_clu:
+	exfat_free_cluster(inode, &clu);
+	err = -EIO;
+unlock:
+	mutex_unlock(&sbi->s_lock);
+	return err;
 }
 
 static bool exfat_allow_set_time(struct exfat_sb_info *sbi, struct inode *inode)
@@ -145,6 +234,8 @@ int __exfat_truncate(struct inode *inode, loff_t new_size)
 	}
 
 	i_size_write(inode, new_size);
+	if (ei->valid_size > new_size)
+		ei->valid_size = new_size;
 
 	if (ei->type == TYPE_FILE)
 		ei->attr |= ATTR_ARCHIVE;
@@ -176,8 +267,9 @@ int __exfat_truncate(struct inode *inode, loff_t new_size)
 			ep2->dentry.stream.valid_size = 0;
 			ep2->dentry.stream.size = 0;
 		} else {
-			ep2->dentry.stream.valid_size = cpu_to_le64(new_size);
-			ep2->dentry.stream.size = ep2->dentry.stream.valid_size;
+			ep2->dentry.stream.valid_size =
+				cpu_to_le64(ei->valid_size);
+			ep2->dentry.stream.size = cpu_to_le64(new_size);
 		}
 
 		if (new_size == 0) {
@@ -202,8 +294,9 @@ int __exfat_truncate(struct inode *inode, loff_t new_size)
 	}
 
 	/* invalidate cache and free the clusters */
-	/* clear exfat cache */
-	exfat_cache_inval_inode(inode);
+	/* trim exfat cache to the clusters that are kept */
+	exfat_cache_truncate(inode, new_size > 0 ?
+			min(num_clusters_new, num_clusters_phys) : 0);
 
 	/* hint information */
 	ei->hint_bmap.off = EXFAT_EOF_CLUSTER;
@@ -240,6 +333,9 @@ void exfat_truncate(struct inode *inode, loff_t size)
 		goto write_size;
 	}
 
+	/* the window no longer follows the end of the file */
+	exfat_discard_prealloc(inode);
+
 	err = __exfat_truncate(inode, i_size_read(inode));
 	if (err)
 		goto write_size;
@@ -436,6 +532,36 @@ int exfat_file_fsync(struct file *filp, loff_t start, loff_t end, int datasync)
 	return blkdev_issue_flush(inode->i_sb->s_bdev,GFP_KERNEL, NULL);
 }
 
+/*
+ * Only plain allocation is supported: exFAT ties the cluster count to
+ * DataLength, so there are neither clusters past EOF (FALLOC_FL_KEEP_SIZE)
+ * nor holes to punch.
+ */
+static long exfat_fallocate(struct file *file, int mode, loff_t offset,
+		loff_t len)
+{
+	struct inode *inode = file_inode(file);
+	int err = 0;
+
+	if (mode)
+		return -EOPNOTSUPP;
+
+	inode_lock(inode);
+	if (offset + len > i_size_read(inode))
+		err = exfat_cont_expand(inode, offset + len);
+	inode_unlock(inode);
+
+	return err;
+}
+
+static int exfat_file_release(struct inode *inode, struct file *filp)
+{
+	/* give the rest of the preallocation window back to other files */
+	if (filp->f_mode & FMODE_WRITE)
+		exfat_discard_prealloc(inode);
+	return 0;
+}
+
 const struct file_operations exfat_file_operations = {
 	.llseek		= generic_file_llseek,
 	.read_iter	= generic_file_read_iter,
@@ -446,6 +572,8 @@ const struct file_operations exfat_file_operations = {
 #endif
 	.mmap		= generic_file_mmap,
 	.fsync		= exfat_file_fsync,
+	.fallocate	= exfat_fallocate,
+	.release	= exfat_file_release,
 	.splice_read	= generic_file_splice_read,
 	.splice_write	= iter_file_splice_write,
 };
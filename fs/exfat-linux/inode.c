@@ -71,8 +71,9 @@ static int __exfat_write_inode(struct inode *inode, int sync)
 	if (ei->start_clu == EXFAT_EOF_CLUSTER)
 		on_disk_size = 0;
 
-	ep2->dentry.stream.valid_size = cpu_to_le64(on_disk_size);
-	ep2->dentry.stream.size = ep2->dentry.stream.valid_size;
+	ep2->dentry.stream.valid_size = cpu_to_le64(min_t(loff_t,
+				ei->valid_size, on_disk_size));
+	ep2->dentry.stream.size = cpu_to_le64(on_disk_size);
 
 	exfat_update_dir_chksum_with_entry_set(es);
 	return exfat_free_dentry_set(es, sync);
@@ -232,9 +233,10 @@ static int exfat_map_cluster(struct inode *inode, unsigned int clu_offset,
 			ep->dentry.stream.start_clu =
 				cpu_to_le32(ei->start_clu);
 			ep->dentry.stream.valid_size =
-				cpu_to_le64(i_size_read(inode));
+				cpu_to_le64(min_t(loff_t, ei->valid_size,
+					i_size_read(inode)));
 			ep->dentry.stream.size =
-				ep->dentry.stream.valid_size;
+				cpu_to_le64(i_size_read(inode));
 
 			exfat_update_dir_chksum_with_entry_set(es);
 			err = exfat_free_dentry_set(es, inode_needs_sync(inode));
@@ -271,6 +273,93 @@ static int exfat_map_cluster(struct inode *inode, unsigned int clu_offset,
 	return 0;
 }
 
+/*
+ * Count how many clusters right after "clu", the clu_offset-th cluster of
+ * the file, are physically contiguous with it, up to max_clu. Only clusters
+ * that are already allocated to the file are considered.
+ */
+static int exfat_count_contig_clusters(struct inode *inode,
+		unsigned int clu_offset, unsigned int clu, unsigned int max_clu,
+		unsigned int *ret_count)
+{
+	struct super_block *sb = inode->i_sb;
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	struct exfat_inode_info *ei = EXFAT_I(inode);
+	unsigned int num_clusters = 0, count = 0, next;
+
+	if (ei->i_size_ondisk > 0)
+		num_clusters = EXFAT_B_TO_CLU_ROUND_UP(ei->i_size_ondisk, sbi);
+
+	if (clu_offset + 1 < num_clusters)
+		max_clu = min(max_clu, num_clusters - clu_offset - 1);
+	else
+		max_clu = 0;
+
+	if (ei->flags == ALLOC_NO_FAT_CHAIN) {
+		*ret_count = max_clu;
+		return 0;
+	}
+
+	while (count < max_clu) {
+		if (exfat_ent_get(sb, clu, &next))
+			return -EIO;
+		if (next != clu + 1)
+			break;
+		clu = next;
+		count++;
+	}
+
+	*ret_count = count;
+	return 0;
+}
+
+/*
+ * Zero the blocks [start, end) of the file on disk. They lie between
+ * valid_size and a block that is about to be written, and would otherwise
+ * expose whatever the clusters held before they were allocated.
+ */
+static int exfat_zero_blocks(struct inode *inode, sector_t start,
+		sector_t end)
+{
+	struct super_block *sb = inode->i_sb;
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	unsigned int clu_offset, cluster, more_clu, want_clu;
+	sector_t phys, nr;
+	int err;
+
+	while (start < end) {
+		clu_offset = start >> sbi->sect_per_clus_bits;
+		err = exfat_map_cluster(inode, clu_offset, &cluster, 0);
+		if (err)
+			return err;
+		if (cluster == EXFAT_EOF_CLUSTER)
+			return -EIO;
+
+		want_clu = EXFAT_B_TO_CLU_ROUND_UP(EXFAT_BLK_TO_B(end - start,
+				sb), sbi);
+		err = exfat_count_contig_clusters(inode, clu_offset, cluster,
+				want_clu, &more_clu);
+		if (err)
+			return err;
+
+		nr = start & (sbi->sect_per_clus - 1);
+		phys = exfat_cluster_to_sector(sbi, cluster) + nr;
+		nr = ((sector_t)(more_clu + 1) << sbi->sect_per_clus_bits) - nr;
+		nr = min(nr, end - start);
+
+		clean_bdev_aliases(sb->s_bdev, phys, nr);
+		err = exfat_issue_zeroout(sb->s_bdev,
+				phys << (sb->s_blocksize_bits - 9),
+				nr << (sb->s_blocksize_bits - 9));
+		if (err)
+			return err;
+
+		start += nr;
+	}
+
+	return 0;
+}
+
 static int exfat_map_new_buffer(struct exfat_inode_info *ei,
 		struct buffer_head *bh, loff_t pos)
 {
@@ -296,13 +385,20 @@ static int exfat_get_block(struct inode *inode, sector_t iblock,
 	int err = 0;
 	unsigned long mapped_blocks = 0;
 	unsigned int cluster, sec_offset;
-	sector_t last_block;
+	sector_t last_block, valid_blks, written_blks;
 	sector_t phys = 0;
-	loff_t pos;
+	loff_t pos, valid_end;
 
 	mutex_lock(&sbi->s_lock);
 	last_block = EXFAT_B_TO_BLK_ROUND_UP(i_size_read(inode), sb);
-	if (iblock >= last_block && !create)
+	valid_blks = EXFAT_B_TO_BLK_ROUND_UP(ei->valid_size, sb);
+	written_blks = min(last_block, valid_blks);
+
+	/*
+	 * Blocks past valid_size were never written: leave them unmapped so
+	 * that they read as zeroes without touching the disk.
+	 */
+	if (iblock >= written_blks && !create)
 		goto done;
 
 	/* Is this block already allocated? */
@@ -324,12 +420,38 @@ static int exfat_get_block(struct inode *inode, sector_t iblock,
 
 	phys = exfat_cluster_to_sector(sbi, cluster) + sec_offset;
 	mapped_blocks = sbi->sect_per_clus - sec_offset;
-	max_blocks = min(mapped_blocks, max_blocks);
 
-	/* Treat newly added block / cluster */
-	if (iblock < last_block)
+	/* Treat newly added or not yet written block / cluster */
+	if (iblock < written_blks)
 		create = 0;
 
+	/*
+	 * Map the whole contiguous run of allocated clusters at once, so that
+	 * mpage and direct I/O don't come back for every cluster.
+	 */
+	if (!create && min_t(sector_t, max_blocks, written_blks - iblock) >
+			mapped_blocks) {
+		unsigned int want_clu, more_clu;
+
+		want_clu = EXFAT_B_TO_CLU_ROUND_UP(EXFAT_BLK_TO_B(
+				min_t(sector_t, max_blocks, written_blks - iblock) -
+				mapped_blocks, sb), sbi);
+		err = exfat_count_contig_clusters(inode,
+				iblock >> sbi->sect_per_clus_bits, cluster,
+				want_clu, &more_clu);
+		if (err)
+			goto unlock_ret;
+
+		mapped_blocks += (unsigned long)more_clu <<
+			sbi->sect_per_clus_bits;
+	}
+	max_blocks = min(mapped_blocks, max_blocks);
+
+	/* the rest of the cluster may not have been written yet */
+	if (!create)
+		max_blocks = min_t(sector_t, max_blocks,
+				written_blks - iblock);
+
 	if (create || buffer_delay(bh_result)) {
 		pos = EXFAT_BLK_TO_B((iblock + 1), sb);
 		if (ei->i_size_ondisk < pos)
@@ -337,6 +459,18 @@ static int exfat_get_block(struct inode *inode, sector_t iblock,
 	}
 
 	if (create) {
+		/* zero lazily, only what this write would otherwise expose */
+		if (iblock > valid_blks) {
+			err = exfat_zero_blocks(inode, valid_blks, iblock);
+			if (err)
+				goto unlock_ret;
+		}
+		valid_end = EXFAT_BLK_TO_B(iblock + max_blocks, sb);
+		if (ei->valid_size < valid_end) {
+			ei->valid_size = valid_end;
+			mark_inode_dirty(inode);
+		}
+
 		err = exfat_map_new_buffer(ei, bh_result, pos);
 		if (err) {
 			exfat_fs_error(sb,
@@ -397,7 +531,7 @@ static int exfat_write_begin(struct file *file, struct address_space *mapping,
 	*pagep = NULL;
 	ret = cont_write_begin(file, mapping, pos, len, flags, pagep, fsdata,
 			       exfat_get_block,
-			       &EXFAT_I(mapping->host)->i_size_ondisk);
+			       &EXFAT_I(mapping->host)->valid_size);
 
 	if (ret < 0)
 		exfat_write_failed(mapping, pos+len);
@@ -405,14 +539,43 @@ static int exfat_write_begin(struct file *file, struct address_space *mapping,
 	return ret;
 }
 
+/*
+ * __block_write_begin() zeroes the new blocks of the page that the write
+ * doesn't cover in memory only. exfat_get_block() has already moved
+ * valid_size past them, so they have to reach the disk too.
+ */
+static void exfat_dirty_new_buffers(struct page *page, unsigned int from,
+		unsigned int to)
+{
+	struct buffer_head *bh, *head;
+	unsigned int block_start = 0, block_end;
+
+	if (!page_has_buffers(page))
+		return;
+
+	bh = head = page_buffers(page);
+	do {
+		block_end = block_start + bh->b_size;
+		if (buffer_new(bh) && !buffer_uptodate(bh) &&
+		    (block_end <= from || block_start >= to)) {
+			set_buffer_uptodate(bh);
+			mark_buffer_dirty(bh);
+		}
+		block_start = block_end;
+		bh = bh->b_this_page;
+	} while (bh != head);
+}
+
 static int exfat_write_end(struct file *file, struct address_space *mapping,
 		loff_t pos, unsigned int len, unsigned int copied,
 		struct page *pagep, void *fsdata)
 {
 	struct inode *inode = mapping->host;
 	struct exfat_inode_info *ei = EXFAT_I(inode);
+	unsigned int from = pos & (PAGE_SIZE - 1);
 	int err;
 
+	exfat_dirty_new_buffers(pagep, from, from + len);
 	err = generic_write_end(file, mapping, pos, len, copied, pagep, fsdata);
 
 	if (EXFAT_I(inode)->i_size_aligned < i_size_read(inode)) {
@@ -599,6 +762,7 @@ static int exfat_fill_inode(struct inode *inode, struct exfat_dir_entry *info)
 
 	ei->i_size_aligned = size;
 	ei->i_size_ondisk = size;
+	ei->valid_size = info->valid_size;
 
 	exfat_save_attr(inode, info->attr);
 
@@ -651,6 +815,7 @@ void exfat_evict_inode(struct inode *inode)
 		mutex_unlock(&EXFAT_SB(inode->i_sb)->s_lock);
 	}
 
+	exfat_discard_prealloc(inode);
 	invalidate_inode_buffers(inode);
 	clear_inode(inode);
 	exfat_cache_inval_inode(inode);
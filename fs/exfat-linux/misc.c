@@ -10,6 +10,7 @@
 #include <linux/fs.h>
 #include <linux/slab.h>
 #include <linux/buffer_head.h>
+#include <linux/blkdev.h>
 
 #include "exfat_fs.h"
 
@@ -162,33 +163,158 @@ u32 exfat_calc_chksum32(void *data, int len, u32 chksum, int type)
 	return chksum;
 }
 
-void exfat_update_bh(struct buffer_head *bh, int sync)
+/*
+ * Metadata write combining.
+ *
+ * Inside a batch, a synchronous metadata update only queues its buffer on
+ * the superblock. The batch is written when it ends (or fills up): every
+ * queued buffer once, in queue order, under one plug so that neighbouring
+ * sectors merge, and then waited on together. A sector updated several
+ * times by one operation, such as a dentry sector during create, is thus
+ * written once. The caller still returns only after everything it asked
+ * to be synchronous is on disk, and the volume dirty flag keeps its own
+ * synchronous write ahead of any batch.
+ */
+void exfat_meta_batch_start(struct super_block *sb)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+
+	lockdep_assert_held(&sbi->s_lock);
+	if (!sbi->meta_depth++)
+		sbi->meta_owner = current;
+}
+
+static int exfat_meta_batch_flush(struct exfat_sb_info *sbi)
+{
+	struct blk_plug plug;
+	int i, err = 0;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < sbi->meta_nr; i++)
+		write_dirty_buffer(sbi->meta_bhs[i], REQ_SYNC);
+	blk_finish_plug(&plug);
+
+	for (i = 0; i < sbi->meta_nr; i++) {
+		wait_on_buffer(sbi->meta_bhs[i]);
+		if (!err && !buffer_uptodate(sbi->meta_bhs[i]))
+			err = -EIO;
+		brelse(sbi->meta_bhs[i]);
+	}
+
+	sbi->meta_writes += sbi->meta_nr;
+	sbi->meta_nr = 0;
+	return err;
+}
+
+/*
+ * Write out what is queued so far. Called where a later update must not
+ * reach the disk before the earlier ones, e.g. a new directory cluster
+ * has to be zeroed before a dentry points at it.
+ */
+int exfat_meta_batch_barrier(struct super_block *sb)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	int err;
+
+	if (sbi->meta_owner != current)
+		return 0;
+
+	err = exfat_meta_batch_flush(sbi);
+	if (!err)
+		err = sbi->meta_err;
+	sbi->meta_err = 0;
+	return err;
+}
+
+int exfat_meta_batch_end(struct super_block *sb)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	int err;
+
+	lockdep_assert_held(&sbi->s_lock);
+	if (--sbi->meta_depth)
+		return 0;
+
+	sbi->meta_owner = NULL;
+	err = exfat_meta_batch_flush(sbi);
+	if (!err)
+		err = sbi->meta_err;
+	sbi->meta_err = 0;
+	return err;
+}
+
+static void exfat_meta_batch_add(struct exfat_sb_info *sbi,
+		struct buffer_head *bh)
 {
+	int i, err;
+
+	for (i = 0; i < sbi->meta_nr; i++) {
+		if (sbi->meta_bhs[i] == bh) {
+			sbi->meta_merged++;
+			return;
+		}
+	}
+
+	if (sbi->meta_nr == EXFAT_META_BATCH) {
+		err = exfat_meta_batch_flush(sbi);
+		if (err && !sbi->meta_err)
+			sbi->meta_err = err;
+	}
+
+	get_bh(bh);
+	sbi->meta_bhs[sbi->meta_nr++] = bh;
+}
+
+int exfat_update_bh(struct super_block *sb, struct buffer_head *bh, int sync)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+
 	set_buffer_uptodate(bh);
 	mark_buffer_dirty(bh);
 
-	if (sync)
-		sync_dirty_buffer(bh);
+	if (!sync)
+		return 0;
+
+	/* only the task that opened the batch queues into it */
+	if (sbi->meta_owner == current) {
+		exfat_meta_batch_add(sbi, bh);
+		return 0;
+	}
+
+	sbi->meta_writes++;
+	return sync_dirty_buffer(bh);
 }
 
-int exfat_update_bhs(struct buffer_head **bhs, int nr_bhs, int sync)
+int exfat_update_bhs(struct super_block *sb, struct buffer_head **bhs,
+		int nr_bhs, int sync)
 {
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	struct blk_plug plug;
 	int i, err = 0;
 
+	if (!sync || (sbi->meta_owner == current)) {
+		for (i = 0; i < nr_bhs; i++)
+			exfat_update_bh(sb, bhs[i], sync);
+		return 0;
+	}
+
+	blk_start_plug(&plug);
 	for (i = 0; i < nr_bhs; i++) {
 		set_buffer_uptodate(bhs[i]);
 		mark_buffer_dirty(bhs[i]);
-		if (sync)
-			write_dirty_buffer(bhs[i], 0);
+		write_dirty_buffer(bhs[i], REQ_SYNC);
 	}
+	blk_finish_plug(&plug);
+	sbi->meta_writes += nr_bhs;
 
-	for (i = 0; i < nr_bhs && sync; i++) {
+	for (i = 0; i < nr_bhs; i++) {
 		wait_on_buffer(bhs[i]);
 		if (!err && !buffer_uptodate(bhs[i]))
 			err = -EIO;
 	}
 	return err;
 }
+
 void exfat_chain_set(struct exfat_chain *ec, unsigned int dir,
 		unsigned int size, unsigned char flags)
 {
@@ -87,9 +87,15 @@ static int exfat_d_hash(const struct dentry *dentry, struct qstr *qstr)
 	wchar_t c;
 
 	for (i = 0; i < len; i += charlen) {
-		charlen = t->char2uni(&name[i], len - i, &c);
-		if (charlen < 0)
-			return charlen;
+		if (name[i] < 0x80) {
+			/* ASCII maps to itself, don't go through the NLS */
+			charlen = 1;
+			c = name[i];
+		} else {
+			charlen = t->char2uni(&name[i], len - i, &c);
+			if (charlen < 0)
+				return charlen;
+		}
 		hash = partial_name_hash(exfat_toupper(sb, c), hash);
 	}
 
@@ -110,7 +116,20 @@ static int exfat_d_cmp(const struct dentry *dentry, unsigned int len,
 	if (alen != blen)
 		return 1;
 
+	/* the common case, an exact match */
+	if (!memcmp(name->name, str, alen))
+		return 0;
+
 	for (i = 0; i < len; i += charlen) {
+		if (name->name[i] < 0x80 && (unsigned char)str[i] < 0x80) {
+			charlen = 1;
+			if (name->name[i] != str[i] &&
+			    exfat_toupper(sb, name->name[i]) !=
+			    exfat_toupper(sb, str[i]))
+				return 1;
+			continue;
+		}
+
 		charlen = t->char2uni(&name->name[i], alen - i, &c1);
 		if (charlen < 0)
 			return 1;
@@ -140,6 +159,14 @@ static int exfat_utf8_d_hash(const struct dentry *dentry, struct qstr *qstr)
 	unicode_t u;
 
 	for (i = 0; i < len; i += charlen) {
+		if (name[i] < 0x80) {
+			/* plain ASCII needs no decoding */
+			hash = partial_name_hash(exfat_toupper(sb, name[i]),
+						 hash);
+			charlen = 1;
+			continue;
+		}
+
 		charlen = utf8_to_utf32(&name[i], len - i, &u);
 		if (charlen < 0)
 			return charlen;
@@ -167,7 +194,20 @@ static int exfat_utf8_d_cmp(const struct dentry *dentry, unsigned int len,
 	if (alen != blen)
 		return 1;
 
+	/* the common case, an exact match */
+	if (!memcmp(name->name, str, alen))
+		return 0;
+
 	for (i = 0; i < alen; i += charlen) {
+		if (name->name[i] < 0x80 && (unsigned char)str[i] < 0x80) {
+			charlen = 1;
+			if (name->name[i] != str[i] &&
+			    exfat_toupper(sb, name->name[i]) !=
+			    exfat_toupper(sb, str[i]))
+				return 1;
+			continue;
+		}
+
 		charlen = utf8_to_utf32(&name->name[i], alen - i, &u_a);
 		if (charlen < 0)
 			return 1;
@@ -318,6 +358,8 @@ static int exfat_find_empty_entry(struct inode *inode,
 	if (ei->hint_femp.eidx != EXFAT_HINT_NONE) {
 		hint_femp = ei->hint_femp;
 		ei->hint_femp.eidx = EXFAT_HINT_NONE;
+	} else {
+		exfat_dir_index_empty_hint(sb, p_dir, num_entries, &hint_femp);
 	}
 
 	while ((dentry = exfat_search_empty_slot(sb, &hint_femp, p_dir,
@@ -359,6 +401,11 @@ static int exfat_find_empty_entry(struct inode *inode,
 			if (exfat_ent_set(sb, last_clu, clu.dir))
 				return -EIO;
 
+		/* the cluster is zeroed and linked before the size grows */
+		ret = exfat_meta_batch_barrier(sb);
+		if (ret)
+			return ret;
+
 		if (hint_femp.eidx == EXFAT_HINT_NONE) {
 			/* the special case that new dentry
 			 * should be allocated from the start of new cluster
@@ -384,7 +431,7 @@ static int exfat_find_empty_entry(struct inode *inode,
 			ep->dentry.stream.valid_size = cpu_to_le64(size);
 			ep->dentry.stream.size = ep->dentry.stream.valid_size;
 			ep->dentry.stream.flags = p_dir->flags;
-			exfat_update_bh(bh, IS_DIRSYNC(inode));
+			exfat_update_bh(sb, bh, IS_DIRSYNC(inode));
 			brelse(bh);
 			if (exfat_update_dir_chksum(inode, &(ei->dir),
 			    ei->entry))
@@ -395,6 +442,7 @@ static int exfat_find_empty_entry(struct inode *inode,
 		i_size_write(inode, size);
 		EXFAT_I(inode)->i_size_ondisk += sbi->cluster_size;
 		EXFAT_I(inode)->i_size_aligned += sbi->cluster_size;
+		EXFAT_I(inode)->valid_size = size;
 		EXFAT_I(inode)->flags = p_dir->flags;
 		inode->i_blocks += 1 << sbi->sect_per_clus_bits;
 	}
@@ -525,11 +573,13 @@ static int exfat_add_entry(struct inode *inode, const char *path,
 		info->attr = ATTR_ARCHIVE;
 		info->start_clu = EXFAT_EOF_CLUSTER;
 		info->size = 0;
+		info->valid_size = 0;
 		info->num_subdirs = 0;
 	} else {
 		info->attr = ATTR_SUBDIR;
 		info->start_clu = start_clu;
 		info->size = clu_size;
+		info->valid_size = clu_size;
 		info->num_subdirs = EXFAT_MIN_SUBDIR;
 	}
 	memset(&info->crtime, 0, sizeof(info->crtime));
@@ -547,13 +597,17 @@ static int exfat_create(struct inode *dir,
 	struct exfat_chain cdir;
 	struct exfat_dir_entry info;
 	loff_t i_pos;
-	int err;
+	int err, err2;
 
 	mutex_lock(&EXFAT_SB(sb)->s_lock);
 	exfat_set_volume_dirty(sb);
+	exfat_meta_batch_start(sb);
 	err = exfat_add_entry(dir, dentry->d_name.name, &cdir, TYPE_FILE,
 		&info);
+	err2 = exfat_meta_batch_end(sb);
 	exfat_clear_volume_dirty(sb);
+	if (!err)
+		err = err2;
 	if (err)
 		goto unlock;
 
@@ -641,7 +695,9 @@ static int exfat_find(struct inode *dir, struct qstr *qname,
 
 		info->type = exfat_get_entry_type(ep);
 		info->attr = le16_to_cpu(ep->dentry.file.attr);
-		info->size = le64_to_cpu(ep2->dentry.stream.valid_size);
+		info->size = le64_to_cpu(ep2->dentry.stream.size);
+		info->valid_size = min_t(loff_t, info->size,
+				le64_to_cpu(ep2->dentry.stream.valid_size));
 		if ((info->type == TYPE_FILE) && (info->size == 0)) {
 			info->flags = ALLOC_NO_FAT_CHAIN;
 			info->start_clu = EXFAT_EOF_CLUSTER;
@@ -777,7 +833,7 @@ static int exfat_unlink(struct inode *dir, struct dentry *dentry)
 	struct exfat_inode_info *ei = EXFAT_I(inode);
 	struct buffer_head *bh;
 	sector_t sector;
-	int num_entries, entry, err = 0;
+	int num_entries, entry, err = 0, err2;
 
 	mutex_lock(&EXFAT_SB(sb)->s_lock);
 	exfat_chain_dup(&cdir, &ei->dir);
@@ -803,11 +859,15 @@ static int exfat_unlink(struct inode *dir, struct dentry *dentry)
 	brelse(bh);
 
 	exfat_set_volume_dirty(sb);
+	exfat_meta_batch_start(sb);
 	/* update the directory entry */
-	if (exfat_remove_entries(dir, &cdir, entry, 0, num_entries)) {
+	if (exfat_remove_entries(dir, &cdir, entry, 0, num_entries))
 		err = -EIO;
+	err2 = exfat_meta_batch_end(sb);
+	if (!err)
+		err = err2;
+	if (err)
 		goto unlock;
-	}
 
 	/* This doesn't modify ei */
 	ei->dir.dir = DIR_DELETED;
@@ -839,13 +899,17 @@ static int exfat_mkdir(struct inode *dir,
 	struct exfat_dir_entry info;
 	struct exfat_chain cdir;
 	loff_t i_pos;
-	int err;
+	int err, err2;
 
 	mutex_lock(&EXFAT_SB(sb)->s_lock);
 	exfat_set_volume_dirty(sb);
+	exfat_meta_batch_start(sb);
 	err = exfat_add_entry(dir, dentry->d_name.name, &cdir, TYPE_DIR,
 		&info);
+	err2 = exfat_meta_batch_end(sb);
 	exfat_clear_volume_dirty(sb);
+	if (!err)
+		err = err2;
 	if (err)
 		goto unlock;
 
@@ -930,7 +994,7 @@ static int exfat_rmdir(struct inode *dir, struct dentry *dentry)
 	struct exfat_inode_info *ei = EXFAT_I(inode);
 	struct buffer_head *bh;
 	sector_t sector;
-	int num_entries, entry, err;
+	int num_entries, entry, err, err2;
 
 	mutex_lock(&EXFAT_SB(inode->i_sb)->s_lock);
 
@@ -970,11 +1034,16 @@ static int exfat_rmdir(struct inode *dir, struct dentry *dentry)
 	brelse(bh);
 
 	exfat_set_volume_dirty(sb);
+	exfat_meta_batch_start(sb);
 	err = exfat_remove_entries(dir, &cdir, entry, 0, num_entries);
+	err2 = exfat_meta_batch_end(sb);
 	if (err) {
 		exfat_err(sb, "failed to exfat_remove_entries : err(%d)", err);
 		goto unlock;
 	}
+	err = err2;
+	if (err)
+		goto unlock;
 	ei->dir.dir = DIR_DELETED;
 	exfat_clear_volume_dirty(sb);
 
@@ -1039,7 +1108,7 @@ static int exfat_rename_file(struct inode *inode, struct exfat_chain *p_dir,
 			epnew->dentry.file.attr |= cpu_to_le16(ATTR_ARCHIVE);
 			ei->attr |= ATTR_ARCHIVE;
 		}
-		exfat_update_bh(new_bh, sync);
+		exfat_update_bh(sb, new_bh, sync);
 		brelse(old_bh);
 		brelse(new_bh);
 
@@ -1055,7 +1124,7 @@ static int exfat_rename_file(struct inode *inode, struct exfat_chain *p_dir,
 		}
 
 		*epnew = *epold;
-		exfat_update_bh( new_bh, sync);
+		exfat_update_bh(sb, new_bh, sync);
 		brelse(old_bh);
 		brelse(new_bh);
 
@@ -1064,6 +1133,11 @@ static int exfat_rename_file(struct inode *inode, struct exfat_chain *p_dir,
 		if (ret)
 			return ret;
 
+		/* the new entries are written before the old ones go */
+		ret = exfat_meta_batch_barrier(sb);
+		if (ret)
+			return ret;
+
 		exfat_remove_entries(inode, p_dir, oldentry, 0,
 			num_old_entries);
 		ei->entry = newentry;
@@ -1072,7 +1146,7 @@ static int exfat_rename_file(struct inode *inode, struct exfat_chain *p_dir,
 			epold->dentry.file.attr |= cpu_to_le16(ATTR_ARCHIVE);
 			ei->attr |= ATTR_ARCHIVE;
 		}
-		exfat_update_bh(old_bh, sync);
+		exfat_update_bh(sb, old_bh, sync);
 		brelse(old_bh);
 		ret = exfat_init_ext_entry(inode, p_dir, oldentry,
 			num_new_entries, p_uniname);
@@ -1123,7 +1197,7 @@ static int exfat_move_file(struct inode *inode, struct exfat_chain *p_olddir,
 		epnew->dentry.file.attr |= cpu_to_le16(ATTR_ARCHIVE);
 		ei->attr |= ATTR_ARCHIVE;
 	}
-	exfat_update_bh(new_bh, IS_DIRSYNC(inode));
+	exfat_update_bh(sb, new_bh, IS_DIRSYNC(inode));
 	brelse(mov_bh);
 	brelse(new_bh);
 
@@ -1139,7 +1213,7 @@ static int exfat_move_file(struct inode *inode, struct exfat_chain *p_olddir,
 	}
 
 	*epnew = *epmov;
-	exfat_update_bh(new_bh, IS_DIRSYNC(inode));
+	exfat_update_bh(sb, new_bh, IS_DIRSYNC(inode));
 	brelse(mov_bh);
 	brelse(new_bh);
 
@@ -1148,6 +1222,11 @@ static int exfat_move_file(struct inode *inode, struct exfat_chain *p_olddir,
 	if (ret)
 		return ret;
 
+	/* the new entries are written before the old ones go */
+	ret = exfat_meta_batch_barrier(sb);
+	if (ret)
+		return ret;
+
 	exfat_remove_entries(inode, p_olddir, oldentry, 0, num_old_entries);
 
 	exfat_chain_set(&ei->dir, p_newdir->dir, p_newdir->size,
@@ -1184,7 +1263,7 @@ static int __exfat_rename(struct inode *old_parent_inode,
 		struct exfat_inode_info *ei, struct inode *new_parent_inode,
 		struct dentry *new_dentry)
 {
-	int ret;
+	int ret, err;
 	int dentry;
 	struct exfat_chain olddir, newdir;
 	struct exfat_chain *p_dir = NULL;
@@ -1265,6 +1344,7 @@ static int __exfat_rename(struct inode *old_parent_inode,
 		goto out;
 
 	exfat_set_volume_dirty(sb);
+	exfat_meta_batch_start(sb);
 
 	if (olddir.dir == newdir.dir)
 		ret = exfat_rename_file(new_parent_inode, &olddir, dentry,
@@ -1299,6 +1379,9 @@ static int __exfat_rename(struct inode *old_parent_inode,
 			/* new_ei, new_clu_to_free */
 			struct exfat_chain new_clu_to_free;
 
+			/* the entries are gone before their clusters are freed */
+			exfat_meta_batch_barrier(sb);
+
 			exfat_chain_set(&new_clu_to_free, new_ei->start_clu,
 				EXFAT_B_TO_CLU_ROUND_UP(i_size_read(new_inode),
 				sbi), new_ei->flags);
@@ -1319,7 +1402,10 @@ del_out:
 		 */
 		new_ei->dir.dir = DIR_DELETED;
 	}
+	err = exfat_meta_batch_end(sb);
 	exfat_clear_volume_dirty(sb);
+	if (!ret)
+		ret = err;
 out:
 	return ret;
 }
@@ -394,13 +394,63 @@ static const unsigned short uni_def_upcase[EXFAT_NUM_UPCASE] = {
  * for compatibility.
  *
  * " * / : < > ? \ |
+ *
+ * These and the control codes below 0x0020 are kept as a bitmap of the
+ * ASCII range.
  */
-static unsigned short bad_uni_chars[] = {
-	0x0022,         0x002A, 0x002F, 0x003A,
-	0x003C, 0x003E, 0x003F, 0x005C, 0x007C,
-	0
+static const u32 bad_uni_chars[4] = {
+	0xffffffff, 0xd4008404, 0x10000000, 0x10000000
 };
 
+static inline bool exfat_bad_uni_char(unsigned short c)
+{
+	return c < 0x0080 && (bad_uni_chars[c >> 5] & (1U << (c & 31)));
+}
+
+/* Fold an upcased unit into the name hash, as exfat_calc_chksum16() does */
+static inline u16 exfat_name_hash_add(u16 hash, unsigned short up)
+{
+	hash = ((hash << 15) | (hash >> 1)) + (up & 0xff);
+	return ((hash << 15) | (hash >> 1)) + (up >> 8);
+}
+
+/* Return the length of the ASCII prefix of a string, a word at a time */
+static int exfat_ascii_len(const unsigned char *s, int len)
+{
+	int i = 0;
+
+	while (i + (int)sizeof(unsigned long) <= len &&
+	       !(get_unaligned((const unsigned long *)(s + i)) &
+		 REPEAT_BYTE(0x80)))
+		i += sizeof(unsigned long);
+
+	while (i < len && s[i] < 0x80)
+		i++;
+	return i;
+}
+
+/*
+ * Return the number of non-NUL ASCII units at the start of a name, four
+ * at a time
+ */
+static int exfat_ascii_units(const unsigned short *s, int len)
+{
+	int i = 0;
+	u64 w;
+
+	while (i + 4 <= len) {
+		w = get_unaligned((const u64 *)(s + i));
+		if ((w & 0xff80ff80ff80ff80ULL) ||
+		    ((w - 0x0001000100010001ULL) & ~w & 0x8000800080008000ULL))
+			break;
+		i += 4;
+	}
+
+	while (i < len && s[i] && s[i] < 0x0080)
+		i++;
+	return i;
+}
+
 static int exfat_convert_char_to_ucs2(struct nls_table *nls,
 		const unsigned char *ch, int ch_len, unsigned short *ucs2,
 		int *lossy)
@@ -455,23 +505,24 @@ unsigned short exfat_toupper(struct super_block *sb, unsigned short a)
 	return sbi->vol_utbl[a] ? sbi->vol_utbl[a] : a;
 }
 
-static unsigned short *exfat_wstrchr(unsigned short *str, unsigned short wchar)
-{
-	while (*str) {
-		if (*(str++) == wchar)
-			return str;
-	}
-	return NULL;
-}
-
 int exfat_uniname_ncmp(struct super_block *sb, unsigned short *a,
 		unsigned short *b, unsigned int len)
 {
-	int i;
+	unsigned int i = 0;
+
+	while (i < len) {
+		/* equal units need no upcasing, skip them four at a time */
+		if (i + 4 <= len && get_unaligned((u64 *)(a + i)) ==
+				get_unaligned((u64 *)(b + i))) {
+			i += 4;
+			continue;
+		}
 
-	for (i = 0; i < len; i++, a++, b++)
-		if (exfat_toupper(sb, *a) != exfat_toupper(sb, *b))
+		if (a[i] != b[i] &&
+		    exfat_toupper(sb, a[i]) != exfat_toupper(sb, b[i]))
 			return 1;
+		i++;
+	}
 	return 0;
 }
 
@@ -479,12 +530,17 @@ static int exfat_utf16_to_utf8(struct super_block *sb,
 		struct exfat_uni_name *p_uniname, unsigned char *p_cstring,
 		int buflen)
 {
-	int len;
+	int i, len;
 	const unsigned short *uniname = p_uniname->name;
 
+	/* the ASCII prefix is narrowed here, the rest is left to the NLS */
+	len = exfat_ascii_units(uniname, min(MAX_NAME_LENGTH, buflen - 1));
+	for (i = 0; i < len; i++)
+		p_cstring[i] = uniname[i];
+
 	/* always len >= 0 */
-	len = utf16s_to_utf8s(uniname, MAX_NAME_LENGTH, UTF16_HOST_ENDIAN,
-		p_cstring, buflen);
+	len += utf16s_to_utf8s(uniname + len, MAX_NAME_LENGTH - len,
+		UTF16_HOST_ENDIAN, p_cstring + len, buflen - len);
 	p_cstring[len] = '\0';
 	return len;
 }
@@ -494,13 +550,21 @@ static int exfat_utf8_to_utf16(struct super_block *sb,
 		struct exfat_uni_name *p_uniname, int *p_lossy)
 {
 	int i, unilen, lossy = NLS_NAME_NO_LOSSY;
-	__le16 upname[MAX_NAME_LENGTH + 1];
 	unsigned short *uniname = p_uniname->name;
+	u16 hash = 0;
 
 	WARN_ON(!len);
 
-	unilen = utf8s_to_utf16s(p_cstring, len, UTF16_HOST_ENDIAN,
-			(wchar_t *)uniname, MAX_NAME_LENGTH + 2);
+	if (len <= MAX_NAME_LENGTH && exfat_ascii_len(p_cstring, len) == len) {
+		/* most names are plain ASCII, widen them directly */
+		for (i = 0; i < len; i++)
+			uniname[i] = p_cstring[i];
+		unilen = len;
+	} else {
+		unilen = utf8s_to_utf16s(p_cstring, len, UTF16_HOST_ENDIAN,
+				(wchar_t *)uniname, MAX_NAME_LENGTH + 2);
+	}
+
 	if (unilen < 0) {
 		exfat_err(sb, "failed to %s (err : %d) nls len : %d",
 			  __func__, unilen, len);
@@ -514,18 +578,16 @@ static int exfat_utf8_to_utf16(struct super_block *sb,
 	}
 
 	for (i = 0; i < unilen; i++) {
-		if (*uniname < 0x0020 ||
-		    exfat_wstrchr(bad_uni_chars, *uniname))
+		if (exfat_bad_uni_char(*uniname))
 			lossy |= NLS_NAME_LOSSY;
 
-		upname[i] = cpu_to_le16(exfat_toupper(sb, *uniname));
+		hash = exfat_name_hash_add(hash, exfat_toupper(sb, *uniname));
 		uniname++;
 	}
 
 	*uniname = '\0';
 	p_uniname->name_len = unilen;
-	p_uniname->name_hash = exfat_calc_chksum16(upname, unilen << 1, 0,
-			CS_DEFAULT);
+	p_uniname->name_hash = hash;
 
 	if (p_lossy)
 		*p_lossy = lossy;
@@ -545,7 +607,12 @@ static int __exfat_utf16_to_nls(struct super_block *sb,
 	const unsigned short *uniname = p_uniname->name;
 	struct nls_table *nls = EXFAT_SB(sb)->nls_io;
 
-	i = 0;
+	/* ASCII maps to itself in every charset, narrow the prefix directly */
+	i = exfat_ascii_units(uniname, min(MAX_NAME_LENGTH, buflen - 1));
+	for (j = 0; j < i; j++)
+		*p_cstring++ = *uniname++;
+	out_len = i;
+
 	while (i < MAX_NAME_LENGTH && out_len < (buflen - 1)) {
 		if (*uniname == '\0')
 			break;
@@ -596,21 +663,25 @@ static int exfat_nls_to_ucs2(struct super_block *sb,
 		struct exfat_uni_name *p_uniname, int *p_lossy)
 {
 	int i = 0, unilen = 0, lossy = NLS_NAME_NO_LOSSY;
-	__le16 upname[MAX_NAME_LENGTH + 1];
 	unsigned short *uniname = p_uniname->name;
 	struct nls_table *nls = EXFAT_SB(sb)->nls_io;
+	u16 hash = 0;
 
 	WARN_ON(!len);
 
 	while (unilen < MAX_NAME_LENGTH && i < len) {
-		i += exfat_convert_char_to_ucs2(nls, p_cstring + i, len - i,
-				uniname, &lossy);
+		if (p_cstring[i] < 0x80) {
+			/* skip the NLS for ASCII, it maps to itself */
+			*uniname = p_cstring[i++];
+		} else {
+			i += exfat_convert_char_to_ucs2(nls, p_cstring + i,
+					len - i, uniname, &lossy);
+		}
 
-		if (*uniname < 0x0020 ||
-		    exfat_wstrchr(bad_uni_chars, *uniname))
+		if (exfat_bad_uni_char(*uniname))
 			lossy |= NLS_NAME_LOSSY;
 
-		upname[unilen] = cpu_to_le16(exfat_toupper(sb, *uniname));
+		hash = exfat_name_hash_add(hash, exfat_toupper(sb, *uniname));
 		uniname++;
 		unilen++;
 	}
@@ -620,8 +691,7 @@ static int exfat_nls_to_ucs2(struct super_block *sb,
 
 	*uniname = '\0';
 	p_uniname->name_len = unilen;
-	p_uniname->name_hash = exfat_calc_chksum16(upname, unilen << 1, 0,
-			CS_DEFAULT);
+	p_uniname->name_hash = hash;
 
 	if (p_lossy)
 		*p_lossy = lossy;
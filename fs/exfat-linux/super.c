@@ -46,10 +46,15 @@ static void exfat_put_super(struct super_block *sb)
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
 
 	mutex_lock(&sbi->s_lock);
+	exfat_dir_index_drop_all(sbi);
 	exfat_free_bitmap(sbi);
 	brelse(sbi->boot_bh);
 	mutex_unlock(&sbi->s_lock);
 
+	if (sbi->meta_writes)
+		exfat_info(sb, "%lu synchronous metadata writes, %lu merged updates",
+			   sbi->meta_writes, sbi->meta_merged);
+
 	call_rcu(&sbi->rcu, exfat_delayed_free);
 }
 
@@ -77,12 +82,10 @@ static int exfat_statfs(struct dentry *dentry, struct kstatfs *buf)
 	unsigned long long id = huge_encode_dev(sb->s_bdev->bd_dev);
 
 	if (sbi->used_clusters == EXFAT_CLUSTERS_UNTRACKED) {
-		mutex_lock(&sbi->s_lock);
-		if (exfat_count_used_clusters(sb, &sbi->used_clusters)) {
-			mutex_unlock(&sbi->s_lock);
+		/* wait for the mount time count */
+		flush_work(&sbi->count_work);
+		if (sbi->used_clusters == EXFAT_CLUSTERS_UNTRACKED)
 			return -EIO;
-		}
-		mutex_unlock(&sbi->s_lock);
 	}
 
 	buf->f_type = sb->s_magic;
@@ -191,6 +194,8 @@ static struct inode *exfat_alloc_inode(struct super_block *sb)
 		return NULL;
 
 	init_rwsem(&ei->truncate_lock);
+	ei->pa_len = 0;
+	ei->pa_size = EXFAT_PA_MIN_CLUSTERS;
 	return &ei->vfs_inode;
 }
 
@@ -449,6 +454,7 @@ static int exfat_read_root(struct inode *inode)
 	EXFAT_I(inode)->i_pos = ((loff_t)sbi->root_dir << 32) | 0xffffffff;
 	EXFAT_I(inode)->i_size_aligned = i_size_read(inode);
 	EXFAT_I(inode)->i_size_ondisk = i_size_read(inode);
+	EXFAT_I(inode)->valid_size = i_size_read(inode);
 
 	exfat_save_attr(inode, ATTR_SUBDIR);
 	inode->i_mtime = inode->i_atime = inode->i_ctime = ei->i_crtime =
@@ -676,16 +682,11 @@ static int __exfat_fill_super(struct super_block *sb)
 		goto free_upcase_table;
 	}
 
-	ret = exfat_count_used_clusters(sb, &sbi->used_clusters);
-	if (ret) {
-		exfat_err(sb, "failed to scan clusters");
-		goto free_alloc_bitmap;
-	}
+	/* count used clusters in the background, statfs waits for it */
+	exfat_start_count_used(sb);
 
 	return 0;
 
-free_alloc_bitmap:
-	exfat_free_bitmap(sbi);
 free_upcase_table:
 	exfat_free_upcase_table(sbi);
 free_bh:
@@ -806,8 +807,12 @@ static int exfat_init_sb_info(struct super_block *sb)
 	if (!sbi)
 		return -ENOMEM;
 
+	sbi->sb = sb;
 	mutex_init(&sbi->s_lock);
 	mutex_init(&sbi->bitmap_lock);
+	INIT_WORK(&sbi->count_work, exfat_count_used_work);
+	INIT_LIST_HEAD(&sbi->pa_windows);
+	INIT_LIST_HEAD(&sbi->dir_indexes);
 	ratelimit_state_init(&sbi->ratelimit, DEFAULT_RATELIMIT_INTERVAL,
 			DEFAULT_RATELIMIT_BURST);
 
@@ -841,10 +846,11 @@ static void exfat_inode_init_once(void *foo)
 {
 	struct exfat_inode_info *ei = (struct exfat_inode_info *)foo;
 
-	spin_lock_init(&ei->cache_lru_lock);
+	spin_lock_init(&ei->cache_lock);
 	ei->nr_caches = 0;
 	ei->cache_valid_id = EXFAT_CACHE_VALID + 1;
-	INIT_LIST_HEAD(&ei->cache_lru);
+	ei->cache_tree = RB_ROOT;
+	INIT_LIST_HEAD(&ei->pa_list);
 	INIT_HLIST_NODE(&ei->i_hash_fat);
 	inode_init_once(&ei->vfs_inode);
 }
@@ -96,11 +96,8 @@ int FsMountVol(struct super_block *sb)
 
 	sm_P(&z_sem);
 
-	err = buf_init(sb);
-	if (!err)
-		err = ffsMountVol(sb);
-	else
-		buf_shutdown(sb);
+	/* the caches are set up by ffsMountVol once the geometry is known */
+	err = ffsMountVol(sb);
 
 	sm_V(&z_sem);
 
@@ -71,6 +71,9 @@
 #define ATTR_EXTEND             0x000F
 #define ATTR_RWMASK             0x007E
 
+/* num of contiguous cluster runs remembered per file */
+#define MAX_CHAIN_RUNS          8
+
 /* file creation modes */
 #define FM_REGULAR              0x00
 #define FM_SYMLINK              0x40
@@ -136,6 +139,13 @@ typedef struct {
 	u8       flags;
 } CHAIN_T;
 
+/* contiguous part of a FAT chain */
+typedef struct {
+	u32      off;       /* cluster offset in the file */
+	u32      clu;       /* first cluster of the run */
+	u32      len;       /* num of clusters in the run */
+} CHAIN_RUN_T;
+
 /* file id structure */
 typedef struct {
 	CHAIN_T     dir;
@@ -148,6 +158,9 @@ typedef struct {
 	s64       rwoffset;
 	s32       hint_last_off;
 	u32      hint_last_clu;
+	s32       num_runs;
+	s32       next_run;
+	CHAIN_RUN_T runs[MAX_CHAIN_RUNS];
 } FILE_ID_T;
 
 typedef struct {
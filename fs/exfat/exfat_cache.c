@@ -33,20 +33,19 @@
 /*                                                                      */
 /************************************************************************/
 
+#include <linux/mm.h>
+#include <linux/blkdev.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+
 #include "exfat_config.h"
 #include "exfat_data.h"
+#include "exfat_oal.h"
 
 #include "exfat_cache.h"
 #include "exfat_super.h"
 #include "exfat_core.h"
 
-/*----------------------------------------------------------------------*/
-/*  Global Variable Definitions                                         */
-/*----------------------------------------------------------------------*/
-
-#define sm_P(s)
-#define sm_V(s)
-
 static s32 __FAT_read(struct super_block *sb, u32 loc, u32 *content);
 static s32 __FAT_write(struct super_block *sb, u32 loc, u32 content);
 
@@ -55,6 +54,8 @@ static BUF_CACHE_T *FAT_cache_get(struct super_block *sb, sector_t sec);
 static void FAT_cache_insert_hash(struct super_block *sb, BUF_CACHE_T *bp);
 static void FAT_cache_remove_hash(BUF_CACHE_T *bp);
 
+static void FAT_readahead(struct super_block *sb, sector_t sec);
+
 static u8 *__buf_getblk(struct super_block *sb, sector_t sec);
 
 static BUF_CACHE_T *buf_cache_find(struct super_block *sb, sector_t sec);
@@ -71,16 +72,83 @@ static void move_to_lru(BUF_CACHE_T *bp, BUF_CACHE_T *list);
 /*  Cache Initialization Functions                                      */
 /*======================================================================*/
 
+/*
+ * Size a cache from what the volume would like to keep, within
+ * [min, max] and within its share of memory. Returns a power of 2.
+ */
+static u32 buf_cache_size(struct super_block *sb, u64 want, u32 min, u32 max)
+{
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+	struct sysinfo si;
+	u64 mem;
+
+	si_meminfo(&si);
+	mem = ((u64) si.totalram * si.mem_unit) >>
+		(CACHE_MEM_SHIFT + p_bd->sector_size_bits);
+
+	if (want > mem)
+		want = mem;
+	if (want < min)
+		want = min;
+	if (want > max)
+		want = max;
+
+	return (u32) rounddown_pow_of_two(want);
+} /* end of buf_cache_size */
+
+static void buf_cache_free(FS_INFO_T *p_fs)
+{
+	vfree(p_fs->FAT_cache_array);
+	vfree(p_fs->FAT_cache_hash_list);
+	vfree(p_fs->buf_cache_array);
+	vfree(p_fs->buf_cache_hash_list);
+
+	p_fs->FAT_cache_array = NULL;
+	p_fs->FAT_cache_hash_list = NULL;
+	p_fs->buf_cache_array = NULL;
+	p_fs->buf_cache_hash_list = NULL;
+} /* end of buf_cache_free */
+
+/* must be called once the volume geometry is known */
 s32 buf_init(struct super_block *sb)
 {
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	u32 fat_hash_size, buf_hash_size;
 
 	int i;
 
+	/* the FAT cache follows the FAT size, the buf cache the volume size */
+	p_fs->FAT_cache_size = buf_cache_size(sb, p_fs->num_FAT_sectors,
+			FAT_CACHE_SIZE_MIN, FAT_CACHE_SIZE_MAX);
+	p_fs->buf_cache_size = buf_cache_size(sb, p_fs->num_sectors >> 16,
+			BUF_CACHE_SIZE_MIN, BUF_CACHE_SIZE_MAX);
+
+	/* one hash bucket per two entries */
+	fat_hash_size = p_fs->FAT_cache_size >> 1;
+	buf_hash_size = p_fs->buf_cache_size >> 1;
+	p_fs->FAT_cache_hash_mask = fat_hash_size - 1;
+	p_fs->buf_cache_hash_mask = buf_hash_size - 1;
+
+	p_fs->FAT_cache_array = vmalloc(p_fs->FAT_cache_size * sizeof(BUF_CACHE_T));
+	p_fs->FAT_cache_hash_list = vmalloc(fat_hash_size * sizeof(BUF_CACHE_T));
+	p_fs->buf_cache_array = vmalloc(p_fs->buf_cache_size * sizeof(BUF_CACHE_T));
+	p_fs->buf_cache_hash_list = vmalloc(buf_hash_size * sizeof(BUF_CACHE_T));
+	if (!p_fs->FAT_cache_array || !p_fs->FAT_cache_hash_list ||
+	    !p_fs->buf_cache_array || !p_fs->buf_cache_hash_list) {
+		buf_cache_free(p_fs);
+		return FFS_MEMORYERR;
+	}
+
+	sm_init(&p_fs->f_sem);
+	sm_init(&p_fs->b_sem);
+	p_fs->FAT_cache_hits = p_fs->FAT_cache_misses = 0;
+	p_fs->FAT_ra_start = p_fs->FAT_ra_end = 0;
+	p_fs->buf_cache_hits = p_fs->buf_cache_misses = 0;
+
 	/* LRU list */
 	p_fs->FAT_cache_lru_list.next = p_fs->FAT_cache_lru_list.prev = &p_fs->FAT_cache_lru_list;
 
-	for (i = 0; i < FAT_CACHE_SIZE; i++) {
+	for (i = 0; i < p_fs->FAT_cache_size; i++) {
 		p_fs->FAT_cache_array[i].drv = -1;
 		p_fs->FAT_cache_array[i].sec = ~0;
 		p_fs->FAT_cache_array[i].flag = 0;
@@ -91,7 +159,7 @@ s32 buf_init(struct super_block *sb)
 
 	p_fs->buf_cache_lru_list.next = p_fs->buf_cache_lru_list.prev = &p_fs->buf_cache_lru_list;
 
-	for (i = 0; i < BUF_CACHE_SIZE; i++) {
+	for (i = 0; i < p_fs->buf_cache_size; i++) {
 		p_fs->buf_cache_array[i].drv = -1;
 		p_fs->buf_cache_array[i].sec = ~0;
 		p_fs->buf_cache_array[i].flag = 0;
@@ -101,29 +169,41 @@ s32 buf_init(struct super_block *sb)
 	}
 
 	/* HASH list */
-	for (i = 0; i < FAT_CACHE_HASH_SIZE; i++) {
+	for (i = 0; i < fat_hash_size; i++) {
 		p_fs->FAT_cache_hash_list[i].drv = -1;
 		p_fs->FAT_cache_hash_list[i].sec = ~0;
 		p_fs->FAT_cache_hash_list[i].hash_next = p_fs->FAT_cache_hash_list[i].hash_prev = &(p_fs->FAT_cache_hash_list[i]);
 	}
 
-	for (i = 0; i < FAT_CACHE_SIZE; i++)
+	for (i = 0; i < p_fs->FAT_cache_size; i++)
 		FAT_cache_insert_hash(sb, &(p_fs->FAT_cache_array[i]));
 
-	for (i = 0; i < BUF_CACHE_HASH_SIZE; i++) {
+	for (i = 0; i < buf_hash_size; i++) {
 		p_fs->buf_cache_hash_list[i].drv = -1;
 		p_fs->buf_cache_hash_list[i].sec = ~0;
 		p_fs->buf_cache_hash_list[i].hash_next = p_fs->buf_cache_hash_list[i].hash_prev = &(p_fs->buf_cache_hash_list[i]);
 	}
 
-	for (i = 0; i < BUF_CACHE_SIZE; i++)
+	for (i = 0; i < p_fs->buf_cache_size; i++)
 		buf_cache_insert_hash(sb, &(p_fs->buf_cache_array[i]));
 
 	return FFS_SUCCESS;
 } /* end of buf_init */
 
+/* the caches must have been released with FAT_release_all/buf_release_all */
 s32 buf_shutdown(struct super_block *sb)
 {
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	if (!p_fs->FAT_cache_array)
+		return FFS_SUCCESS;
+
+	printk(KERN_INFO "[EXFAT] FAT cache: %u entries, %llu hits, %llu misses\n",
+	       p_fs->FAT_cache_size, p_fs->FAT_cache_hits, p_fs->FAT_cache_misses);
+	printk(KERN_INFO "[EXFAT] buf cache: %u entries, %llu hits, %llu misses\n",
+	       p_fs->buf_cache_size, p_fs->buf_cache_hits, p_fs->buf_cache_misses);
+
+	buf_cache_free(p_fs);
 	return FFS_SUCCESS;
 } /* end of buf_shutdown */
 
@@ -139,12 +219,13 @@ s32 buf_shutdown(struct super_block *sb)
 s32 FAT_read(struct super_block *sb, u32 loc, u32 *content)
 {
 	s32 ret;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&f_sem);
+	sm_P(&p_fs->f_sem);
 
 	ret = __FAT_read(sb, loc, content);
 
-	sm_V(&f_sem);
+	sm_V(&p_fs->f_sem);
 
 	return ret;
 } /* end of FAT_read */
@@ -152,16 +233,68 @@ s32 FAT_read(struct super_block *sb, u32 loc, u32 *content)
 s32 FAT_write(struct super_block *sb, u32 loc, u32 content)
 {
 	s32 ret;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&f_sem);
+	sm_P(&p_fs->f_sem);
 
 	ret = __FAT_write(sb, loc, content);
 
-	sm_V(&f_sem);
+	sm_V(&p_fs->f_sem);
 
 	return ret;
 } /* end of FAT_write */
 
+/* in : sb, clu, max
+  * returns the num of links from clu to the next cluster, up to max,
+  *            decoding the FAT a sector at a time
+  *            -1 on error
+  */
+s32 FAT_read_contig(struct super_block *sb, u32 clu, u32 max)
+{
+	s32 count = 0;
+	u32 off, mask, entry;
+	sector_t sec;
+	u8 *fat_sector;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+
+	/* FAT12/16 chains are short, leave them to FAT_read() */
+	if (p_fs->vol_type == EXFAT)
+		mask = 0xFFFFFFFF;
+	else if (p_fs->vol_type == FAT32)
+		mask = 0x0FFFFFFF;
+	else
+		return 0;
+
+	sm_P(&p_fs->f_sem);
+
+	while ((u32) count < max) {
+		sec = p_fs->FAT1_start_sector + (clu >> (p_bd->sector_size_bits-2));
+		off = (clu << 2) & p_bd->sector_size_mask;
+
+		fat_sector = FAT_getblk(sb, sec);
+		if (!fat_sector) {
+			count = -1;
+			break;
+		}
+
+		/* decode the rest of the sector while the chain goes on */
+		for (; off < p_bd->sector_size; off += 4) {
+			entry = GET32_A(fat_sector + off) & mask;
+			if ((entry != clu + 1) || (entry >= p_fs->num_clusters))
+				goto out;
+
+			clu++;
+			if ((u32) ++count == max)
+				goto out;
+		}
+	}
+out:
+	sm_V(&p_fs->f_sem);
+
+	return count;
+} /* end of FAT_read_contig */
+
 static s32 __FAT_read(struct super_block *sb, u32 loc, u32 *content)
 {
 	s32 off;
@@ -389,10 +522,14 @@ u8 *FAT_getblk(struct super_block *sb, sector_t sec)
 
 	bp = FAT_cache_find(sb, sec);
 	if (bp != NULL) {
+		p_fs->FAT_cache_hits++;
 		move_to_mru(bp, &p_fs->FAT_cache_lru_list);
 		return bp->buf_bh->b_data;
 	}
 
+	p_fs->FAT_cache_misses++;
+	FAT_readahead(sb, sec);
+
 	bp = FAT_cache_get(sb, sec);
 
 	FAT_cache_remove_hash(bp);
@@ -431,7 +568,7 @@ void FAT_release_all(struct super_block *sb)
 	BUF_CACHE_T *bp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&f_sem);
+	sm_P(&p_fs->f_sem);
 
 	bp = p_fs->FAT_cache_lru_list.next;
 	while (bp != &p_fs->FAT_cache_lru_list) {
@@ -448,7 +585,7 @@ void FAT_release_all(struct super_block *sb)
 		bp = bp->next;
 	}
 
-	sm_V(&f_sem);
+	sm_V(&p_fs->f_sem);
 } /* end of FAT_release_all */
 
 void FAT_sync(struct super_block *sb)
@@ -456,7 +593,7 @@ void FAT_sync(struct super_block *sb)
 	BUF_CACHE_T *bp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&f_sem);
+	sm_P(&p_fs->f_sem);
 
 	bp = p_fs->FAT_cache_lru_list.next;
 	while (bp != &p_fs->FAT_cache_lru_list) {
@@ -467,16 +604,41 @@ void FAT_sync(struct super_block *sb)
 		bp = bp->next;
 	}
 
-	sm_V(&f_sem);
+	sm_V(&p_fs->f_sem);
 } /* end of FAT_sync */
 
+/* chains mostly go forward, so prefetch the FAT sectors following sec */
+static void FAT_readahead(struct super_block *sb, sector_t sec)
+{
+	sector_t end;
+	struct blk_plug plug;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	/* still well inside the last window */
+	if ((sec >= p_fs->FAT_ra_start) &&
+	    (sec + (FAT_RA_SECTORS >> 1) < p_fs->FAT_ra_end))
+		return;
+
+	end = p_fs->FAT1_start_sector + p_fs->num_FAT_sectors;
+	if (sec + FAT_RA_SECTORS < end)
+		end = sec + FAT_RA_SECTORS;
+
+	p_fs->FAT_ra_start = sec;
+	p_fs->FAT_ra_end = end;
+
+	blk_start_plug(&plug);
+	for (sec++; sec < end; sec++)
+		sb_breadahead(sb, sec);
+	blk_finish_plug(&plug);
+} /* end of FAT_readahead */
+
 static BUF_CACHE_T *FAT_cache_find(struct super_block *sb, sector_t sec)
 {
 	s32 off;
 	BUF_CACHE_T *bp, *hp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & (FAT_CACHE_HASH_SIZE - 1);
+	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & p_fs->FAT_cache_hash_mask;
 
 	hp = &(p_fs->FAT_cache_hash_list[off]);
 	for (bp = hp->hash_next; bp != hp; bp = bp->hash_next) {
@@ -511,7 +673,7 @@ static void FAT_cache_insert_hash(struct super_block *sb, BUF_CACHE_T *bp)
 	FS_INFO_T *p_fs;
 
 	p_fs = &(EXFAT_SB(sb)->fs_info);
-	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & (FAT_CACHE_HASH_SIZE-1);
+	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & p_fs->FAT_cache_hash_mask;
 
 	hp = &(p_fs->FAT_cache_hash_list[off]);
 	bp->hash_next = hp->hash_next;
@@ -533,12 +695,13 @@ static void FAT_cache_remove_hash(BUF_CACHE_T *bp)
 u8 *buf_getblk(struct super_block *sb, sector_t sec)
 {
 	u8 *buf;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	buf = __buf_getblk(sb, sec);
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 
 	return buf;
 } /* end of buf_getblk */
@@ -550,10 +713,13 @@ static u8 *__buf_getblk(struct super_block *sb, sector_t sec)
 
 	bp = buf_cache_find(sb, sec);
 	if (bp != NULL) {
+		p_fs->buf_cache_hits++;
 		move_to_mru(bp, &p_fs->buf_cache_lru_list);
 		return bp->buf_bh->b_data;
 	}
 
+	p_fs->buf_cache_misses++;
+
 	bp = buf_cache_get(sb, sec);
 
 	buf_cache_remove_hash(bp);
@@ -582,8 +748,9 @@ static u8 *__buf_getblk(struct super_block *sb, sector_t sec)
 void buf_modify(struct super_block *sb, sector_t sec)
 {
 	BUF_CACHE_T *bp;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = buf_cache_find(sb, sec);
 	if (likely(bp != NULL))
@@ -592,14 +759,15 @@ void buf_modify(struct super_block *sb, sector_t sec)
 	WARN(!bp, "[EXFAT] failed to find buffer_cache(sector:%llu).\n",
 	     (unsigned long long)sec);
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_modify */
 
 void buf_lock(struct super_block *sb, sector_t sec)
 {
 	BUF_CACHE_T *bp;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = buf_cache_find(sb, sec);
 	if (likely(bp != NULL))
@@ -608,14 +776,15 @@ void buf_lock(struct super_block *sb, sector_t sec)
 	WARN(!bp, "[EXFAT] failed to find buffer_cache(sector:%llu).\n",
 	     (unsigned long long)sec);
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_lock */
 
 void buf_unlock(struct super_block *sb, sector_t sec)
 {
 	BUF_CACHE_T *bp;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = buf_cache_find(sb, sec);
 	if (likely(bp != NULL))
@@ -624,7 +793,7 @@ void buf_unlock(struct super_block *sb, sector_t sec)
 	WARN(!bp, "[EXFAT] failed to find buffer_cache(sector:%llu).\n",
 	     (unsigned long long)sec);
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_unlock */
 
 void buf_release(struct super_block *sb, sector_t sec)
@@ -632,7 +801,7 @@ void buf_release(struct super_block *sb, sector_t sec)
 	BUF_CACHE_T *bp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = buf_cache_find(sb, sec);
 	if (likely(bp != NULL)) {
@@ -648,7 +817,7 @@ void buf_release(struct super_block *sb, sector_t sec)
 		move_to_lru(bp, &p_fs->buf_cache_lru_list);
 	}
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_release */
 
 void buf_release_all(struct super_block *sb)
@@ -656,7 +825,7 @@ void buf_release_all(struct super_block *sb)
 	BUF_CACHE_T *bp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = p_fs->buf_cache_lru_list.next;
 	while (bp != &p_fs->buf_cache_lru_list) {
@@ -673,7 +842,7 @@ void buf_release_all(struct super_block *sb)
 		bp = bp->next;
 	}
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_release_all */
 
 void buf_sync(struct super_block *sb)
@@ -681,7 +850,7 @@ void buf_sync(struct super_block *sb)
 	BUF_CACHE_T *bp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = p_fs->buf_cache_lru_list.next;
 	while (bp != &p_fs->buf_cache_lru_list) {
@@ -692,7 +861,7 @@ void buf_sync(struct super_block *sb)
 		bp = bp->next;
 	}
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_sync */
 
 static BUF_CACHE_T *buf_cache_find(struct super_block *sb, sector_t sec)
@@ -701,7 +870,7 @@ static BUF_CACHE_T *buf_cache_find(struct super_block *sb, sector_t sec)
 	BUF_CACHE_T *bp, *hp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & (BUF_CACHE_HASH_SIZE - 1);
+	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & p_fs->buf_cache_hash_mask;
 
 	hp = &(p_fs->buf_cache_hash_list[off]);
 	for (bp = hp->hash_next; bp != hp; bp = bp->hash_next) {
@@ -734,7 +903,7 @@ static void buf_cache_insert_hash(struct super_block *sb, BUF_CACHE_T *bp)
 	FS_INFO_T *p_fs;
 
 	p_fs = &(EXFAT_SB(sb)->fs_info);
-	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & (BUF_CACHE_HASH_SIZE-1);
+	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & p_fs->buf_cache_hash_mask;
 
 	hp = &(p_fs->buf_cache_hash_list[off]);
 	bp->hash_next = hp->hash_next;
@@ -70,6 +70,7 @@ s32  buf_init(struct super_block *sb);
 s32  buf_shutdown(struct super_block *sb);
 s32  FAT_read(struct super_block *sb, u32 loc, u32 *content);
 s32  FAT_write(struct super_block *sb, u32 loc, u32 content);
+s32  FAT_read_contig(struct super_block *sb, u32 clu, u32 max);
 u8 *FAT_getblk(struct super_block *sb, sector_t sec);
 void   FAT_modify(struct super_block *sb, sector_t sec);
 void   FAT_release_all(struct super_block *sb);
@@ -58,6 +58,9 @@
 
 #include <linux/blkdev.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/bitmap.h>
+#include <linux/hash.h>
 
 static void __set_sb_dirty(struct super_block *sb)
 {
@@ -216,15 +219,28 @@ s32 ffsMountVol(struct super_block *sb)
 		return ret;
 	}
 
+	/* size the FAT and buf caches from the volume geometry */
+	ret = buf_init(sb);
+	if (ret) {
+		bdev_close(sb);
+		return ret;
+	}
+
 	if (p_fs->vol_type == EXFAT) {
 		ret = load_alloc_bitmap(sb);
 		if (ret) {
+			FAT_release_all(sb);
+			buf_release_all(sb);
+			buf_shutdown(sb);
 			bdev_close(sb);
 			return ret;
 		}
 		ret = load_upcase_table(sb);
 		if (ret) {
 			free_alloc_bitmap(sb);
+			FAT_release_all(sb);
+			buf_release_all(sb);
+			buf_shutdown(sb);
 			bdev_close(sb);
 			return ret;
 		}
@@ -235,6 +251,9 @@ s32 ffsMountVol(struct super_block *sb)
 			free_upcase_table(sb);
 			free_alloc_bitmap(sb);
 		}
+		FAT_release_all(sb);
+		buf_release_all(sb);
+		buf_shutdown(sb);
 		bdev_close(sb);
 		return FFS_MEDIAERR;
 	}
@@ -257,6 +276,7 @@ s32 ffsUmountVol(struct super_block *sb)
 	if (p_fs->vol_type == EXFAT) {
 		free_upcase_table(sb);
 		free_alloc_bitmap(sb);
+		dir_index_release_all(sb);
 	}
 
 	FAT_release_all(sb);
@@ -352,6 +372,7 @@ s32 ffsLookupFile(struct inode *inode, char *path, FILE_ID_T *fid)
 		fid->type = TYPE_DIR;
 		fid->rwoffset = 0;
 		fid->hint_last_off = -1;
+		fid->num_runs = 0;
 
 		fid->attr = ATTR_SUBDIR;
 		fid->flags = 0x01;
@@ -373,6 +394,7 @@ s32 ffsLookupFile(struct inode *inode, char *path, FILE_ID_T *fid)
 		fid->type = p_fs->fs_func->get_entry_type(ep);
 		fid->rwoffset = 0;
 		fid->hint_last_off = -1;
+		fid->num_runs = 0;
 		fid->attr = p_fs->fs_func->get_entry_attr(ep);
 
 		fid->size = p_fs->fs_func->get_entry_size(ep2);
@@ -828,6 +850,7 @@ s32 ffsTruncateFile(struct inode *inode, u64 old_size, u64 new_size)
 
 	/* hint information */
 	fid->hint_last_off = -1;
+	fid->num_runs = 0;
 	if (fid->rwoffset > fid->size)
 		fid->rwoffset = fid->size;
 
@@ -1287,10 +1310,59 @@ s32 ffsSetStat(struct inode *inode, DIR_ENTRY_T *info)
 	return FFS_SUCCESS;
 } /* end of ffsSetStat */
 
+/* remember that clusters clu..clu+len-1 are at cluster offset off of the file */
+static void chain_run_add(FILE_ID_T *fid, u32 off, u32 clu, u32 len)
+{
+	s32 i;
+
+	for (i = 0; i < fid->num_runs; i++) {
+		if (fid->runs[i].off == off) {
+			if (fid->runs[i].len < len)
+				fid->runs[i].len = len;
+			return;
+		}
+	}
+
+	if (fid->num_runs < MAX_CHAIN_RUNS) {
+		i = fid->num_runs++;
+		if (fid->num_runs == MAX_CHAIN_RUNS)
+			fid->next_run = 0;
+	} else {
+		i = fid->next_run;
+		fid->next_run = (i + 1) % MAX_CHAIN_RUNS;
+	}
+
+	fid->runs[i].off = off;
+	fid->runs[i].clu = clu;
+	fid->runs[i].len = len;
+} /* end of chain_run_add */
+
+/* move *off and *clu to the known position nearest below cluster offset target */
+static void chain_run_find(FILE_ID_T *fid, u32 target, u32 *off, u32 *clu)
+{
+	s32 i;
+	u32 end;
+
+	for (i = 0; i < fid->num_runs; i++) {
+		if (fid->runs[i].off > target)
+			continue;
+
+		end = fid->runs[i].off + fid->runs[i].len - 1;
+		if (end > target)
+			end = target;
+
+		if (end > *off) {
+			*off = end;
+			*clu = fid->runs[i].clu + (end - fid->runs[i].off);
+		}
+	}
+} /* end of chain_run_find */
+
 s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu)
 {
 	s32 num_clusters, num_alloced, modified = FALSE;
-	u32 last_clu;
+	s32 count;
+	u32 last_clu, cur_off;
 	sector_t sector = 0;
 	CHAIN_T new_clu;
 	DENTRY_T *ep;
@@ -1318,17 +1390,39 @@ s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu)
 				*clu += clu_offset;
 		}
 	} else {
+		cur_off = 0;
+
 		/* hint information */
 		if ((clu_offset > 0) && (fid->hint_last_off > 0) &&
 			(clu_offset >= fid->hint_last_off)) {
-			clu_offset -= fid->hint_last_off;
+			cur_off = fid->hint_last_off;
 			*clu = fid->hint_last_clu;
 		}
 
+		/* known runs of the chain */
+		if ((clu_offset > 0) && (*clu != CLUSTER_32(~0)))
+			chain_run_find(fid, clu_offset, &cur_off, clu);
+		clu_offset -= cur_off;
+
 		while ((clu_offset > 0) && (*clu != CLUSTER_32(~0))) {
+			/* step over a contiguous run at once */
+			count = FAT_read_contig(sb, *clu, clu_offset);
+			if (count < 0)
+				return FFS_MEDIAERR;
+
+			if (count > 0) {
+				chain_run_add(fid, cur_off, *clu, count + 1);
+				last_clu = *clu + count - 1;
+				*clu += count;
+				cur_off += count;
+				clu_offset -= count;
+				continue;
+			}
+
 			last_clu = *clu;
 			if (FAT_read(sb, *clu, clu) == -1)
 				return FFS_MEDIAERR;
+			cur_off++;
 			clu_offset--;
 		}
 	}
@@ -2000,6 +2094,9 @@ void exfat_free_cluster(struct super_block *sb, CHAIN_T *p_chain, s32 do_relse)
 		return;
 	}
 
+	/* the chain may be a removed directory */
+	dir_index_drop(sb, p_chain->dir);
+
 	__set_sb_dirty(sb);
 	clu = p_chain->dir;
 
@@ -2532,6 +2629,319 @@ void free_upcase_table(struct super_block *sb)
 	p_fs->vol_utbl = NULL;
 } /* end of free_upcase_table */
 
+/*
+ *  Directory Index Functions
+ */
+
+/* a large exFAT directory gets an in-memory index: its entry sets are
+ * hashed by the name hash of their stream entries and a map tracks which
+ * dentries are in use. lookups then compare full names only for sets with
+ * a matching hash, and creates take free runs from the map. the index is
+ * updated by the dentry init/delete functions and dropped when the
+ * directory clusters are freed. directories with fewer dentries in use,
+ * too many dentries, or whose index couldn't be built are remembered in
+ * dir_index_skip until they change size, so they are not scanned again.
+ */
+
+static void dir_index_free(DIR_INDEX_T *idx)
+{
+	if (idx->used)
+		vfree(idx->used);
+	if (idx->bucket)
+		vfree(idx->bucket);
+
+	memset(idx, 0, sizeof(DIR_INDEX_T));
+	idx->dir = CLUSTER_32(~0);
+} /* end of dir_index_free */
+
+static void dir_index_link(DIR_INDEX_T *idx, s32 entry, u16 name_hash)
+{
+	u32 b = hash_32(name_hash, idx->hash_bits);
+
+	idx->name_hash[entry] = name_hash;
+	idx->next[entry] = idx->bucket[b];
+	idx->bucket[b] = entry;
+	__set_bit(entry, idx->head);
+} /* end of dir_index_link */
+
+static void dir_index_unlink(DIR_INDEX_T *idx, s32 entry)
+{
+	s32 *p;
+
+	if ((entry < 0) || (entry >= idx->num_dentries) || !test_bit(entry, idx->head))
+		return;
+
+	p = &(idx->bucket[hash_32(idx->name_hash[entry], idx->hash_bits)]);
+	while (*p >= 0) {
+		if (*p == entry) {
+			*p = idx->next[entry];
+			break;
+		}
+		p = &(idx->next[*p]);
+	}
+	__clear_bit(entry, idx->head);
+} /* end of dir_index_unlink */
+
+/* (re)allocate the maps for max_dentries and rehash the indexed sets */
+static s32 dir_index_resize(DIR_INDEX_T *idx, s32 max_dentries)
+{
+	s32 i, num_longs = BITS_TO_LONGS(max_dentries);
+	u32 hash_bits = ilog2(max(max_dentries >> 2, 64));
+	unsigned long *used, *head;
+	s32 *bucket, *next;
+	u16 *name_hash;
+
+	used = vmalloc(num_longs * 2 * sizeof(unsigned long) +
+			max_dentries * (sizeof(s32) + sizeof(u16)));
+	bucket = vmalloc((1 << hash_bits) * sizeof(s32));
+	if (!used || !bucket) {
+		if (used)
+			vfree(used);
+		if (bucket)
+			vfree(bucket);
+		return FFS_MEMORYERR;
+	}
+
+	head = used + num_longs;
+	next = (s32 *)(head + num_longs);
+	name_hash = (u16 *)(next + max_dentries);
+
+	bitmap_zero(used, max_dentries);
+	bitmap_zero(head, max_dentries);
+	for (i = 0; i < (1 << hash_bits); i++)
+		bucket[i] = -1;
+
+	if (idx->used) {
+		bitmap_copy(used, idx->used, idx->num_dentries);
+		bitmap_copy(head, idx->head, idx->num_dentries);
+		memcpy(name_hash, idx->name_hash, idx->num_dentries * sizeof(u16));
+		vfree(idx->used);
+		vfree(idx->bucket);
+	}
+
+	idx->used = used;
+	idx->head = head;
+	idx->next = next;
+	idx->name_hash = name_hash;
+	idx->bucket = bucket;
+	idx->hash_bits = hash_bits;
+	idx->max_dentries = max_dentries;
+
+	for_each_set_bit(i, idx->head, idx->num_dentries)
+		dir_index_link(idx, i, idx->name_hash[i]);
+
+	return FFS_SUCCESS;
+} /* end of dir_index_resize */
+
+/* add num_dentries free dentries at the end of the directory */
+static s32 dir_index_extend(DIR_INDEX_T *idx, s32 num_dentries)
+{
+	s32 max_dentries = idx->max_dentries;
+
+	if (idx->num_dentries + num_dentries > DIR_INDEX_MAX_DENTRIES)
+		return FFS_FULL;
+
+	if (idx->num_dentries + num_dentries > max_dentries) {
+		max_dentries = max(max_dentries << 1, idx->num_dentries + num_dentries);
+		if (max_dentries > DIR_INDEX_MAX_DENTRIES)
+			max_dentries = DIR_INDEX_MAX_DENTRIES;
+		if (dir_index_resize(idx, max_dentries) != FFS_SUCCESS)
+			return FFS_MEMORYERR;
+	}
+
+	idx->num_dentries += num_dentries;
+	return FFS_SUCCESS;
+} /* end of dir_index_extend */
+
+static void dir_index_set_used(DIR_INDEX_T *idx, s32 entry, s32 num_entries, s32 used)
+{
+	if ((entry < 0) || (entry >= idx->num_dentries) || (num_entries <= 0))
+		return;
+
+	if (entry + num_entries > idx->num_dentries)
+		num_entries = idx->num_dentries - entry;
+
+	if (used)
+		bitmap_set(idx->used, entry, num_entries);
+	else
+		bitmap_clear(idx->used, entry, num_entries);
+} /* end of dir_index_set_used */
+
+static DIR_INDEX_T *dir_index_get(struct super_block *sb, u32 dir)
+{
+	int i;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	for (i = 0; i < DIR_INDEX_SLOTS; i++) {
+		if (p_fs->dir_index[i].bucket && (p_fs->dir_index[i].dir == dir)) {
+			p_fs->dir_index[i].stamp = ++p_fs->dir_index_stamp;
+			return &(p_fs->dir_index[i]);
+		}
+	}
+
+	return NULL;
+} /* end of dir_index_get */
+
+static DIR_INDEX_SKIP_T *dir_index_skip_slot(FS_INFO_T *p_fs, u32 dir)
+{
+	return &(p_fs->dir_index_skip[hash_32(dir, ilog2(DIR_INDEX_SKIP_SLOTS))]);
+} /* end of dir_index_skip_slot */
+
+/* check whether the directory is known not to be worth an index */
+static s32 dir_index_skipped(struct super_block *sb, CHAIN_T *p_dir)
+{
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	DIR_INDEX_SKIP_T *skip = dir_index_skip_slot(p_fs, p_dir->dir);
+
+	return (skip->dir == p_dir->dir) && (skip->size == p_dir->size);
+} /* end of dir_index_skipped */
+
+/* num_entries dentries were put in use in a directory without an index */
+static void dir_index_skip_count(struct super_block *sb, u32 dir, s32 num_entries)
+{
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	DIR_INDEX_SKIP_T *skip = dir_index_skip_slot(p_fs, dir);
+
+	if ((skip->dir != dir) || (skip->used < 0))
+		return;
+
+	skip->used += num_entries;
+	if (skip->used >= DIR_INDEX_MIN_DENTRIES)
+		skip->dir = 0;
+} /* end of dir_index_skip_count */
+
+/* scan the whole directory, and keep the index in a free (or the least
+ * recently used) slot only if the directory turns out to be large
+ */
+static DIR_INDEX_T *dir_index_build(struct super_block *sb, CHAIN_T *p_dir)
+{
+	int i;
+	s32 dentry = 0, last_file = -1, unused = FALSE, used = -1;
+	s32 dentries_per_clu;
+	u32 type;
+	CHAIN_T clu;
+	DENTRY_T *ep;
+	DIR_INDEX_T new_idx, *idx = &new_idx;
+	DIR_INDEX_SKIP_T *skip;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	memset(&new_idx, 0, sizeof(DIR_INDEX_T));
+	dentries_per_clu = p_fs->dentries_per_clu;
+
+	/* the index can't cover it, don't scan it at all */
+	if (((s64) p_dir->size * dentries_per_clu) > DIR_INDEX_MAX_DENTRIES)
+		goto skip_out;
+
+	if (dir_index_resize(idx, p_dir->size * dentries_per_clu) != FFS_SUCCESS)
+		goto err_out;
+	used = 0;
+
+	clu.dir = p_dir->dir;
+	clu.size = p_dir->size;
+	clu.flags = p_dir->flags;
+
+	while (clu.dir != CLUSTER_32(~0)) {
+		if (p_fs->dev_ejected)
+			goto err_out;
+
+		if (dir_index_extend(idx, dentries_per_clu) != FFS_SUCCESS)
+			goto err_out;
+
+		/* everything after an unused entry is unused as well */
+		for (i = 0; !unused && (i < dentries_per_clu); i++) {
+			ep = get_entry_in_dir(sb, &clu, i, NULL);
+			if (!ep)
+				goto err_out;
+
+			type = p_fs->fs_func->get_entry_type(ep);
+			if (type == TYPE_UNUSED) {
+				unused = TRUE;
+				break;
+			}
+			if (type == TYPE_DELETED)
+				continue;
+
+			__set_bit(dentry + i, idx->used);
+			used++;
+
+			if ((type == TYPE_FILE) || (type == TYPE_DIR))
+				last_file = dentry + i;
+			else if ((type == TYPE_STREAM) && (last_file == dentry + i - 1))
+				dir_index_link(idx, last_file, GET16_A(((STRM_DENTRY_T *) ep)->name_hash));
+		}
+		dentry += dentries_per_clu;
+
+		if (clu.flags == 0x03) {
+			if ((--clu.size) > 0)
+				clu.dir++;
+			else
+				clu.dir = CLUSTER_32(~0);
+		} else {
+			if (FAT_read(sb, clu.dir, &(clu.dir)) != 0)
+				goto err_out;
+		}
+	}
+
+	if (used < DIR_INDEX_MIN_DENTRIES) {
+		dir_index_free(&new_idx);
+		goto skip_out;
+	}
+
+	/* only now give up the least recently used index */
+	idx = NULL;
+	for (i = 0; i < DIR_INDEX_SLOTS; i++) {
+		if (!p_fs->dir_index[i].bucket) {
+			idx = &(p_fs->dir_index[i]);
+			break;
+		}
+		if (!idx || (p_fs->dir_index[i].stamp < idx->stamp))
+			idx = &(p_fs->dir_index[i]);
+	}
+	dir_index_free(idx);
+
+	*idx = new_idx;
+	idx->dir = p_dir->dir;
+	idx->stamp = ++p_fs->dir_index_stamp;
+	return idx;
+
+err_out:
+	dir_index_free(&new_idx);
+	used = -1;
+skip_out:
+	skip = dir_index_skip_slot(p_fs, p_dir->dir);
+	skip->dir = p_dir->dir;
+	skip->size = p_dir->size;
+	skip->used = used;
+	return NULL;
+} /* end of dir_index_build */
+
+void dir_index_drop(struct super_block *sb, u32 dir)
+{
+	int i;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	DIR_INDEX_SKIP_T *skip = dir_index_skip_slot(p_fs, dir);
+
+	for (i = 0; i < DIR_INDEX_SLOTS; i++) {
+		if (p_fs->dir_index[i].bucket && (p_fs->dir_index[i].dir == dir))
+			dir_index_free(&(p_fs->dir_index[i]));
+	}
+
+	if (skip->dir == dir)
+		skip->dir = 0;
+} /* end of dir_index_drop */
+
+void dir_index_release_all(struct super_block *sb)
+{
+	int i;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	for (i = 0; i < DIR_INDEX_SLOTS; i++)
+		dir_index_free(&(p_fs->dir_index[i]));
+
+	memset(p_fs->dir_index_skip, 0, sizeof(p_fs->dir_index_skip));
+} /* end of dir_index_release_all */
+
 /*
  *  Directory Entry Management Functions
  */
@@ -2870,6 +3280,7 @@ s32 exfat_init_dir_entry(struct super_block *sb, CHAIN_T *p_dir, s32 entry, u32
 	u8 flags;
 	FILE_DENTRY_T *file_ep;
 	STRM_DENTRY_T *strm_ep;
+	DIR_INDEX_T *idx;
 
 	flags = (type == TYPE_FILE) ? 0x01 : 0x03;
 
@@ -2888,6 +3299,10 @@ s32 exfat_init_dir_entry(struct super_block *sb, CHAIN_T *p_dir, s32 entry, u32
 	init_strm_entry(strm_ep, flags, start_clu, size);
 	buf_modify(sb, sector);
 
+	idx = dir_index_get(sb, p_dir->dir);
+	if (idx)
+		dir_index_set_used(idx, entry, 2, TRUE);
+
 	return FFS_SUCCESS;
 } /* end of exfat_init_dir_entry */
 
@@ -2942,6 +3357,7 @@ s32 exfat_init_ext_entry(struct super_block *sb, CHAIN_T *p_dir, s32 entry, s32
 	FILE_DENTRY_T *file_ep;
 	STRM_DENTRY_T *strm_ep;
 	NAME_DENTRY_T *name_ep;
+	DIR_INDEX_T *idx;
 
 	file_ep = (FILE_DENTRY_T *) get_entry_in_dir(sb, p_dir, entry, &sector);
 	if (!file_ep)
@@ -2970,6 +3386,17 @@ s32 exfat_init_ext_entry(struct super_block *sb, CHAIN_T *p_dir, s32 entry, s32
 
 	update_dir_checksum(sb, p_dir, entry);
 
+	idx = dir_index_get(sb, p_dir->dir);
+	if (idx) {
+		/* a rename in place re-initializes an indexed set */
+		dir_index_unlink(idx, entry);
+		dir_index_set_used(idx, entry, num_entries, TRUE);
+		if (entry < idx->num_dentries)
+			dir_index_link(idx, entry, p_uniname->name_hash);
+	} else {
+		dir_index_skip_count(sb, p_dir->dir, num_entries);
+	}
+
 	return FFS_SUCCESS;
 } /* end of exfat_init_ext_entry */
 
@@ -3098,8 +3525,16 @@ void exfat_delete_dir_entry(struct super_block *sb, CHAIN_T *p_dir, s32 entry, s
 	int i;
 	sector_t sector;
 	DENTRY_T *ep;
+	DIR_INDEX_T *idx;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
+	idx = dir_index_get(sb, p_dir->dir);
+	if (idx) {
+		if (order == 0)
+			dir_index_unlink(idx, entry);
+		dir_index_set_used(idx, entry+order, num_entries-order, FALSE);
+	}
+
 	for (i = order; i < num_entries; i++) {
 		ep = get_entry_in_dir(sb, p_dir, entry+i, &sector);
 		if (!ep)
@@ -3164,7 +3599,7 @@ void update_dir_checksum_with_entry_set(struct super_block *sb, ENTRY_SET_CACHE_
 static s32 _walk_fat_chain(struct super_block *sb, CHAIN_T *p_dir, s32 byte_offset, u32 *clu)
 {
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
-	s32 clu_offset;
+	s32 clu_offset, count;
 	u32 cur_clu;
 
 	clu_offset = byte_offset >> p_fs->cluster_size_bits;
@@ -3174,6 +3609,17 @@ static s32 _walk_fat_chain(struct super_block *sb, CHAIN_T *p_dir, s32 byte_offs
 		cur_clu += clu_offset;
 	} else {
 		while (clu_offset > 0) {
+			/* step over a contiguous run at once */
+			count = FAT_read_contig(sb, cur_clu, clu_offset);
+			if (count < 0)
+				return FFS_MEDIAERR;
+
+			if (count > 0) {
+				cur_clu += count;
+				clu_offset -= count;
+				continue;
+			}
+
 			if (FAT_read(sb, cur_clu, &cur_clu) == -1)
 				return FFS_MEDIAERR;
 			clu_offset--;
@@ -3516,6 +3962,7 @@ s32 search_deleted_or_unused_entry(struct super_block *sb, CHAIN_T *p_dir, s32 n
 	u32 type;
 	CHAIN_T clu;
 	DENTRY_T *ep;
+	DIR_INDEX_T *idx;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
 	if (p_dir->dir == CLUSTER_32(0)) /* FAT16 root_dir */
@@ -3523,6 +3970,17 @@ s32 search_deleted_or_unused_entry(struct super_block *sb, CHAIN_T *p_dir, s32 n
 	else
 		dentries_per_clu = p_fs->dentries_per_clu;
 
+	if (p_fs->vol_type == EXFAT) {
+		idx = dir_index_get(sb, p_dir->dir);
+		if (idx) {
+			dentry = (s32) bitmap_find_next_zero_area(idx->used,
+					idx->num_dentries, 0, num_entries, 0);
+			if (dentry + num_entries > idx->num_dentries)
+				return -1;
+			return dentry;
+		}
+	}
+
 	if (p_fs->hint_uentry.dir == p_dir->dir) {
 		if (p_fs->hint_uentry.entry == -1)
 			return -1;
@@ -3610,6 +4068,7 @@ s32 find_empty_entry(struct inode *inode, CHAIN_T *p_dir, s32 num_entries)
 	u64 size = 0;
 	CHAIN_T clu;
 	DENTRY_T *ep = NULL;
+	DIR_INDEX_T *idx;
 	struct super_block *sb = inode->i_sb;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 	FILE_ID_T *fid = &(EXFAT_I(inode)->fid);
@@ -3660,6 +4119,10 @@ s32 find_empty_entry(struct inode *inode, CHAIN_T *p_dir, s32 num_entries)
 		p_fs->hint_uentry.clu.size++;
 		p_dir->size++;
 
+		idx = dir_index_get(sb, p_dir->dir);
+		if (idx && (dir_index_extend(idx, p_fs->dentries_per_clu) != FFS_SUCCESS))
+			dir_index_drop(sb, p_dir->dir);
+
 		/* (3) update the directory entry */
 		if (p_fs->vol_type == EXFAT) {
 			if (p_dir->dir != p_fs->root_dir) {
@@ -3781,6 +4244,74 @@ s32 fat_find_dir_entry(struct super_block *sb, CHAIN_T *p_dir, UNI_NAME_T *p_uni
 	return -2;
 } /* end of fat_find_dir_entry */
 
+/* compare the entry set at the given entry with the name */
+static s32 exfat_match_entry_set(struct super_block *sb, CHAIN_T *p_dir, s32 entry, UNI_NAME_T *p_uniname, u32 type)
+{
+	int i, len;
+	s32 num_entries, match = FALSE;
+	u16 entry_uniname[16], *uniname = p_uniname->name, unichar;
+	ENTRY_SET_CACHE_T *es;
+	DENTRY_T *ep;
+	STRM_DENTRY_T *strm_ep;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	es = get_entry_set_in_dir(sb, p_dir, entry, ES_ALL_ENTRIES, &ep);
+	if (!es)
+		return FALSE;
+
+	num_entries = es->num_entries;
+	if ((type != TYPE_ALL) && (type != p_fs->fs_func->get_entry_type(ep)))
+		goto out;
+	if (num_entries < 3)
+		goto out;
+
+	strm_ep = (STRM_DENTRY_T *)(ep+1);
+	if ((p_uniname->name_hash != GET16_A(strm_ep->name_hash)) ||
+	    (p_uniname->name_len != strm_ep->name_len))
+		goto out;
+
+	for (i = 2; i < num_entries; i++, uniname += 15) {
+		if (p_fs->fs_func->get_entry_type(ep+i) != TYPE_EXTEND)
+			goto out;
+
+		len = extract_uni_name_from_name_entry((NAME_DENTRY_T *)(ep+i), entry_uniname, i);
+
+		unichar = *(uniname+len);
+		*(uniname+len) = 0x0;
+
+		if (nls_uniname_cmp(sb, uniname, entry_uniname)) {
+			*(uniname+len) = unichar;
+			goto out;
+		}
+
+		*(uniname+len) = unichar;
+	}
+	match = TRUE;
+out:
+	release_entry_set(es);
+	return match;
+} /* end of exfat_match_entry_set */
+
+static s32 exfat_find_dir_entry_indexed(struct super_block *sb, DIR_INDEX_T *idx, CHAIN_T *p_dir, UNI_NAME_T *p_uniname, u32 type)
+{
+	s32 entry;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	/* free slots come from the index, not from the hint */
+	p_fs->hint_uentry.dir = CLUSTER_32(~0);
+	p_fs->hint_uentry.entry = -1;
+
+	entry = idx->bucket[hash_32(p_uniname->name_hash, idx->hash_bits)];
+	for (; entry >= 0; entry = idx->next[entry]) {
+		if (idx->name_hash[entry] != p_uniname->name_hash)
+			continue;
+		if (exfat_match_entry_set(sb, p_dir, entry, p_uniname, type))
+			return entry;
+	}
+
+	return -2;
+} /* end of exfat_find_dir_entry_indexed */
+
 /* return values of exfat_find_dir_entry()
    >= 0 : return dir entiry position with the name in dir
    -1 : (root dir, ".") it is the root dir itself
@@ -3797,6 +4328,7 @@ s32 exfat_find_dir_entry(struct super_block *sb, CHAIN_T *p_dir, UNI_NAME_T *p_u
 	FILE_DENTRY_T *file_ep;
 	STRM_DENTRY_T *strm_ep;
 	NAME_DENTRY_T *name_ep;
+	DIR_INDEX_T *idx;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
 	if (p_dir->dir == p_fs->root_dir) {
@@ -3805,6 +4337,13 @@ s32 exfat_find_dir_entry(struct super_block *sb, CHAIN_T *p_dir, UNI_NAME_T *p_u
 			return -1; // special case, root directory itself
 	}
 
+	idx = dir_index_get(sb, p_dir->dir);
+	if (!idx && (((s64) p_dir->size * p_fs->dentries_per_clu) >= DIR_INDEX_MIN_DENTRIES) &&
+		!dir_index_skipped(sb, p_dir))
+		idx = dir_index_build(sb, p_dir);
+	if (idx)
+		return exfat_find_dir_entry_indexed(sb, idx, p_dir, p_uniname, type);
+
 	if (p_dir->dir == CLUSTER_32(0)) /* FAT16 root_dir */
 		dentries_per_clu = p_fs->dentries_in_root;
 	else
@@ -4424,23 +4963,19 @@ u8 calc_checksum_1byte(void *data, s32 len, u8 chksum)
 
 u16 calc_checksum_2byte(void *data, s32 len, u16 chksum, s32 type)
 {
-	int i;
+	int i = 0;
 	u8 *c = (u8 *) data;
 
-	switch (type) {
-	case CS_DIR_ENTRY:
-		for (i = 0; i < len; i++, c++) {
-			if ((i == 2) || (i == 3))
-				continue;
-			chksum = (((chksum & 1) << 15) | ((chksum & 0xFFFE) >> 1)) + (u16) *c;
-		}
-		break;
-	default
-			:
-		for (i = 0; i < len; i++, c++)
-			chksum = (((chksum & 1) << 15) | ((chksum & 0xFFFE) >> 1)) + (u16) *c;
+	if (type == CS_DIR_ENTRY) {
+		/* bytes 2 and 3 hold the set checksum itself */
+		for (; (i < 2) && (i < len); i++)
+			chksum = (u16)((chksum << 15) | (chksum >> 1)) + (u16) c[i];
+		i = 4;
 	}
 
+	for (; i < len; i++)
+		chksum = (u16)((chksum << 15) | (chksum >> 1)) + (u16) c[i];
+
 	return chksum;
 } /* end of calc_checksum_2byte */
 
@@ -4796,6 +5331,7 @@ s32 create_dir(struct inode *inode, CHAIN_T *p_dir, UNI_NAME_T *p_uniname, FILE_
 	fid->type = TYPE_DIR;
 	fid->rwoffset = 0;
 	fid->hint_last_off = -1;
+	fid->num_runs = 0;
 
 	return FFS_SUCCESS;
 } /* end of create_dir */
@@ -4840,6 +5376,7 @@ s32 create_file(struct inode *inode, CHAIN_T *p_dir, UNI_NAME_T *p_uniname, u8 m
 	fid->type = TYPE_FILE;
 	fid->rwoffset = 0;
 	fid->hint_last_off = -1;
+	fid->num_runs = 0;
 
 	return FFS_SUCCESS;
 } /* end of create_file */
@@ -415,6 +415,27 @@ typedef struct {
 	CHAIN_T     clu;
 } UENTRY_T;
 
+/* name hash index of a large exFAT directory */
+typedef struct {
+	u32      dir;                    /* dir start cluster */
+	u32      stamp;                  /* last use, for replacement */
+	s32      num_dentries;           /* num of dentries covered */
+	s32      max_dentries;           /* capacity of the per-dentry maps */
+	u32      hash_bits;              /* log2 of num of hash buckets */
+	s32      *bucket;                /* first entry set in each bucket */
+	s32      *next;                  /* next entry set in the same bucket */
+	u16      *name_hash;             /* name hash of each entry set */
+	unsigned long *used;             /* free-slot map, bit set if in use */
+	unsigned long *head;             /* bit set if an entry set starts here */
+} DIR_INDEX_T;
+
+/* an exFAT directory not to be indexed */
+typedef struct {
+	u32      dir;                    /* dir start cluster, 0 if unused */
+	u32      size;                   /* num of dir clusters when scanned */
+	s32      used;                   /* dentries in use, -1 if it can't be indexed */
+} DIR_INDEX_SKIP_T;
+
 typedef struct {
 	s32       (*alloc_cluster)(struct super_block *sb, s32 num_alloc, CHAIN_T *p_chain);
 	void        (*free_cluster)(struct super_block *sb, CHAIN_T *p_chain, s32 do_relse);
@@ -479,6 +500,9 @@ typedef struct __FS_INFO_T {
 	u32      clu_srch_ptr;           /* cluster search pointer */
 	u32      used_clusters;          /* number of used clusters */
 	UENTRY_T    hint_uentry;         /* unused entry hint information */
+	DIR_INDEX_T dir_index[DIR_INDEX_SLOTS]; /* large directory indexes */
+	u32      dir_index_stamp;
+	DIR_INDEX_SKIP_T dir_index_skip[DIR_INDEX_SKIP_SLOTS];
 
 	u32      dev_ejected;            /* block device operation error flag */
 
@@ -486,14 +510,26 @@ typedef struct __FS_INFO_T {
 	struct semaphore v_sem;
 
 	/* FAT cache */
-	BUF_CACHE_T FAT_cache_array[FAT_CACHE_SIZE];
+	struct semaphore f_sem;
+	BUF_CACHE_T *FAT_cache_array;
 	BUF_CACHE_T FAT_cache_lru_list;
-	BUF_CACHE_T FAT_cache_hash_list[FAT_CACHE_HASH_SIZE];
+	BUF_CACHE_T *FAT_cache_hash_list;
+	u32      FAT_cache_size;
+	u32      FAT_cache_hash_mask;
+	u64      FAT_cache_hits;
+	u64      FAT_cache_misses;
+	sector_t FAT_ra_start;           /* FAT read-ahead window */
+	sector_t FAT_ra_end;
 
 	/* buf cache */
-	BUF_CACHE_T buf_cache_array[BUF_CACHE_SIZE];
+	struct semaphore b_sem;
+	BUF_CACHE_T *buf_cache_array;
 	BUF_CACHE_T buf_cache_lru_list;
-	BUF_CACHE_T buf_cache_hash_list[BUF_CACHE_HASH_SIZE];
+	BUF_CACHE_T *buf_cache_hash_list;
+	u32      buf_cache_size;
+	u32      buf_cache_hash_mask;
+	u64      buf_cache_hits;
+	u64      buf_cache_misses;
 } FS_INFO_T;
 
 #define ES_2_ENTRIES		2
@@ -578,6 +614,10 @@ void   sync_alloc_bitmap(struct super_block *sb);
 s32  load_upcase_table(struct super_block *sb);
 void   free_upcase_table(struct super_block *sb);
 
+/* directory index functions */
+void   dir_index_drop(struct super_block *sb, u32 dir);
+void   dir_index_release_all(struct super_block *sb);
+
 /* dir entry management functions */
 u32 fat_get_entry_type(DENTRY_T *p_entry);
 u32 exfat_get_entry_type(DENTRY_T *p_entry);
@@ -48,11 +48,27 @@
 /* (should be an exponential value of 2)            */
 #define MAX_DENTRY              512
 
-/* cache size (in number of sectors)                */
+/* cache size bounds (in number of sectors)         */
+/* the caches are sized per volume at mount time    */
 /* (should be an exponential value of 2)            */
-#define FAT_CACHE_SIZE          128
-#define FAT_CACHE_HASH_SIZE     64
-#define BUF_CACHE_SIZE          256
-#define BUF_CACHE_HASH_SIZE     64
+#define FAT_CACHE_SIZE_MIN      128
+#define FAT_CACHE_SIZE_MAX      4096
+#define BUF_CACHE_SIZE_MIN      256
+#define BUF_CACHE_SIZE_MAX      2048
+
+/* FAT sectors read ahead along a chain */
+#define FAT_RA_SECTORS          32
+
+/* each cache pins at most 1/(2^CACHE_MEM_SHIFT) of memory */
+#define CACHE_MEM_SHIFT         10
+
+/* exFAT directories with at least DIR_INDEX_MIN_DENTRIES */
+/* dentries get an in-memory name hash index            */
+#define DIR_INDEX_MIN_DENTRIES  1024
+#define DIR_INDEX_MAX_DENTRIES  (1 << 20)
+#define DIR_INDEX_SLOTS         4
+/* directories that were found too small, too large or */
+/* failed to be indexed, until they change size         */
+#define DIR_INDEX_SKIP_SLOTS    32
 
 #endif /* _EXFAT_DATA_H */
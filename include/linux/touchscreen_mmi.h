@@ -20,6 +20,10 @@
 #include <linux/version.h>
 #include <linux/kernel.h>
 #include <linux/input.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/firmware.h>
+#include <linux/kref.h>
 #include <linux/mmi_kernel_common.h>
 #include <linux/mmi_relay.h>
 
@@ -276,6 +280,131 @@ struct touch_clip_area {
 	bool inversion; /* clip inside (when true) or outside otherwise */
 };
 
+/* log2 microsecond buckets, the last one collects everything above 2^18us */
+#define TS_MMI_LAT_BUCKETS	20
+/* a longer gap between two frames ends the touch and isn't a report interval */
+#define TS_MMI_LAT_IDLE_US	50000
+
+/**
+ * struct ts_mmi_latency - hard IRQ timestamp and touch frame timing statistics
+ *
+ * @irq_time:      time of the last hard IRQ not reported yet, 0 if none
+ * @last_sync:     input_sync time of the previous frame
+ * @frames:        frames reported with an IRQ timestamp
+ * @unmatched:     frames reported without one
+ * @lat_hist:      IRQ to input_sync latency, bucket n counts [2^(n-1), 2^n) us
+ * @interval_hist: time between consecutive frames of a touch, same buckets
+ */
+struct ts_mmi_latency {
+	spinlock_t	lock;
+	ktime_t		irq_time;
+	ktime_t		last_sync;
+	u64		frames;
+	u64		unmatched;
+	u64		lat_total_us;
+	u64		lat_max_us;
+	u64		intervals;
+	u64		interval_total_us;
+	u32		lat_hist[TS_MMI_LAT_BUCKETS];
+	u32		interval_hist[TS_MMI_LAT_BUCKETS];
+};
+
+/*
+ * Resume stages, in the order a resume normally reaches them. Each is
+ * stamped once per resume, relative to the first panel-on notification.
+ */
+enum ts_mmi_resume_stage {
+	TS_MMI_RESUME_POWER,		/* power on or reset issued */
+	TS_MMI_RESUME_START,		/* resume work started */
+	TS_MMI_RESUME_PRE,		/* vendor pre_resume done */
+	TS_MMI_RESUME_READY,		/* controller ready */
+	TS_MMI_RESUME_IRQ,		/* reporting enabled */
+	TS_MMI_RESUME_POST,		/* vendor post_resume done */
+	TS_MMI_RESUME_DONE,		/* settings restored, active mode */
+	TS_MMI_RESUME_DISPLAY_ON,	/* DISPLAY_ON notification */
+	TS_MMI_RESUME_FIRST_TOUCH,	/* first frame reported */
+	TS_MMI_RESUME_STAGES,
+};
+
+/**
+ * struct ts_mmi_resume_timing - stage timestamps of the last resume
+ *
+ * @pending: set on suspend, the next panel-on notification starts a new
+ *           record
+ * @start:   time of that notification
+ * @stage:   time each stage was reached, 0 if it was not
+ */
+struct ts_mmi_resume_timing {
+	spinlock_t	lock;
+	bool		pending;
+	ktime_t		start;
+	ktime_t		stage[TS_MMI_RESUME_STAGES];
+};
+
+/**
+ * struct ts_mmi_fw - cached touch firmware image
+ *
+ * @fw:      the image, usable where a request_firmware() result is expected
+ * @crc:     crc32 of the image when it was loaded
+ * @priv:    vendor parsed form of the image, set by the parse callback
+ * @release: frees @priv together with the image
+ */
+struct ts_mmi_fw {
+	struct firmware	fw;
+	char		name[TS_MMI_MAX_FW_PATH];
+	u8		*image;
+	u32		crc;
+	void		*priv;
+	void		(*release)(void *priv);
+	struct kref	ref;
+	struct list_head node;
+};
+
+/**
+ * struct ts_mmi_fwdl_ops - vendor hooks of the burst firmware download
+ *
+ * @write:  send @len image bytes for controller offset @offset. @tx holds
+ *          the engine's head bytes for the command followed by the
+ *          payload, @rx is as large for full duplex buses or NULL
+ * @status: optional, wait until the controller took the writes so far
+ * @verify: optional, check the controller checksum of a written region
+ *          against @sum
+ * @sum:    optional, host checksum, folded in chunk by chunk
+ */
+struct ts_mmi_fwdl_ops {
+	int	(*write)(void *priv, u32 offset, u8 *tx, u8 *rx, u32 len);
+	int	(*status)(void *priv);
+	int	(*verify)(void *priv, u32 offset, u32 len, u32 sum);
+	u32	(*sum)(u32 sum, const u8 *data, u32 len);
+};
+
+/**
+ * struct ts_mmi_fwdl - burst firmware download engine
+ *
+ * Filled in by the vendor before ts_mmi_fwdl_init():
+ * @head:            bytes reserved in front of each payload for the command
+ * @status_interval: chunks between two @status calls, 0 for region ends only
+ * @verify_len:      size of the regions handed to @verify, 0 for the whole
+ *                   image. Chunks never cross a region boundary.
+ * @sum_init:        checksum seed of each region
+ *
+ * Set by ts_mmi_fwdl_init():
+ * @chunk:           payload bytes per transfer, capped by the bus
+ * @tx, @rx:         preallocated DMA-safe bounce buffers
+ */
+struct ts_mmi_fwdl {
+	const struct ts_mmi_fwdl_ops *ops;
+	void		*priv;
+	u32		head;
+	u32		status_interval;
+	u32		verify_len;
+	u32		sum_init;
+	struct device	*dev;
+	u32		chunk;
+	u8		*tx;
+	u8		*rx;
+};
+
 /**
  * struct touchscreen_mmi_class_methods - export class methods to vendor
  *
@@ -291,6 +420,7 @@ struct ts_mmi_class_methods {
 	int     (*clip_touch_event)(struct device *dev, struct touch_event_data *tev, struct input_dev *input_dev);
 	int     (*report_liquid_detection_status)(struct device *parent, int status);
 	struct kobject *kobj_notify;
+	struct ts_mmi_latency *latency;
 };
 
 enum ts_mmi_pm_mode {
@@ -442,6 +572,7 @@ struct ts_mmi_dev_pdata {
 	bool		active_region_ctrl;
 	bool		support_liquid_detection;
 	bool		clip_area_ctrl;
+	bool		staged_resume;
 	int		max_x;
 	int		max_y;
 	int		fod_x;
@@ -553,6 +684,8 @@ struct ts_mmi_dev {
 	struct attribute_group	*extern_group;
 	struct list_head	node;
 	struct touch_clip_area clip;
+	struct ts_mmi_latency	latency;
+	struct ts_mmi_resume_timing	resume_timing;
 	/*
 	 * vendor provided
 	 */
@@ -590,6 +723,8 @@ do { \
 
 extern int ts_mmi_notifiers_register(struct ts_mmi_dev *touch_cdev);
 extern void ts_mmi_notifiers_unregister(struct ts_mmi_dev *touch_cdev);
+extern void ts_mmi_resume_mark(struct ts_mmi_dev *touch_cdev,
+	enum ts_mmi_resume_stage stage);
 extern int ts_mmi_panel_register(struct ts_mmi_dev *touch_cdev);
 extern void ts_mmi_panel_unregister(struct ts_mmi_dev *touch_cdev);
 extern int ts_mmi_dev_register(struct device *parent,
@@ -609,6 +744,23 @@ extern int ts_mmi_gesture_suspend(struct ts_mmi_dev *touch_cdev);
 int ts_mmi_check_drm_panel(struct ts_mmi_dev* touch_cdev, struct device_node *of_node);
 #endif
 extern bool ts_mmi_is_panel_match(const char *panel_node, char *touch_ic_name);
+/*
+ * Every in-tree class driver stamps its touch IRQ from a hard IRQ top half
+ * and ends each touch frame with ts_mmi_input_sync(), using the exports
+ * pointer it keeps after ts_mmi_dev_register(). Gesture, key and status
+ * reports keep plain input_sync().
+ */
+extern void ts_mmi_irq_timestamp(struct ts_mmi_class_methods *imports);
+extern void ts_mmi_input_sync(struct ts_mmi_class_methods *imports,
+	struct input_dev *input_dev);
+extern struct ts_mmi_fw *ts_mmi_fw_get(struct device *dev, const char *name,
+	int (*parse)(struct ts_mmi_fw *fw));
+extern void ts_mmi_fw_put(struct ts_mmi_fw *fw);
+extern void ts_mmi_fw_invalidate(const char *name);
+extern int ts_mmi_fwdl_init(struct ts_mmi_fwdl *dl, struct device *dev,
+	u32 max_chunk, bool duplex);
+extern int ts_mmi_fwdl_run(struct ts_mmi_fwdl *dl, u32 offset,
+	const u8 *image, u32 len);
 
 /*sensor*/
 extern bool ts_mmi_is_sensor_enable(void);